@@ -0,0 +1,55 @@
+/// Format of the event traces written by Nachos with `-trace`, and read by
+/// `trace2json`.
+///
+/// A trace is a header, the names of the threads, and then the events, in
+/// the byte order of the host that wrote it.  Events are grouped by
+/// category, each group in order of time; events of different categories
+/// at the same tick are in no particular order.
+
+#ifndef NACHOS_BIN_TRACE__H
+#define NACHOS_BIN_TRACE__H
+
+
+#define TRACEMAGIC  0x7ACE0001  // Magic number denoting a Nachos trace.
+
+#define TRACE_NAME_LENGTH  24
+
+/// Kinds of events.  The CPU is the one the event happened on; the
+/// argument depends on the kind.
+enum {
+    TRACE_THREAD_START,  // Thread dispatched on the CPU.
+    TRACE_THREAD_STOP,   // Thread blocked or finished, leaving the CPU.
+    TRACE_INTERRUPT,     // Interrupt handler run; argument: `IntType`.
+    TRACE_DISK_READ,     // Disk read requested; argument: sector.
+    TRACE_DISK_WRITE,    // Disk write requested; argument: sector.
+    TRACE_DISK_DONE,     // Disk request completed.
+    TRACE_PAGE_FAULT,    // Page fault; argument: virtual page.
+    TRACE_SWAP_IN,       // Page read from swap; argument: virtual page.
+    TRACE_SWAP_OUT,      // Page written to swap; argument: virtual page.
+    TRACE_SYSCALL_ENTER, // System call made; argument: its number.
+    TRACE_SYSCALL_EXIT,  // System call returned; argument: its number.
+    NUM_TRACE_EVENTS
+};
+
+typedef struct traceHeader {
+    int traceMagic;  // Should be `TRACEMAGIC`.
+    int numThreads;  // Names that follow.
+    int numEvents;   // Events that follow the names.
+    int numLost;     // Events overwritten before the trace was written.
+} TraceHeader;
+
+typedef struct traceThread {
+    int thread;
+    char name[TRACE_NAME_LENGTH];
+} TraceThread;
+
+typedef struct traceEvent {
+    unsigned ticks;       // Simulated time.
+    unsigned short type;  // One of the kinds above.
+    unsigned short cpu;
+    int thread;           // Current thread, -1 if none.
+    int arg;
+} TraceEvent;
+
+
+#endif
@@ -0,0 +1,308 @@
+/// This program reads in a Nachos event trace (written with `-trace`, see
+/// `trace.h`), and outputs it in the trace event format of Chrome, as JSON,
+/// to be loaded in `chrome://tracing` or Perfetto.
+///
+/// The timeline has three processes:
+///
+/// * CPUs: what thread every CPU ran, and when.
+/// * Threads: the system calls of every thread, with page faults and swaps
+///   as instants.
+/// * Devices: interrupts, as instants, and disk requests.
+///
+/// One simulated tick is shown as one microsecond.
+///
+/// Copyright (c) 2016-2017 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "trace.h"
+#include "threads/copyright.h"
+#define IN_ASM
+#include "userprog/syscall.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define MAX_CPUS  64
+
+enum { CPUS_PID, THREADS_PID, DEVICES_PID };
+enum { INTERRUPTS_TID, DISK_TID };
+
+/// Names of the interrupts, in the order of `IntType`.
+static const char *INTERRUPT_NAMES[] = {
+    "timer", "disk", "console write", "console read",
+    "network send", "network recv"
+};
+
+static const char *
+SyscallName(int number)
+{
+    switch (number) {
+        case SC_Halt:           return "Halt";
+        case SC_Exit:           return "Exit";
+        case SC_Exec:           return "Exec";
+        case SC_Join:           return "Join";
+        case SC_Create:         return "Create";
+        case SC_Open:           return "Open";
+        case SC_Read:           return "Read";
+        case SC_Write:          return "Write";
+        case SC_Close:          return "Close";
+        case SC_Fork:           return "Fork";
+        case SC_Yield:          return "Yield";
+        case SC_ForkProcess:    return "ForkProcess";
+        case SC_Mmap:           return "Mmap";
+        case SC_Munmap:         return "Munmap";
+        case SC_Sbrk:           return "Sbrk";
+        case SC_SetWeight:      return "SetWeight";
+        case SC_WaitAny:        return "WaitAny";
+        case SC_Sleep:          return "Sleep";
+        case SC_FutexWait:      return "FutexWait";
+        case SC_FutexWake:      return "FutexWake";
+        case SC_SetAtomicRange: return "SetAtomicRange";
+        default:                return "syscall";
+    }
+}
+
+static TraceThread *threads;
+static int numThreads;
+
+static const char *
+ThreadName(int thread)
+{
+    if (thread < 0 || thread >= numThreads)
+        return "?";
+    return threads[thread].name;
+}
+
+/// Events are sorted by time, keeping the order of those at the same tick
+/// within a category; so the index breaks ties.
+typedef struct sortedEvent {
+    TraceEvent event;
+    int index;
+} SortedEvent;
+
+static int
+CompareEvents(const void *a, const void *b)
+{
+    const SortedEvent *x = a, *y = b;
+
+    if (x->event.ticks != y->event.ticks)
+        return x->event.ticks < y->event.ticks ? -1 : 1;
+    return x->index - y->index;
+}
+
+static FILE *out;
+static int firstEvent = 1;
+
+static void
+Separate(void)
+{
+    fputs(firstEvent ? "\n" : ",\n", out);
+    firstEvent = 0;
+}
+
+static void
+Metadata(const char *what, int pid, int tid, const char *name)
+{
+    Separate();
+    fprintf(out, "{\"ph\":\"M\",\"name\":\"%s\",\"pid\":%d,\"tid\":%d,"
+            "\"args\":{\"name\":\"", what, pid, tid);
+    for (; *name != '\0'; name++)  // Names come from user programs.
+        if (*name == '"' || *name == '\\')
+            fprintf(out, "\\%c", *name);
+        else if ((unsigned char) *name >= ' ')
+            fputc(*name, out);
+    fputs("\"}}", out);
+}
+
+static void
+Slice(int pid, int tid, const char *name, unsigned start, unsigned end)
+{
+    Separate();
+    fprintf(out, "{\"ph\":\"X\",\"name\":\"%s\",\"pid\":%d,\"tid\":%d,"
+            "\"ts\":%u,\"dur\":%u}", name, pid, tid, start, end - start);
+}
+
+static void
+Instant(int pid, int tid, const char *name, unsigned ticks,
+        const char *argName, int arg)
+{
+    Separate();
+    fprintf(out, "{\"ph\":\"i\",\"s\":\"t\",\"name\":\"%s\",\"pid\":%d,"
+            "\"tid\":%d,\"ts\":%u", name, pid, tid, ticks);
+    if (argName != NULL)
+        fprintf(out, ",\"args\":{\"%s\":%d}", argName, arg);
+    fputs("}", out);
+}
+
+int
+main(int argc, char **argv)
+{
+    FILE *in;
+    TraceHeader header;
+    SortedEvent *events;
+    int i;
+
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: %s <trace file> [<json file>]\n", argv[0]);
+        exit(1);
+    }
+    if ((in = fopen(argv[1], "rb")) == NULL) {
+        perror(argv[1]);
+        exit(1);
+    }
+    if (fread(&header, sizeof header, 1, in) != 1
+          || header.traceMagic != TRACEMAGIC
+          || header.numThreads < 0 || header.numEvents < 0) {
+        fprintf(stderr, "%s: not a Nachos trace\n", argv[1]);
+        exit(1);
+    }
+
+    numThreads = header.numThreads;
+    threads = malloc((numThreads + 1) * sizeof *threads);
+    events = malloc((header.numEvents + 1) * sizeof *events);
+    if (threads == NULL || events == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    if (fread(threads, sizeof *threads, numThreads, in) != (size_t) numThreads) {
+        fprintf(stderr, "%s: truncated trace\n", argv[1]);
+        exit(1);
+    }
+    for (i = 0; i < header.numEvents; i++) {
+        if (fread(&events[i].event, sizeof events[i].event, 1, in) != 1) {
+            fprintf(stderr, "%s: truncated trace\n", argv[1]);
+            exit(1);
+        }
+        events[i].index = i;
+    }
+    fclose(in);
+    if (header.numLost > 0)
+        fprintf(stderr, "%s: %d events were lost, the oldest of their "
+                "category\n", argv[1], header.numLost);
+    qsort(events, header.numEvents, sizeof *events, CompareEvents);
+
+    if (argc == 3) {
+        if ((out = fopen(argv[2], "w")) == NULL) {
+            perror(argv[2]);
+            exit(1);
+        }
+    } else
+        out = stdout;
+
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", out);
+    Metadata("process_name", CPUS_PID, 0, "CPUs");
+    Metadata("process_name", THREADS_PID, 0, "Threads");
+    Metadata("process_name", DEVICES_PID, 0, "Devices");
+    Metadata("thread_name", DEVICES_PID, INTERRUPTS_TID, "interrupts");
+    Metadata("thread_name", DEVICES_PID, DISK_TID, "disk");
+    for (i = 0; i < numThreads; i++)
+        Metadata("thread_name", THREADS_PID, threads[i].thread,
+                 threads[i].name);
+
+    // Thread on every CPU since when, and disk request since when.
+    int running[MAX_CPUS];
+    unsigned since[MAX_CPUS];
+    int usedCpus = 0;
+    int diskBusy = 0, diskSector = 0, diskWrite = 0;
+    unsigned diskSince = 0;
+    unsigned last = 0;
+    char name[64];
+
+    for (i = 0; i < MAX_CPUS; i++)
+        running[i] = -1;
+
+    for (i = 0; i < header.numEvents; i++) {
+        const TraceEvent *e = &events[i].event;
+        int cpu = e->cpu < MAX_CPUS ? e->cpu : MAX_CPUS - 1;
+
+        last = e->ticks;
+        if (cpu >= usedCpus) {
+            for (; usedCpus <= cpu; usedCpus++) {
+                snprintf(name, sizeof name, "CPU %d", usedCpus);
+                Metadata("thread_name", CPUS_PID, usedCpus, name);
+            }
+        }
+
+        switch (e->type) {
+            case TRACE_THREAD_START:
+            case TRACE_THREAD_STOP:
+                if (running[cpu] >= 0
+                      && (e->type == TRACE_THREAD_START
+                          || running[cpu] == e->thread))
+                {
+                    Slice(CPUS_PID, cpu, ThreadName(running[cpu]),
+                          since[cpu], e->ticks);
+                    running[cpu] = -1;
+                }
+                if (e->type == TRACE_THREAD_START) {
+                    running[cpu] = e->thread;
+                    since[cpu] = e->ticks;
+                }
+                break;
+
+            case TRACE_INTERRUPT:
+                Instant(DEVICES_PID, INTERRUPTS_TID,
+                        e->arg >= 0 && e->arg < (int) (sizeof INTERRUPT_NAMES
+                                                 / sizeof *INTERRUPT_NAMES)
+                        ? INTERRUPT_NAMES[e->arg] : "interrupt",
+                        e->ticks, NULL, 0);
+                break;
+
+            case TRACE_DISK_READ:
+            case TRACE_DISK_WRITE:
+                diskBusy = 1;
+                diskSector = e->arg;
+                diskWrite = e->type == TRACE_DISK_WRITE;
+                diskSince = e->ticks;
+                break;
+
+            case TRACE_DISK_DONE:
+                if (diskBusy) {
+                    snprintf(name, sizeof name, "%s sector %d",
+                             diskWrite ? "write" : "read", diskSector);
+                    Slice(DEVICES_PID, DISK_TID, name, diskSince, e->ticks);
+                    diskBusy = 0;
+                }
+                break;
+
+            case TRACE_PAGE_FAULT:
+            case TRACE_SWAP_IN:
+            case TRACE_SWAP_OUT:
+                Instant(THREADS_PID, e->thread,
+                        e->type == TRACE_PAGE_FAULT ? "page fault"
+                        : e->type == TRACE_SWAP_IN ? "swap in" : "swap out",
+                        e->ticks, "vpn", e->arg);
+                break;
+
+            case TRACE_SYSCALL_ENTER:
+            case TRACE_SYSCALL_EXIT:
+                Separate();
+                fprintf(out, "{\"ph\":\"%s\",\"name\":\"%s\",\"pid\":%d,"
+                        "\"tid\":%d,\"ts\":%u}",
+                        e->type == TRACE_SYSCALL_ENTER ? "B" : "E",
+                        SyscallName(e->arg), THREADS_PID, e->thread,
+                        e->ticks);
+                break;
+
+            default:
+                fprintf(stderr, "%s: unknown event %u\n", argv[1], e->type);
+                break;
+        }
+    }
+
+    // Threads still running when the trace was written.
+    for (i = 0; i < usedCpus; i++)
+        if (running[i] >= 0)
+            Slice(CPUS_PID, i, ThreadName(running[i]), since[i], last);
+
+    fputs("\n]}\n", out);
+    if (out != stdout)
+        fclose(out);
+    free(threads);
+    free(events);
+    return 0;
+}
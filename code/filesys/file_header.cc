@@ -41,8 +41,11 @@ FileHeader::Allocate(BitMap *freeMap, unsigned fileSize)
     if (freeMap->NumClear() < numSectors)
         return false;  // Not enough space.
 
+    // Lay the file out contiguously when there is room for it, so reading
+    // it sequentially does not seek; otherwise take any free sectors.
+    int first = numSectors > 0 ? freeMap->FindRun(numSectors) : -1;
     for (unsigned i = 0; i < numSectors; i++)
-        dataSectors[i] = freeMap->Find();
+        dataSectors[i] = first >= 0 ? first + i : freeMap->Find();
     return true;
 }
 
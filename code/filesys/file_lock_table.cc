@@ -0,0 +1,72 @@
+/// Routines to manage the table of file locks.
+///
+/// Copyright (c) 2016-2017 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "file_lock_table.hh"
+#include "threads/system.hh"
+
+
+FileLockTable::FileLockTable()
+{
+    entries = NULL;
+    tableLock = new Lock("file lock table");
+}
+
+FileLockTable::~FileLockTable()
+{
+    while (entries != NULL) {
+        Entry *e = entries;
+        entries = e->next;
+        delete e->lock;
+        delete e;
+    }
+    delete tableLock;
+}
+
+FileLockTable::Entry *
+FileLockTable::Find(int sector)
+{
+    for (Entry *e = entries; e != NULL; e = e->next)
+        if (e->sector == sector)
+            return e;
+    return NULL;
+}
+
+RWLock *
+FileLockTable::Get(int sector)
+{
+    tableLock->Acquire();
+    Entry *e = Find(sector);
+    if (e == NULL) {
+        DEBUG('f', "Creating the lock of file at sector %d\n", sector);
+        e = new Entry;
+        e->sector = sector;
+        e->users  = 0;
+        e->lock   = new RWLock("file");
+        e->next   = entries;
+        entries   = e;
+    }
+    e->users++;
+    tableLock->Release();
+    return e->lock;
+}
+
+void
+FileLockTable::Put(int sector)
+{
+    tableLock->Acquire();
+    Entry **link = &entries;
+    while (*link != NULL && (*link)->sector != sector)
+        link = &(*link)->next;
+    Entry *e = *link;
+    ASSERT(e != NULL && e->users > 0);
+    if (--e->users == 0) {
+        *link = e->next;
+        delete e->lock;
+        delete e;
+    }
+    tableLock->Release();
+}
@@ -0,0 +1,57 @@
+/// Table of the reader-writer locks of the open files.
+///
+/// Every file open at least once has a lock, shared by all the `OpenFile`s
+/// on it, so that many threads may read the file at once while a writer has
+/// it to itself.  Files are known by the sector of their header.  The lock
+/// of a file lives as long as someone has it open.
+///
+/// Copyright (c) 2016-2017 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_FILESYS_FILELOCKTABLE__HH
+#define NACHOS_FILESYS_FILELOCKTABLE__HH
+
+
+class Lock;
+class RWLock;
+
+class FileLockTable {
+public:
+
+    /// Initialize the table, empty.
+    FileLockTable();
+
+    /// Files may still be open if Nachos halts meanwhile, like the bitmap
+    /// and the directory; nobody may be holding their locks.
+    ~FileLockTable();
+
+    /// The lock of the file whose header is at `sector`, created if the
+    /// file was not open.  Every call must be paired with a `Put`.
+    RWLock *Get(int sector);
+
+    /// Give up the lock of the file at `sector`, freeing it if nobody else
+    /// has it.
+    void Put(int sector);
+
+private:
+
+    struct Entry {
+        int sector;
+        unsigned users;
+        RWLock *lock;
+        Entry *next;
+    };
+
+    /// Entry of `sector`, or `NULL`.
+    Entry *Find(int sector);
+
+    /// Open files, most recently opened first.  There are few of them.
+    Entry *entries;
+
+    /// Serializes changes to the table.
+    Lock *tableLock;
+};
+
+
+#endif
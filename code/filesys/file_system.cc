@@ -27,7 +27,9 @@
 ///
 /// Our implementation at this point has the following restrictions:
 ///
-/// * there is no synchronization for concurrent accesses;
+/// * the whole directory, together with the bitmap, has a single
+///   reader-writer lock: lookups proceed concurrently, but `Create` and
+///   `Remove` exclude each other and every lookup;
 /// * files have a fixed size, set when the file is created;
 /// * files cannot be bigger than about 3KB in size;
 /// * there is no hierarchical directory structure, and only a limited number
@@ -47,6 +49,7 @@
 #include "file_header.hh"
 #include "machine/disk.hh"
 #include "userprog/bitmap.hh"
+#include "threads/system.hh"
 
 
 /// Sectors containing the file headers for the bitmap of free sectors, and
@@ -75,6 +78,7 @@ static const unsigned DIRECTORY_FILE_SIZE = sizeof (DirectoryEntry)
 FileSystem::FileSystem(bool format)
 {
     DEBUG('f', "Initializing the file system.\n");
+    directoryLock = new RWLock("directory");
     if (format) {
         BitMap     *freeMap   = new BitMap(NUM_SECTORS);
         Directory  *directory = new Directory(NUM_DIR_ENTRIES);
@@ -158,8 +162,7 @@ FileSystem::FileSystem(bool format)
 /// * no free entry for file in directory;
 /// * no free space for data blocks for the file.
 ///
-/// Note that this implementation assumes there is no concurrent access to
-/// the file system!
+/// The directory is locked for writing throughout.
 ///
 /// * `name` is the name of file to be created.
 /// * `initialSize` is the size of file to be created.
@@ -174,6 +177,7 @@ FileSystem::Create(const char *name, int initialSize)
 
     DEBUG('f', "Creating file %s, size %d\n", name, initialSize);
 
+    directoryLock->AcquireWrite();
     directory = new Directory(NUM_DIR_ENTRIES);
     directory->FetchFrom(directoryFile);
 
@@ -203,6 +207,7 @@ FileSystem::Create(const char *name, int initialSize)
         delete freeMap;
     }
     delete directory;
+    directoryLock->ReleaseWrite();
     return success;
 }
 
@@ -212,6 +217,9 @@ FileSystem::Create(const char *name, int initialSize)
 /// 1. Find the location of the file's header, using the directory.
 /// 2. Bring the header into memory.
 ///
+/// The directory is locked for reading until the file is open, so that it
+/// cannot be removed meanwhile.
+///
 /// * `name` is the text name of the file to be opened.
 OpenFile *
 FileSystem::Open(const char *name)
@@ -221,10 +229,12 @@ FileSystem::Open(const char *name)
     int        sector;
 
     DEBUG('f', "Opening file %s\n", name);
+    directoryLock->AcquireRead();
     directory->FetchFrom(directoryFile);
     sector = directory->Find(name);
     if (sector >= 0)
         openFile = new OpenFile(sector);  // `name` was found in directory.
+    directoryLock->ReleaseRead();
     delete directory;
     return openFile;  // Return `NULL` if not found.
 }
@@ -240,6 +250,9 @@ FileSystem::Open(const char *name)
 /// Return true if the file was deleted, false if the file was not in the
 /// file system.
 ///
+/// The directory is locked for writing throughout, and the file too while
+/// its blocks are freed, so that nobody is reading or writing them.
+///
 /// * `name` is the text name of the file to be removed.
 bool
 FileSystem::Remove(const char *name)
@@ -247,15 +260,20 @@ FileSystem::Remove(const char *name)
     Directory  *directory;
     BitMap     *freeMap;
     FileHeader *fileHeader;
+    RWLock     *fileLock;
     int         sector;
 
+    directoryLock->AcquireWrite();
     directory = new Directory(NUM_DIR_ENTRIES);
     directory->FetchFrom(directoryFile);
     sector = directory->Find(name);
     if (sector == -1) {
+       directoryLock->ReleaseWrite();
        delete directory;
        return false;  // file not found
     }
+    fileLock = fileLocks->Get(sector);
+    fileLock->AcquireWrite();
     fileHeader = new FileHeader;
     fileHeader->FetchFrom(sector);
 
@@ -265,9 +283,12 @@ FileSystem::Remove(const char *name)
     fileHeader->Deallocate(freeMap);  // Remove data blocks.
     freeMap->Clear(sector);           // Remove header block.
     directory->Remove(name);
+    fileLock->ReleaseWrite();
+    fileLocks->Put(sector);
 
     freeMap->WriteBack(freeMapFile);      // Flush to disk.
     directory->WriteBack(directoryFile);  // Flush to disk.
+    directoryLock->ReleaseWrite();
     delete fileHeader;
     delete directory;
     delete freeMap;
@@ -280,8 +301,10 @@ FileSystem::List()
 {
     Directory *directory = new Directory(NUM_DIR_ENTRIES);
 
+    directoryLock->AcquireRead();
     directory->FetchFrom(directoryFile);
     directory->List();
+    directoryLock->ReleaseRead();
     delete directory;
 }
 
@@ -299,6 +322,7 @@ FileSystem::Print()
     BitMap     *freeMap   = new BitMap(NUM_SECTORS);
     Directory  *directory = new Directory(NUM_DIR_ENTRIES);
 
+    directoryLock->AcquireRead();
     printf("Bit map file header:\n");
     bitHeader->FetchFrom(FREE_MAP_SECTOR);
     bitHeader->Print();
@@ -312,6 +336,7 @@ FileSystem::Print()
 
     directory->FetchFrom(directoryFile);
     directory->Print();
+    directoryLock->ReleaseRead();
 
     delete bitHeader;
     delete dirHeader;
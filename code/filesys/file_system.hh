@@ -67,6 +67,8 @@ public:
 };
 
 #else  // FILESYS
+class RWLock;
+
 class FileSystem {
 public:
 
@@ -97,6 +99,8 @@ private:
                            ///< file.
    OpenFile* directoryFile;  ///< “Root” directory -- list of file names,
                              ///< represented as a file.
+   RWLock* directoryLock;  ///< Held for reading to look names up, and for
+                           ///< writing to change the directory and bitmap.
 };
 
 #endif
@@ -5,6 +5,8 @@
 /// * Print -- cat the contents of a Nachos file.
 /// * Perftest -- a stress test for the Nachos file system read and write a
 ///   really large file in tiny chunks (will not work on baseline system!)
+/// * ReadMostlyTest -- many threads reading a file while a few others
+///   write it and change the directory.
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2017 Docentes de la Universidad Nacional de Rosario.
@@ -175,3 +177,111 @@ PerformanceTest()
     }
     stats->Print();
 }
+
+/// Read-mostly test.
+///
+/// `RM_READERS` threads read a whole file over and over, looking its name
+/// up every time, while a writer rewrites it now and then, all bytes the
+/// same, and another thread creates and removes a scratch file.  Readers
+/// share the locks of the file and the directory, so they must get to hold
+/// them together; a reader seeing bytes of two different rewrites would
+/// mean a write was not exclusive.
+
+#define RMFileName     "ReadMost"
+#define RMScratchName  "Scratch"
+
+static const unsigned RM_FILE_SIZE = 8 * SECTOR_SIZE;
+static const int RM_READERS = 4;
+static const int RM_READS = 40;    // Per reader.
+static const int RM_WRITES = 10;
+static const int RM_CREATES = 10;
+
+static bool rmTorn;
+static unsigned rmMaxReaders;
+
+static void
+RMReader(void *)
+{
+    char *buffer = new char[RM_FILE_SIZE];
+
+    for (int i = 0; i < RM_READS; i++) {
+        OpenFile *openFile = fileSystem->Open(RMFileName);
+        ASSERT(openFile != NULL);
+        if (openFile->ReadAt(buffer, RM_FILE_SIZE, 0) != (int) RM_FILE_SIZE)
+            rmTorn = true;
+        for (unsigned j = 1; j < RM_FILE_SIZE; j++)
+            if (buffer[j] != buffer[0])
+                rmTorn = true;
+        if (openFile->GetLock()->MaxReaders() > rmMaxReaders)
+            rmMaxReaders = openFile->GetLock()->MaxReaders();
+        delete openFile;
+    }
+    delete [] buffer;
+}
+
+static void
+RMWriter(void *)
+{
+    char *buffer = new char[RM_FILE_SIZE];
+    OpenFile *openFile = fileSystem->Open(RMFileName);
+    ASSERT(openFile != NULL);
+
+    for (int i = 0; i < RM_WRITES; i++) {
+        memset(buffer, 'a' + i, RM_FILE_SIZE);
+        openFile->WriteAt(buffer, RM_FILE_SIZE, 0);
+        currentThread->Yield();
+    }
+    delete openFile;
+    delete [] buffer;
+}
+
+static void
+RMCreator(void *)
+{
+    for (int i = 0; i < RM_CREATES; i++) {
+        ASSERT(fileSystem->Create(RMScratchName, SECTOR_SIZE));
+        currentThread->Yield();
+        ASSERT(fileSystem->Remove(RMScratchName));
+    }
+}
+
+void
+ReadMostlyTest()
+{
+    char *buffer = new char[RM_FILE_SIZE];
+    memset(buffer, 'a', RM_FILE_SIZE);
+
+    if (!fileSystem->Create(RMFileName, RM_FILE_SIZE)) {
+        printf("Read-mostly test: cannot create %s\n", RMFileName);
+        delete [] buffer;
+        return;
+    }
+    OpenFile *openFile = fileSystem->Open(RMFileName);
+    ASSERT(openFile != NULL);
+    openFile->WriteAt(buffer, RM_FILE_SIZE, 0);
+    delete openFile;
+    delete [] buffer;
+
+    rmTorn = false;
+    rmMaxReaders = 0;
+    unsigned start = stats->totalTicks;
+    for (int i = 0; i < RM_READERS; i++) {
+        Thread *t = new Thread("reader", true);
+        t->Fork(RMReader, NULL);
+    }
+    (new Thread("writer", true))->Fork(RMWriter, NULL);
+    (new Thread("creator", true))->Fork(RMCreator, NULL);
+
+    CompletionGroup *children = currentThread->GetChildren();
+    int id, status;
+    while (children->WaitAny(&id, &status))
+        ;
+
+    printf("Read-mostly test: %d reads of %u bytes, %d writes, %d creates "
+           "in %u ticks\n", RM_READERS * RM_READS, RM_FILE_SIZE, RM_WRITES,
+           RM_CREATES, stats->totalTicks - start);
+    printf("    up to %u readers at once; consistent reads: %s\n",
+           rmMaxReaders, !rmTorn && rmMaxReaders > 1
+                         && fileSystem->Remove(RMFileName) ? "PASSED"
+                                                           : "FAILED");
+}
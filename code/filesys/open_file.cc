@@ -5,6 +5,8 @@
 /// Also as in UNIX, for convenience, we keep the file header in memory while
 /// the file is open.
 ///
+/// Reads hold the lock of the file for reading, and writes for writing.
+///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2017 Docentes de la Universidad Nacional de Rosario.
 /// All rights reserved.  See `copyright.h` for copyright notice and
@@ -22,8 +24,12 @@
 /// * `sector` is the location on disk of the file header for this file.
 OpenFile::OpenFile(int sector)
 {
+    hdrSector = sector;
+    lock = fileLocks->Get(sector);
     hdr = new FileHeader;
+    lock->AcquireRead();
     hdr->FetchFrom(sector);
+    lock->ReleaseRead();
     seekPosition = 0;
 }
 
@@ -31,6 +37,7 @@ OpenFile::OpenFile(int sector)
 OpenFile::~OpenFile()
 {
     delete hdr;
+    fileLocks->Put(hdrSector);
 }
 
 /// Change the current location within the open file -- the point at which
@@ -98,6 +105,15 @@ OpenFile::Write(const char *into, unsigned numBytes)
 
 int
 OpenFile::ReadAt(char *into, unsigned numBytes, unsigned position)
+{
+    lock->AcquireRead();
+    int result = ReadLocked(into, numBytes, position);
+    lock->ReleaseRead();
+    return result;
+}
+
+int
+OpenFile::ReadLocked(char *into, unsigned numBytes, unsigned position)
 {
     unsigned fileLength = hdr->FileLength();
     unsigned firstSector, lastSector, numSectors;
@@ -138,6 +154,7 @@ OpenFile::WriteAt(const char *from, unsigned numBytes, unsigned position)
         return 0;  // check request
     if (position + numBytes > fileLength)
         numBytes = fileLength - position;
+    lock->AcquireWrite();
     DEBUG('f', "Writing %d bytes at %d, from file of length %d.\n",
           numBytes, position, fileLength);
 
@@ -152,9 +169,9 @@ OpenFile::WriteAt(const char *from, unsigned numBytes, unsigned position)
 
     // Read in first and last sector, if they are to be partially modified.
     if (!firstAligned)
-        ReadAt(buf, SECTOR_SIZE, firstSector * SECTOR_SIZE);
+        ReadLocked(buf, SECTOR_SIZE, firstSector * SECTOR_SIZE);
     if (!lastAligned && (firstSector != lastSector || firstAligned))
-        ReadAt(&buf[(lastSector - firstSector) * SECTOR_SIZE],
+        ReadLocked(&buf[(lastSector - firstSector) * SECTOR_SIZE],
                SECTOR_SIZE, lastSector * SECTOR_SIZE);
 
     // Copy in the bytes we want to change.
@@ -164,6 +181,7 @@ OpenFile::WriteAt(const char *from, unsigned numBytes, unsigned position)
     for (unsigned i = firstSector; i <= lastSector; i++)
         synchDisk->WriteSector(hdr->ByteToSector(i * SECTOR_SIZE),
                                &buf[(i - firstSector) * SECTOR_SIZE]);
+    lock->ReleaseWrite();
     delete [] buf;
     return numBytes;
 }
@@ -7,9 +7,10 @@
 /// `filesys.hh`).
 ///
 /// The other is the “real” implementation, that turns these operations into
-/// read and write disk sector requests.  In this baseline implementation of
-/// the file system, we do not worry about concurrent accesses to the file
-/// system by different threads -- this is part of the assignment.
+/// read and write disk sector requests.  All the `OpenFile`s on the same file
+/// share a reader-writer lock (cf. `file_lock_table.hh`): reads of the file
+/// proceed concurrently, while a write has it to itself, so that no reader
+/// sees it half written.
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2017 Docentes de la Universidad Nacional de Rosario.
@@ -63,6 +64,7 @@ private:
 
 #else // FILESYS
 class FileHeader;
+class RWLock;
 
 class OpenFile {
 public:
@@ -91,9 +93,21 @@ public:
     // the UNIX idiom -- `lseek` to end of file, `tell`, `lseek` back).
     unsigned Length();
 
+    /// The lock shared by everyone with this file open.
+    RWLock *GetLock()
+    {
+        return lock;
+    }
+
   private:
+
+    /// `ReadAt`, with the lock already held.
+    int ReadLocked(char *into, unsigned numBytes, unsigned position);
+
     FileHeader *hdr;  ///< Header for this file.
     unsigned seekPosition;  ///< Current position within the file.
+    int hdrSector;  ///< Location of the header on disk.
+    RWLock *lock;  ///< Lock of the file, from `fileLocks`.
 };
 
 #endif
@@ -14,6 +14,7 @@
 
 
 #include "synch_disk.hh"
+#include "threads/system.hh"
 
 
 /// Disk interrupt handler.  Need this to be a C routine, because C++ cannot
@@ -58,6 +59,7 @@ SynchDisk::ReadSector(int sectorNumber, char *data)
     disk->ReadRequest(sectorNumber, data);
     semaphore->P();   // Wait for interrupt.
     lock->Release();
+    accounting->Count(&Usage::diskSectors);
 }
 
 /// Write the contents of a buffer into a disk sector.  Return only
@@ -72,6 +74,7 @@ SynchDisk::WriteSector(int sectorNumber, const char *data)
     disk->WriteRequest(sectorNumber, data);
     semaphore->P();   // wait for interrupt
     lock->Release();
+    accounting->Count(&Usage::diskSectors);
 }
 
 /// Disk interrupt handler.  Wake up any thread waiting for the disk
@@ -121,6 +121,7 @@ Disk::ReadRequest(unsigned sectorNumber, char *data)
     active = true;
     UpdateLast(sectorNumber);
     stats->numDiskReads++;
+    tracer->Record(TRACE_DISK_READ, sectorNumber);
     interrupt->Schedule(DiskDone, this, ticks, DISK_INT);
 }
 
@@ -141,6 +142,7 @@ Disk::WriteRequest(unsigned sectorNumber, const char *data)
     active = true;
     UpdateLast(sectorNumber);
     stats->numDiskWrites++;
+    tracer->Record(TRACE_DISK_WRITE, sectorNumber);
     interrupt->Schedule(DiskDone, this, ticks, DISK_INT);
 }
 
@@ -150,6 +152,7 @@ void
 Disk::HandleInterrupt()
 {
     active = false;
+    tracer->Record(TRACE_DISK_DONE);
     (*handler)(handlerArg);
 }
 
@@ -120,10 +120,38 @@ Interrupt::Enable()
 /// Two things can cause OneTick to be called:
 /// * interrupts are re-enabled;
 /// * a user instruction is executed.
+///
+/// Under SMP, the time is charged to the current CPU, and the clock only
+/// moves on when every CPU had its turn (see `EndRound`).
 void
 Interrupt::OneTick()
 {
     MachineStatus old = status;
+    unsigned ticks = status == SYSTEM_MODE ? SYSTEM_TICK : USER_TICK;
+
+    if (numCpus > 1) {
+        if (status == SYSTEM_MODE)
+            stats->systemTicks += ticks;
+        else
+            stats->userTicks += ticks;
+
+        ChangeLevel(INT_ON, INT_OFF);
+        // The turn of the next CPU.
+        if (currentCpu->Charge(ticks, status == USER_MODE)) {
+            status = SYSTEM_MODE;
+            scheduler->SwitchCpu();
+            status = old;
+        }
+        ChangeLevel(INT_OFF, INT_ON);
+        if (yieldOnReturn || currentCpu->yieldOnReturn) {
+            yieldOnReturn = false;
+            currentCpu->yieldOnReturn = false;
+            status = SYSTEM_MODE;
+            currentThread->Yield();
+            status = old;
+        }
+        return;
+    }
 
     // Advance simulated time.
     if (status == SYSTEM_MODE) {
@@ -133,6 +161,7 @@ Interrupt::OneTick()
     stats->totalTicks += USER_TICK;
     stats->userTicks += USER_TICK;
     }
+    currentCpu->Charge(ticks, status == USER_MODE);
     DEBUG('i', "\n== Tick %u ==\n", stats->totalTicks);
 
     // Check any pending interrupts are now ready to fire.
@@ -150,6 +179,17 @@ Interrupt::OneTick()
     }
 }
 
+void
+Interrupt::EndRound()
+{
+    ASSERT(level == INT_OFF);
+
+    stats->totalTicks += CPU_SLICE;
+    DEBUG('i', "\n== Tick %u ==\n", stats->totalTicks);
+    while (CheckIfDue(false))
+        ;
+}
+
 /// Called from within an interrupt handler, to cause a context switch (for
 /// example, on a time slice) in the interrupted thread, when the handler
 /// returns.
@@ -201,7 +241,13 @@ void
 Interrupt::Halt()
 {
     printf("Machine halting!\n\n");
-    stats->Print();
+    scheduler->PrintShares();
+    scheduler->PrintCpus();
+    accounting->Print();
+#ifdef USER_PROGRAM
+    syscallStats->Print();
+#endif
+    stats->Print(numCpus);
     Cleanup();  // Never returns.
 }
 
@@ -223,6 +269,7 @@ void Interrupt::RestartTicks()
     while ((i = oldPending->SortedRemove((int *) &oldWhen)) != NULL)
     {
         newWhen = oldWhen - stats->totalTicks;
+        i->when = newWhen;
         pending->SortedInsert(i, newWhen);
         DEBUG('x', "Interrupt at time %u re-scheduled at new time %u.\n",
               oldWhen, newWhen);
@@ -247,7 +294,7 @@ void Interrupt::RestartTicks()
 /// * `fromNow` is how far in the future (in simulated time) the interrupt is
 ///   to occur.
 /// * `type` is the hardware device that generated the interrupt.
-void
+PendingInterrupt *
 Interrupt::Schedule(VoidFunctionPtr handler, void *arg,
                     unsigned fromNow, IntType type)
 {
@@ -260,7 +307,7 @@ Interrupt::Schedule(VoidFunctionPtr handler, void *arg,
     }
 #else
     // Terminate Nachos if the ticks overflowed.
-    ASSERT(UINT_MAX - stats->totalTicks < fromNow);
+    ASSERT(UINT_MAX - stats->totalTicks >= fromNow);
 #endif
 
     unsigned when = stats->totalTicks + fromNow;
@@ -272,6 +319,18 @@ Interrupt::Schedule(VoidFunctionPtr handler, void *arg,
     ASSERT(fromNow > 0);
 
     pending->SortedInsert(toOccur, when);
+    return toOccur;
+}
+
+/// Used by the timer, which reprograms itself under dynamic ticks.
+void
+Interrupt::Cancel(PendingInterrupt *toCancel)
+{
+    DEBUG('i', "Cancelling interrupt handler the %s at time = %u\n",
+          INT_TYPE_NAMES[toCancel->type], toCancel->when);
+    bool found = pending->RemoveItem(toCancel);
+    ASSERT(found);
+    delete toCancel;
 }
 
 /// Check if an interrupt is scheduled to occur, and if so, fire it off.
@@ -305,9 +364,10 @@ Interrupt::CheckIfDue(bool advanceClock)
         return false;
     }
 
-    // Check if there is nothing more to do, and if so, quit.
+    // Check if there is nothing more to do, and if so, quit.  Threads
+    // sleeping on the alarm clock need the timer to wake up.
     if (status == IDLE_MODE && toOccur->type == TIMER_INT
-          && pending->IsEmpty()) {
+          && pending->IsEmpty() && alarmClock->IsEmpty()) {
         pending->SortedInsert(toOccur, when);
         return false;
     }
@@ -318,6 +378,7 @@ Interrupt::CheckIfDue(bool advanceClock)
     if (machine != NULL)
         machine->DelayedLoad(0, 0);
 #endif
+    tracer->Record(TRACE_INTERRUPT, toOccur->type);
     inHandler = true;
     status = SYSTEM_MODE;  // Whatever we were doing, we are now going to be
                            // running in the kernel.
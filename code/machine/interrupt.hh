@@ -36,6 +36,7 @@
 
 
 #include "threads/list.hh"
+#include "threads/pool.hh"
 
 
 /// Interrupts can be disabled (`INT_OFF`) or enabled (`INT_ON`).
@@ -77,6 +78,18 @@ public:
     PendingInterrupt(VoidFunctionPtr func, void *param,
                      unsigned time, IntType kind);
 
+    /// Devices schedule an interrupt on every operation, so these are
+    /// recycled through a `Pool`.
+    void *operator new(size_t size)
+    {
+        return Pool<PendingInterrupt>::Get(size);
+    }
+
+    void operator delete(void *p)
+    {
+        Pool<PendingInterrupt>::Put(p);
+    }
+
     VoidFunctionPtr handler;  ///< The function (in the hardware device
                               ///< emulator) to call when the interrupt
                               ///< occurs.
@@ -143,13 +156,21 @@ public:
 
     /// Schedule an interrupt to occur at time ``when''.
     ///
-    /// This is called by the hardware device simulators.
-    void Schedule(VoidFunctionPtr handler, void *arg,
-                  unsigned when, IntType type);
+    /// This is called by the hardware device simulators.  The result
+    /// identifies the interrupt for `Cancel`.
+    PendingInterrupt *Schedule(VoidFunctionPtr handler, void *arg,
+                               unsigned when, IntType type);
+
+    /// Take back `toCancel`, scheduled and not occurred yet.
+    void Cancel(PendingInterrupt *toCancel);
 
     /// Advance simulated time.
     void OneTick();
 
+    /// Under SMP, every CPU had its turn: advance simulated time by a turn
+    /// and fire the interrupts due.
+    void EndRound();
+
 private:
     IntStatus level;  ///< Are interrupts enabled or disabled?
     List<PendingInterrupt *> *pending;  ///< The list of interrupts scheduled
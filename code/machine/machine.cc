@@ -59,7 +59,7 @@ Machine::Machine(bool debug)
     for (unsigned i = 0; i < TLB_SIZE; i++)
         tlb[i].valid = false;
     pageTable = NULL;
-#else  // Use linear page table.
+#else  // Use the page table.
     tlb = NULL;
     pageTable = NULL;
 #endif
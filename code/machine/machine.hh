@@ -23,6 +23,7 @@
 
 #include "disk.hh"
 #include "translation_entry.hh"
+#include "page_table.hh"
 #include "threads/utility.hh"
 
 
@@ -158,7 +159,7 @@ public:
     /// * a software-loaded translation lookaside buffer (tlb) -- a cache of
     ///   mappings of virtual page #'s to physical page #'s.
     ///
-    /// If `tlb` is NULL, the linear page table is used.
+    /// If `tlb` is NULL, the (two-level) page table is used.
     /// If `tlb` is non-NULL, the Nachos kernel is responsible for managing
     /// the contents of the TLB.  But the kernel can use any data structure
     /// it wants (eg, segmented paging) for handling TLB cache misses.
@@ -173,8 +174,7 @@ public:
     TranslationEntry *tlb;  ///< This pointer should be considered
                             ///< “read-only” to Nachos kernel code.
 
-    TranslationEntry *pageTable;
-    unsigned pageTableSize;
+    PageTable *pageTable;
 
     void printtlb();
   private:
@@ -560,6 +560,7 @@ Machine::OneInstruction(Instruction *instr)
       // For debugging, in case we are jumping into lala-land.
     registers[PC_REG] = registers[NEXT_PC_REG];
     registers[NEXT_PC_REG] = pcAfter;
+    accounting->Count(&Usage::instructions);
 }
 
 /// Simulate effects of a delayed load.
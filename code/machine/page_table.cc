@@ -0,0 +1,60 @@
+/// Routines to manage a sparse, two-level page table.
+///
+/// Copyright (c) 2016-2017 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "page_table.hh"
+
+
+PageTable::PageTable(unsigned n)
+{
+    numPages    = n;
+    numLeaves   = divRoundUp(n, PAGE_TABLE_LEAF_SIZE);
+    leavesInUse = 0;
+    directory   = new TranslationEntry * [numLeaves];
+    for (unsigned i = 0; i < numLeaves; i++)
+        directory[i] = NULL;
+}
+
+PageTable::~PageTable()
+{
+    for (unsigned i = 0; i < numLeaves; i++)
+        delete [] directory[i];
+    delete [] directory;
+}
+
+TranslationEntry *
+PageTable::Find(unsigned vpn) const
+{
+    if (vpn >= numPages)
+        return NULL;
+
+    TranslationEntry *leaf = directory[vpn / PAGE_TABLE_LEAF_SIZE];
+    if (leaf == NULL)
+        return NULL;
+    return &leaf[vpn % PAGE_TABLE_LEAF_SIZE];
+}
+
+TranslationEntry &
+PageTable::operator[](unsigned vpn)
+{
+    ASSERT(vpn < numPages);
+
+    TranslationEntry *&leaf = directory[vpn / PAGE_TABLE_LEAF_SIZE];
+    if (leaf == NULL) {
+        unsigned first = vpn - vpn % PAGE_TABLE_LEAF_SIZE;
+        leaf = new TranslationEntry[PAGE_TABLE_LEAF_SIZE];
+        for (unsigned i = 0; i < PAGE_TABLE_LEAF_SIZE; i++) {
+            leaf[i].virtualPage  = first + i;
+            leaf[i].physicalPage = -1;
+            leaf[i].valid        = false;
+            leaf[i].readOnly     = false;
+            leaf[i].use          = false;
+            leaf[i].dirty        = true;  // Not in swap yet.
+        }
+        leavesInUse++;
+    }
+    return leaf[vpn % PAGE_TABLE_LEAF_SIZE];
+}
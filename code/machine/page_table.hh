@@ -0,0 +1,57 @@
+/// Data structures for a sparse, two-level page table.
+///
+/// A page table covers a fixed range of virtual pages, but only the pieces
+/// (“leaves”) that contain touched pages are allocated; the rest cost one
+/// NULL pointer in the directory.  The simulated MMU walks it directly when
+/// there is no TLB; with a TLB it is what the kernel refills the TLB from.
+///
+/// Copyright (c) 2016-2017 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_MACHINE_PAGETABLE__HH
+#define NACHOS_MACHINE_PAGETABLE__HH
+
+
+#include "translation_entry.hh"
+
+
+/// Number of consecutive virtual pages held in one leaf.
+const unsigned PAGE_TABLE_LEAF_SIZE = 64;
+
+class PageTable {
+public:
+
+    /// Create an empty table that covers virtual pages `0..numPages-1`.
+    PageTable(unsigned numPages);
+
+    ~PageTable();
+
+    /// Number of virtual pages covered by the table.
+    unsigned Size() const { return numPages; }
+
+    /// Return the entry for `vpn`, or NULL if `vpn` is out of range or
+    /// nothing near it was ever touched.  Never allocates.
+    TranslationEntry *Find(unsigned vpn) const;
+
+    /// Return the entry for `vpn`, allocating its leaf if needed.  Fresh
+    /// entries describe a page not loaded yet (`valid` off, no frame).
+    TranslationEntry &operator[](unsigned vpn);
+
+    /// Number of leaves allocated so far.
+    unsigned LeavesInUse() const { return leavesInUse; }
+
+private:
+
+    /// Not copyable: leaves belong to exactly one table.
+    PageTable(const PageTable &);
+    PageTable &operator=(const PageTable &);
+
+    unsigned numPages;
+    unsigned numLeaves;
+    unsigned leavesInUse;
+    TranslationEntry **directory;
+};
+
+
+#endif
@@ -21,6 +21,8 @@ Statistics::Statistics()
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
     numTLBHits = numTLBMisses = 0;
     swaps_in = swaps_out = 0;
+    cowCopies = 0;
+    numContextSwitches = 0;
     numFrames = -1;
 #ifdef DFS_TICKS_FIX
     tickResets = 0;
@@ -30,16 +32,26 @@ Statistics::Statistics()
 
 /// Print performance metrics, when we have finished everything at system
 /// shutdown.
+///
+/// With several CPUs, system and user time are CPU time, of all of them
+/// together, and are told apart from the elapsed time; the share of each
+/// CPU is in the scheduler's report.
 void
-Statistics::Print()
+Statistics::Print(unsigned cpus)
 {
 #ifdef DFS_TICKS_FIX
     if (tickResets != 0)
         printf("WARNING: the tick counter was reset %lu times; the following"
                " statistics may be invalid.\n\n", tickResets);
 #endif
-    printf("Ticks: total %u, idle %u, system %u, user %u\n",
-           totalTicks, idleTicks, systemTicks, userTicks);
+    if (cpus > 1)
+        printf("Ticks: total %u, idle %u; CPU time of %u CPUs: system %u,"
+               " user %u, out of %lu\n", totalTicks, idleTicks, cpus,
+               systemTicks, userTicks, (unsigned long) totalTicks * cpus);
+    else
+        printf("Ticks: total %u, idle %u, system %u, user %u\n",
+               totalTicks, idleTicks, systemTicks, userTicks);
+    printf("Threads: context switches %u\n", numContextSwitches);
     printf("Disk I/O: reads %u, writes %u\n", numDiskReads, numDiskWrites);
     printf("Console I/O: reads %u, writes %u\n",
            numConsoleCharsRead, numConsoleCharsWritten);
@@ -54,6 +66,8 @@ Statistics::Print()
 
     printf("Paging: swaps_in %u\n", swaps_in);
     printf("Paging: swaps_out %u\n", swaps_out);
+    if (cowCopies != 0)
+        printf("Paging: copy-on-write copies %u\n", cowCopies);
     //calculateStatsOptimalPGA();
 
     printf("Network I/O: packets received %u, sent %u\n",
@@ -26,11 +26,12 @@ public:
     /// Time spent idle (no threads to run).
     unsigned idleTicks;
 
-    /// Time spent executing system code.
+    /// Time spent executing system code.  With several CPUs, the sum of
+    /// theirs, which may well exceed `totalTicks`.
     unsigned systemTicks;
 
     /// Time spent executing user code (this is also equal to # of user
-    /// instructions executed).
+    /// instructions executed).  Summed over the CPUs, like `systemTicks`.
     unsigned userTicks;
 
     /// Number of disk read requests.
@@ -66,6 +67,12 @@ public:
     /// Memory to swap
     unsigned swaps_out;
 
+    /// Pages copied after a write to a frame shared by forked processes.
+    unsigned cowCopies;
+
+    /// Number of times the CPU switched from one thread to another.
+    unsigned numContextSwitches;
+
     // Optimal page replacement algorithm EDS.
     std::vector<int> referenced_pags;     //Trace of referenced vpns
     int numPages;
@@ -79,8 +86,8 @@ public:
     /// Initialize everything to zero.
     Statistics();
 
-    /// Print collected statistics.
-    void Print();
+    /// Print collected statistics, of a machine with `cpus` CPUs.
+    void Print(unsigned cpus = 1);
 
 private:
   
@@ -39,26 +39,67 @@ static void TimerHandler(void* arg)
 /// * `callArg` is the parameter to be passed to the interrupt handler.
 /// * `doRandom` -- if true, arrange for the interrupts to occur at random,
 ///   instead of fixed, intervals.
-Timer::Timer(VoidFunctionPtr timerHandler, void *callArg, bool doRandom)
+/// * `dynamic` -- if true, do not interrupt until programmed.
+Timer::Timer(VoidFunctionPtr timerHandler, void *callArg, bool doRandom,
+             bool dynamicTicks)
 {
-    randomize = doRandom;
-    handler   = timerHandler;
-    arg       = callArg;
+    randomize  = doRandom;
+    handler    = timerHandler;
+    arg        = callArg;
+    dynamic    = dynamicTicks;
+    next       = NULL;
+    interrupts = 0;
 
     // Schedule the first interrupt from the timer device.
-    interrupt->Schedule(TimerHandler, this, TimeOfNextInterrupt(),
-                        TIMER_INT);
+    if (!dynamic)
+        next = interrupt->Schedule(TimerHandler, this, TimeOfNextInterrupt(),
+                                   TIMER_INT);
+}
+
+void
+Timer::SetNext(unsigned fromNow)
+{
+    ASSERT(dynamic);
+
+    if (next != NULL)
+        interrupt->Cancel(next);
+    next = interrupt->Schedule(TimerHandler, this, fromNow > 0 ? fromNow : 1,
+                               TIMER_INT);
+}
+
+void
+Timer::DueWithin(unsigned fromNow)
+{
+    ASSERT(dynamic);
+
+    if (next == NULL || next->when > stats->totalTicks + fromNow)
+        SetNext(fromNow);
+}
+
+void
+Timer::Stop()
+{
+    ASSERT(dynamic);
+
+    if (next != NULL)
+        interrupt->Cancel(next);
+    next = NULL;
 }
 
 /// Routine to simulate the interrupt generated by the hardware timer device.
 ///
-/// Schedule the next interrupt, and invoke the interrupt handler.
+/// Schedule the next interrupt, unless the timer is dynamic, and invoke the
+/// interrupt handler.
 void
 Timer::TimerExpired()
 {
+    interrupts++;
+
     // Schedule the next timer device interrupt.
-    interrupt->Schedule(TimerHandler, this, TimeOfNextInterrupt(),
-                        TIMER_INT);
+    next = NULL;
+    if (!dynamic)
+        next = interrupt->Schedule(TimerHandler, this, TimeOfNextInterrupt(),
+                                   TIMER_INT);
 
     // Invoke the Nachos interrupt handler for this device.
     (*handler)(arg);
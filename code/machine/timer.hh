@@ -10,6 +10,10 @@
 /// In order to introduce some randomness into time-slicing, if `doRandom` is
 /// set, then the interrupt comes after a random number of ticks.
 ///
+/// If `dynamic` is set instead, the timer is not periodic: it starts
+/// stopped, and every interrupt comes when the kernel programs it with
+/// `SetNext`, if ever.
+///
 /// DO NOT CHANGE -- part of the machine emulation
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
@@ -24,16 +28,41 @@
 #include "threads/utility.hh"
 
 
+class PendingInterrupt;
+
 /// The following class defines a hardware timer.
 class Timer {
 public:
 
     /// Initialize the timer, to call the interrupt handler `timerHandler`
-    /// every time slice.
-    Timer(VoidFunctionPtr timerHandler, void *callArg, bool doRandom);
+    /// every time slice, or when programmed if `dynamic`.
+    Timer(VoidFunctionPtr timerHandler, void *callArg, bool doRandom,
+          bool dynamic = false);
 
     ~Timer() {}
 
+    bool IsDynamic()
+    {
+        return dynamic;
+    }
+
+    /// Dynamic timer only: interrupt `fromNow` ticks from now, instead of
+    /// when programmed before.
+    void SetNext(unsigned fromNow);
+
+    /// Dynamic timer only: interrupt within `fromNow` ticks from now, or
+    /// sooner if programmed so.
+    void DueWithin(unsigned fromNow);
+
+    /// Dynamic timer only: do not interrupt until programmed again.
+    void Stop();
+
+    /// Number of interrupts so far.
+    unsigned GetInterrupts()
+    {
+        return interrupts;
+    }
+
     /// Internal routines to the timer emulation -- DO NOT call these.
 
     /// Called internally when the hardware timer generates an interrupt.
@@ -46,6 +75,9 @@ private:
     bool randomize;  ///< Set if we need to use a random timeout delay.
     VoidFunctionPtr handler;  ///< Timer interrupt handler.
     void *arg;  ///< Argument to pass to interrupt handler.
+    bool dynamic;  ///< Set if the kernel programs every interrupt.
+    PendingInterrupt *next;  ///< Next interrupt, `NULL` if stopped.
+    unsigned interrupts;  ///< Interrupts so far.
 
 };
 
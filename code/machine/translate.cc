@@ -77,11 +77,19 @@ ShortToMachine(unsigned short shortword)
 }
 
 
+/// How many times a failed access is retried after the exception handler
+/// has had a chance to fix the fault.  A write may need two: one for a TLB
+/// miss (or a page not loaded yet) and one for a copy-on-write page.
+static const unsigned MEM_RETRIES = 2;
+
 /// Read `size` (1, 2, or 4) bytes of virtual memory at `addr` into
 /// the location pointed to by `value`.
 ///
 /// Returns false if the translation step from virtual to physical memory
-/// failed.
+/// still failed after the retries; the exception has been raised, and the
+/// simulator drops the instruction.  Kernel code copying to or from user
+/// memory, where a bad address is the program's fault, uses the checked
+/// copies of `userprog/transfer.hh` instead.
 ///
 /// * `addr` is the virtual address to read from.
 /// * `size` is the number of bytes to read (1, 2, or 4).
@@ -92,17 +100,12 @@ Machine::ReadMem(unsigned addr, unsigned size, int *value)
 
     DEBUG('a', "Reading VA 0x%X, size %u\n", addr, size);
 
-#ifdef USE_TLB
     bool success = ReadMemImp(addr,size,value, false);
-    if (!success) {
-        DEBUG('a', "Reattempting to read VA 0x%X, in case there was a TLB miss, size %u\n", addr, size);
+    for (unsigned i = 0; !success && i < MEM_RETRIES; i++) {
+        DEBUG('a', "Reattempting to read VA 0x%X, size %u\n", addr, size);
         success = ReadMemImp(addr,size,value, true);
-        ASSERT(success);
     }
     return success;
-#else
-    return ReadMemImp(addr,size,value);
-#endif
 }
 
 bool
@@ -148,18 +151,13 @@ Machine::WriteMem(unsigned addr, unsigned size, int value)
 {
     DEBUG('a', "Writing VA 0x%X, size %u, value 0x%X\n", addr, size, value);
 
-    #ifdef USE_TLB
-        bool success = WriteMemImp(addr,size,value, false);
-        if (!success) {
-            // machine->printtlb();
-            DEBUG('a', "REATTEMPT: Writing VA 0x%X, size %u, value 0x%X\n", addr, size,value);
-            success = WriteMemImp(addr,size,value, true);
-            ASSERT(success);
-        }
-        return success;
-    #else
-        return WriteMemImp(addr,size,value);
-    #endif
+    bool success = WriteMemImp(addr,size,value, false);
+    for (unsigned i = 0; !success && i < MEM_RETRIES; i++) {
+        // machine->printtlb();
+        DEBUG('a', "REATTEMPT: Writing VA 0x%X, size %u, value 0x%X\n", addr, size,value);
+        success = WriteMemImp(addr,size,value, true);
+    }
+    return success;
 
 }
 /// Write `size` (1, 2, or 4) bytes of the contents of `value` into virtual
@@ -246,16 +244,16 @@ Machine::Translate(unsigned virtAddr, unsigned *physAddr,
     // Para el cálculo del algoritmo óptimo offline
     stats->referenced_pags.push_back(vpn);
 
-    if (tlb == NULL) {        // => page table => `vpn` is index into table.
-        if (vpn >= pageTableSize || vpn < 0) {
+    if (tlb == NULL) {        // => page table => walk it for `vpn`.
+        if (vpn >= pageTable->Size()) {
             DEBUG('a',
                   "virtual page # %u too large for page table size %u!\n",
-                  virtAddr, pageTableSize);
+                  virtAddr, pageTable->Size());
             return ADDRESS_ERROR_EXCEPTION;
-        } else if (!pageTable[vpn].valid) {
-            return PAGE_FAULT_EXCEPTION;
         }
-        entry = &pageTable[vpn];
+        entry = pageTable->Find(vpn);
+        if (entry == NULL || !entry->valid || entry->physicalPage < 0)
+            return PAGE_FAULT_EXCEPTION;  // Let the kernel decide.
     } 
     else    // => using tlb!
     {
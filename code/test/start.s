@@ -19,6 +19,10 @@
         .globl  __start
         .ent    __start
 __start:
+        la      $4, AtomicStart  // Tell the kernel where `CompareAndSwap` is.
+        la      $5, AtomicEnd
+        addiu   $2, $0, SC_SetAtomicRange
+        syscall
         jal     main
         move    $4, $0
         jal     Exit  // If we return from `main`, `exit(0)`.
@@ -110,11 +114,19 @@ Close:
         .globl  Fork
         .ent    Fork
 Fork:
+        la      $5, ForkReturn  // Where the new thread returns from `func`.
         addiu   $2, $0, SC_Fork
         syscall
         j       $31
         .end    Fork
 
+/// A thread created with `Fork` comes here when its function returns.
+        .ent    ForkReturn
+ForkReturn:
+        move    $4, $0
+        jal     Exit
+        .end    ForkReturn
+
         .globl  Yield
         .ent    Yield
 Yield:
@@ -123,6 +135,106 @@ Yield:
         j       $31
         .end    Yield
 
+        .globl  ForkProcess
+        .ent    ForkProcess
+ForkProcess:
+        addiu   $2, $0, SC_ForkProcess
+        syscall
+        j       $31
+        .end    ForkProcess
+
+        .globl  Mmap
+        .ent    Mmap
+Mmap:
+        addiu   $2, $0, SC_Mmap
+        syscall
+        j       $31
+        .end    Mmap
+
+        .globl  Munmap
+        .ent    Munmap
+Munmap:
+        addiu   $2, $0, SC_Munmap
+        syscall
+        j       $31
+        .end    Munmap
+
+        .globl  Sbrk
+        .ent    Sbrk
+Sbrk:
+        addiu   $2, $0, SC_Sbrk
+        syscall
+        j       $31
+        .end    Sbrk
+
+        .globl  WaitAny
+        .ent    WaitAny
+WaitAny:
+        addiu   $2, $0, SC_WaitAny
+        syscall
+        j       $31
+        .end    WaitAny
+
+        .globl  SetWeight
+        .ent    SetWeight
+SetWeight:
+        addiu   $2, $0, SC_SetWeight
+        syscall
+        j       $31
+        .end    SetWeight
+
+        .globl  Sleep
+        .ent    Sleep
+Sleep:
+        addiu   $2, $0, SC_Sleep
+        syscall
+        j       $31
+        .end    Sleep
+
+        .globl  FutexWait
+        .ent    FutexWait
+FutexWait:
+        addiu   $2, $0, SC_FutexWait
+        syscall
+        j       $31
+        .end    FutexWait
+
+        .globl  FutexWake
+        .ent    FutexWake
+FutexWake:
+        addiu   $2, $0, SC_FutexWake
+        syscall
+        j       $31
+        .end    FutexWake
+
+        .globl  Stats
+        .ent    Stats
+Stats:
+        addiu   $2, $0, SC_Stats
+        syscall
+        j       $31
+        .end    Stats
+
+/// Compare and swap, as a restartable atomic sequence: if the thread is
+/// switched out between `AtomicStart` and `AtomicEnd`, the kernel moves it
+/// back to `AtomicStart`.  The store must be the last instruction, so
+/// that nothing has changed until the sequence is over.
+        .globl  CompareAndSwap
+        .ent    CompareAndSwap
+CompareAndSwap:
+        .set    noreorder
+AtomicStart:
+        lw      $2, 0($4)
+        nop                      // Load delay.
+        bne     $2, $5, AtomicEnd
+        nop
+        sw      $6, 0($4)
+AtomicEnd:
+        j       $31
+        nop
+        .set    reorder
+        .end    CompareAndSwap
+
 /// Dummy function to keep gcc happy.
         .globl  __main
         .ent    __main
@@ -0,0 +1,34 @@
+/*
+ * testFairShare.c
+ *
+ * Three children of weights 1024, 2048 and 4096 spin while the parent, of
+ * weight 1024, does a fixed amount of work and halts.  Run it with `-fair`:
+ * the CPU shares reported at halt should be close to 1:1:2:4.
+ */
+#include "syscall.h"
+
+#define WORK 200000
+
+int
+main(void)
+{
+    int i, weight;
+    volatile int spin = 0;
+
+    if (SetWeight(0) != -1) {
+        Write("SetWeight accepted 0 FAILED\n", 28, ConsoleOutput);
+        Halt();
+    }
+
+    for (weight = 1024; weight <= 4096; weight *= 2)
+        if (ForkProcess() == 0) {
+            SetWeight(weight);
+            for (;;)
+                spin++;
+        }
+
+    for (i = 0; i < WORK; i++)
+        spin++;
+    Write("parent done PASSED\n", 19, ConsoleOutput);
+    Halt();
+}
@@ -0,0 +1,91 @@
+/*
+ * testFork.c
+ *
+ * Threads sharing one address space.  As many threads as there are stack
+ * slots add up slices of a shared array, each on its own stack, yielding
+ * halfway through so that they run interleaved; one more `Fork` must fail
+ * meanwhile.  Then `main` exits, and a last thread, forked once a slot is
+ * free again, reports: the space must outlive `main`.
+ */
+#include "syscall.h"
+
+#define WORKERS  8    /* `USER_MAX_THREADS`. */
+#define N        800
+#define LEAF     16
+
+static int data[N];
+static int partial[WORKERS];
+static volatile int nextId, started, go;
+static volatile int finished[WORKERS];
+static int ok;
+
+/* Recursive, with a buffer on the stack that must survive a `Yield`. */
+static int
+Sum(int *a, int n)
+{
+    int copy[LEAF], i, s = 0;
+
+    if (n > LEAF)
+        return Sum(a, n / 2) + Sum(a + n / 2, n - n / 2);
+    for (i = 0; i < n; i++)
+        copy[i] = a[i];
+    Yield();
+    for (i = 0; i < n; i++)
+        s += copy[i];
+    return s;
+}
+
+static void
+Worker(void)
+{
+    int id = nextId;
+
+    started = 1;
+    while (!go)
+        Yield();
+    partial[id] = Sum(data + id * (N / WORKERS), N / WORKERS);
+    finished[id] = 1;
+}  /* Returning is `Exit(0)`. */
+
+static void
+Report(void)
+{
+    if (ok)
+        Write("Fork test: PASSED\n", 18, ConsoleOutput);
+    else
+        Write("Fork test: FAILED\n", 18, ConsoleOutput);
+}
+
+int
+main(void)
+{
+    int i, sum = 0;
+
+    for (i = 0; i < N; i++)
+        data[i] = i;
+
+    ok = 1;
+    for (i = 0; i < WORKERS; i++) {
+        nextId = i;
+        started = 0;
+        if (Fork(Worker) < 0)
+            ok = 0;
+        while (!started)
+            Yield();
+    }
+    if (Fork(Worker) != -1)  /* No stack left. */
+        ok = 0;
+
+    go = 1;
+    for (i = 0; i < WORKERS; i++) {
+        while (!finished[i])
+            Yield();
+        sum += partial[i];
+    }
+    if (sum != N * (N - 1) / 2)
+        ok = 0;
+
+    while (Fork(Report) < 0)  /* Until a worker is gone. */
+        Yield();
+    Exit(0);
+}
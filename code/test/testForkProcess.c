@@ -0,0 +1,50 @@
+/*
+ * testForkProcess.c
+ *
+ * The parent fills an array and forks.  The child overwrites its copy and
+ * checks it; the parent waits for the child and checks that its own copy
+ * was not touched.  Under VMEM the array pages are shared copy-on-write
+ * until the child writes them.
+ */
+#include "syscall.h"
+
+#define N 256
+
+int array[N];
+
+int
+main(void)
+{
+    int i;
+    SpaceId child;
+
+    for (i = 0; i < N; i++)
+        array[i] = i;
+
+    child = ForkProcess();
+    if (child < 0) {
+        Write("ForkProcess failed FAILED\n", 26, ConsoleOutput);
+        Halt();
+    }
+
+    if (child == 0) {
+        for (i = 0; i < N; i++)
+            array[i] = -i;
+        for (i = 0; i < N; i++)
+            if (array[i] != -i) {
+                Write("child sees a wrong value FAILED\n", 32, ConsoleOutput);
+                Exit(1);
+            }
+        Write("child done\n", 11, ConsoleOutput);
+        Exit(0);
+    }
+
+    Join(child);
+    for (i = 0; i < N; i++)
+        if (array[i] != i) {
+            Write("parent copy was modified FAILED\n", 32, ConsoleOutput);
+            Halt();
+        }
+    Write("parent copy intact PASSED\n", 26, ConsoleOutput);
+    Halt();
+}
@@ -0,0 +1,63 @@
+/*
+ * testFutex.c
+ *
+ * `usync` mutexes and condition variables.  First `main` alone takes and
+ * releases a mutex and signals a condition nobody waits on, which must not
+ * enter the kernel (check with `-d s`).  Then four threads add to a shared
+ * counter under the mutex, yielding inside the critical section so that
+ * the others find it taken, and `main` waits on the condition until all of
+ * them are done.  Try it with `-rs` too.
+ */
+#include "syscall.h"
+#include "usync.h"
+
+#define WORKERS  4
+#define ROUNDS   100
+
+static Mutex mutex = MUTEX_INITIALIZER;
+static Condvar allDone = CONDVAR_INITIALIZER;
+static int counter, done;
+
+static void
+Worker(void)
+{
+    int i, c;
+
+    for (i = 0; i < ROUNDS; i++) {
+        MutexLock(&mutex);
+        c = counter;
+        if (i % 2 == 0)
+            Yield();
+        counter = c + 1;
+        MutexUnlock(&mutex);
+    }
+    MutexLock(&mutex);
+    done++;
+    CondSignal(&allDone);
+    MutexUnlock(&mutex);
+}
+
+int
+main(void)
+{
+    int i;
+
+    for (i = 0; i < 50; i++) {
+        MutexLock(&mutex);
+        MutexUnlock(&mutex);
+        CondSignal(&allDone);
+    }
+
+    for (i = 0; i < WORKERS; i++)
+        Fork(Worker);
+    MutexLock(&mutex);
+    while (done < WORKERS)
+        CondWait(&allDone, &mutex);
+    MutexUnlock(&mutex);
+
+    if (counter == WORKERS * ROUNDS)
+        Write("Futex test: PASSED\n", 19, ConsoleOutput);
+    else
+        Write("Futex test: FAILED\n", 19, ConsoleOutput);
+    Halt();
+}
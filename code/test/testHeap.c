@@ -0,0 +1,68 @@
+/*
+ * testHeap.c
+ *
+ * Exercise the heap and the stack of a sparse address space: allocate and
+ * fill a few blocks with `malloc`, check them, free them in a different
+ * order and allocate again, then recurse deep enough to need many more
+ * stack pages than the old fixed 1KB stack.
+ */
+#include "syscall.h"
+#include "umalloc.h"
+
+#define BLOCKS 8
+#define DEPTH  200
+
+static void
+Fail(char *msg, int len)
+{
+    Write(msg, len, ConsoleOutput);
+    Write(" FAILED\n", 8, ConsoleOutput);
+    Halt();
+}
+
+static int
+Depth(int n)
+{
+    int local[4];
+
+    local[0] = n;
+    if (n == 0)
+        return 0;
+    return Depth(n - 1) + 1 + local[0] - n;
+}
+
+int
+main(void)
+{
+    char *block[BLOCKS];
+    int i, j, size;
+
+    for (i = 0; i < BLOCKS; i++) {
+        size = 100 + 60 * i;
+        block[i] = malloc(size);
+        if (block[i] == 0)
+            Fail("malloc", 6);
+        for (j = 0; j < size; j++)
+            block[i][j] = i;
+    }
+    for (i = 0; i < BLOCKS; i++)
+        for (j = 0; j < 100 + 60 * i; j++)
+            if (block[i][j] != i)
+                Fail("heap contents", 13);
+
+    for (i = 0; i < BLOCKS; i += 2)
+        free(block[i]);
+    for (i = 1; i < BLOCKS; i += 2)
+        free(block[i]);
+    block[0] = malloc(1000);
+    if (block[0] == 0)
+        Fail("malloc after free", 17);
+    free(block[0]);
+
+    if (Depth(DEPTH) != DEPTH)
+        Fail("deep recursion", 14);
+
+    Write("PASSED\n", 7, ConsoleOutput);
+    Halt();
+    return 0;
+}
@@ -0,0 +1,58 @@
+/*
+ * testMmap.c
+ *
+ * Write a file with `Write`, map it, check its contents through memory and
+ * change every byte in place, unmap it, and check with `Read` that the
+ * changes reached the file.  `SIZE` spans several pages, so the mapping is
+ * faulted in page by page.
+ */
+#include "syscall.h"
+
+#define SIZE 1000
+
+char buffer[SIZE];
+
+int
+main(void)
+{
+    char *name = "mmapTest.txt";
+    char *mapped;
+    OpenFileId fd;
+    int i;
+
+    for (i = 0; i < SIZE; i++)
+        buffer[i] = 'a' + i % 26;
+
+    Create(name);
+    fd = Open(name);
+    Write(buffer, SIZE, fd);
+    Close(fd);
+
+    mapped = (char *) Mmap(name, SIZE);
+    if ((int) mapped == -1) {
+        Write("Mmap failed FAILED\n", 19, ConsoleOutput);
+        Halt();
+    }
+    for (i = 0; i < SIZE; i++) {
+        if (mapped[i] != buffer[i]) {
+            Write("mapped contents differ FAILED\n", 30, ConsoleOutput);
+            Halt();
+        }
+        mapped[i] = 'A' + i % 26;
+    }
+    if (Munmap((int) mapped) != 0) {
+        Write("Munmap failed FAILED\n", 21, ConsoleOutput);
+        Halt();
+    }
+
+    fd = Open(name);
+    Read(buffer, SIZE, fd);
+    Close(fd);
+    for (i = 0; i < SIZE; i++)
+        if (buffer[i] != 'A' + i % 26) {
+            Write("changes not written back FAILED\n", 32, ConsoleOutput);
+            Halt();
+        }
+    Write("mapped file written back PASSED\n", 32, ConsoleOutput);
+    Halt();
+}
@@ -0,0 +1,31 @@
+/*
+ * testSleep.c
+ *
+ * Two children sleep for different times and then write their names; the
+ * one that sleeps less must write first, even though it is forked last.
+ * The parent sleeps too, then waits for both.
+ */
+#include "syscall.h"
+
+int
+main(void)
+{
+    int status;
+
+    if (ForkProcess() == 0) {
+        Sleep(5000);
+        Write("late\n", 5, ConsoleOutput);
+        Exit(0);
+    }
+    if (ForkProcess() == 0) {
+        Sleep(500);
+        Write("early\n", 6, ConsoleOutput);
+        Exit(0);
+    }
+
+    Sleep(100);
+    while (WaitAny(&status) >= 0)
+        ;
+    Write("done\n", 5, ConsoleOutput);
+    Halt();
+}
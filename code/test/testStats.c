@@ -0,0 +1,52 @@
+/*
+ * testStats.c
+ *
+ * Measures two phases with `Stats`: writing to the console and sleeping.
+ * Each phase must show up in the counters of its own system call, with
+ * the bytes written and the ticks slept, and the clock must move on.  The
+ * totals over every call must agree, `Stats` must refuse what is not a
+ * system call, and a child process must start from zero.
+ */
+#include "syscall.h"
+
+#define LINES 4
+
+int
+main(void)
+{
+    SyscallUsage before, after, all;
+    int t0, t1, t2, i, child, ok = 1;
+
+    t0 = Stats(SC_Write, &before);
+    for (i = 0; i < LINES; i++)
+        Write("phase one\n", 10, ConsoleOutput);
+    t1 = Stats(SC_Write, &after);
+    if (after.calls - before.calls != LINES
+          || after.bytes - before.bytes != 10 * LINES
+          || after.ticks <= before.ticks || t1 <= t0)
+        ok = 0;
+
+    Stats(SC_Sleep, &before);
+    Sleep(1000);
+    t2 = Stats(SC_Sleep, &after);
+    if (after.calls - before.calls != 1
+          || after.ticks - before.ticks < 1000 || t2 - t1 < 1000)
+        ok = 0;
+
+    Stats(-1, &all);
+    if (all.bytes != 10 * LINES || Stats(NUM_SYSCALLS, &all) != -1)
+        ok = 0;
+
+    if ((child = ForkProcess()) == 0) {
+        Stats(SC_Write, &before);
+        Exit(before.calls);
+    }
+    if (Join(child) != 0)
+        ok = 0;
+
+    if (ok)
+        Write("Stats test: PASSED\n", 19, ConsoleOutput);
+    else
+        Write("Stats test: FAILED\n", 19, ConsoleOutput);
+    Halt();
+}
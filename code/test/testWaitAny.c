@@ -0,0 +1,32 @@
+/*
+ * testWaitAny.c
+ *
+ * The parent forks children that exit at once with different statuses,
+ * then reaps them with `WaitAny` in whatever order they finish.  Once they
+ * are all reaped, `WaitAny` and `Join` must fail.
+ */
+#include "syscall.h"
+
+#define CHILDREN 2
+
+int
+main(void)
+{
+    int i, id, status, sum = 0, reaped = 0;
+
+    for (i = 1; i <= CHILDREN; i++)
+        if (ForkProcess() == 0)
+            Exit(i);
+
+    while ((id = WaitAny(&status)) >= 0) {
+        sum += status;
+        reaped++;
+    }
+
+    if (reaped == CHILDREN && sum == CHILDREN * (CHILDREN + 1) / 2
+          && Join(1) == -1)
+        Write("reaped every child PASSED\n", 26, ConsoleOutput);
+    else
+        Write("reaped the wrong children FAILED\n", 33, ConsoleOutput);
+    Halt();
+}
@@ -0,0 +1,93 @@
+/*
+ * umalloc.c
+ *
+ * First-fit allocator over the heap grown with `Sbrk`.  Every block starts
+ * with a header holding its size (header included, multiple of 8) and a
+ * free flag; blocks are laid out back to back from the first `Sbrk`, so
+ * walking the heap needs no explicit list.  Freeing merges with the
+ * following free blocks, and a free block at the top of the heap is given
+ * back to the kernel.
+ */
+#include "syscall.h"
+#include "umalloc.h"
+
+#define ALIGN     8
+#define HEADER    ALIGN
+#define MIN_GROW  1024
+
+typedef struct {
+    unsigned size;
+    unsigned free;
+} Header;
+
+static char *heapStart;
+static char *heapEnd;
+
+static Header *
+Grow(unsigned size)
+{
+    Header *h;
+    char *p;
+
+    if (size < MIN_GROW)
+        size = MIN_GROW;
+    p = Sbrk(size);
+    if ((int) p == -1)
+        return 0;
+    if (heapStart == 0)
+        heapStart = p;
+    heapEnd = p + size;
+    h = (Header *) p;
+    h->size = size;
+    h->free = 1;
+    return h;
+}
+
+void *
+malloc(unsigned size)
+{
+    Header *h, *rest;
+    char *p;
+
+    if (size == 0)
+        return 0;
+    size = (size + HEADER + ALIGN - 1) & ~(ALIGN - 1);
+
+    for (p = heapStart; p != heapEnd; p += h->size) {
+        h = (Header *) p;
+        if (h->free && h->size >= size)
+            break;
+    }
+    if (p == heapEnd && (h = Grow(size)) == 0)
+        return 0;
+
+    if (h->size >= size + HEADER + ALIGN) {  /* Split. */
+        rest = (Header *) ((char *) h + size);
+        rest->size = h->size - size;
+        rest->free = 1;
+        h->size = size;
+    }
+    h->free = 0;
+    return (char *) h + HEADER;
+}
+
+void
+free(void *ptr)
+{
+    Header *h, *next;
+
+    if (ptr == 0)
+        return;
+    h = (Header *) ((char *) ptr - HEADER);
+    h->free = 1;
+    for (;;) {
+        next = (Header *) ((char *) h + h->size);
+        if ((char *) next == heapEnd || !next->free)
+            break;
+        h->size += next->size;
+    }
+    if ((char *) h + h->size == heapEnd && (char *) h != heapStart) {
+        Sbrk(-(int) h->size);
+        heapEnd = (char *) h;
+    }
+}
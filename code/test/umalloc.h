@@ -0,0 +1,15 @@
+/*
+ * umalloc.h
+ *
+ * A small first-fit allocator for user programs, on top of `Sbrk`.  Link
+ * `umalloc.o` after `start.o` and the program's own object file.
+ */
+#ifndef NACHOS_TEST_UMALLOC__H
+#define NACHOS_TEST_UMALLOC__H
+
+
+void *malloc(unsigned size);
+void free(void *p);
+
+
+#endif
@@ -0,0 +1,87 @@
+/*
+ * usync.c
+ *
+ * The mutex follows Drepper's “Futexes are tricky”: a free mutex is taken
+ * with a single compare-and-swap; a thread that finds it taken marks it
+ * contended (2) and sleeps on it, and only the release of a contended
+ * mutex wakes a thread up.  A thread woken up takes it as contended, since
+ * others may still be waiting.
+ *
+ * A condition variable counts its waiters, so that signalling one nobody
+ * waits on does not enter the kernel either.
+ */
+#include "syscall.h"
+#include "usync.h"
+
+static int
+Exchange(volatile int *p, int value)
+{
+    int old;
+
+    do
+        old = *p;
+    while (CompareAndSwap(p, old, value) != old);
+    return old;
+}
+
+static void
+Add(volatile int *p, int delta)
+{
+    int old;
+
+    do
+        old = *p;
+    while (CompareAndSwap(p, old, old + delta) != old);
+}
+
+void
+MutexLock(Mutex *m)
+{
+    int c = CompareAndSwap(&m->state, 0, 1);
+
+    if (c == 0)
+        return;
+    if (c != 2)
+        c = Exchange(&m->state, 2);
+    while (c != 0) {
+        FutexWait(&m->state, 2);
+        c = Exchange(&m->state, 2);
+    }
+}
+
+void
+MutexUnlock(Mutex *m)
+{
+    if (Exchange(&m->state, 0) == 2)
+        FutexWake(&m->state, 1);
+}
+
+void
+CondWait(Condvar *c, Mutex *m)
+{
+    int sequence;
+
+    Add(&c->waiters, 1);
+    sequence = c->sequence;
+    MutexUnlock(m);
+    FutexWait(&c->sequence, sequence);
+    Add(&c->waiters, -1);
+    while (Exchange(&m->state, 2) != 0)
+        FutexWait(&m->state, 2);
+}
+
+void
+CondSignal(Condvar *c)
+{
+    Add(&c->sequence, 1);
+    if (c->waiters > 0)
+        FutexWake(&c->sequence, 1);
+}
+
+void
+CondBroadcast(Condvar *c)
+{
+    Add(&c->sequence, 1);
+    if (c->waiters > 0)
+        FutexWake(&c->sequence, 0x7FFFFFFF);
+}
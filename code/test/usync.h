@@ -0,0 +1,39 @@
+/*
+ * usync.h
+ *
+ * Mutexes and condition variables for threads of the same user program
+ * (see `Fork`), on top of `CompareAndSwap` and the futex system calls.
+ * Taking a free mutex and releasing one nobody waits for do not enter the
+ * kernel.  Link `usync.o` after `start.o` and the program's own object
+ * file.
+ */
+#ifndef NACHOS_TEST_USYNC__H
+#define NACHOS_TEST_USYNC__H
+
+
+/* 0: free; 1: taken; 2: taken, maybe with waiters. */
+typedef struct {
+    volatile int state;
+} Mutex;
+
+/* `sequence` is bumped on every signal, and waiters sleep while it stays
+ * the same; signals only enter the kernel if there are `waiters`. */
+typedef struct {
+    volatile int sequence;
+    volatile int waiters;
+} Condvar;
+
+#define MUTEX_INITIALIZER    { 0 }
+#define CONDVAR_INITIALIZER  { 0, 0 }
+
+void MutexLock(Mutex *m);
+void MutexUnlock(Mutex *m);
+
+/* Release `m`, wait to be signalled, and take `m` again.  Wake-ups may be
+ * spurious, so wait in a loop that checks the condition. */
+void CondWait(Condvar *c, Mutex *m);
+void CondSignal(Condvar *c);
+void CondBroadcast(Condvar *c);
+
+
+#endif
@@ -0,0 +1,191 @@
+/// Routines for resource accounting.
+///
+/// Copyright (c) 2016-2017 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "accounting.hh"
+#include "system.hh"
+
+
+Accounting::Accounting(bool enabled, bool reportCsv)
+{
+    capacity = enabled ? 64 : 0;
+    records = capacity > 0 ? new UsageRecord [capacity] : NULL;
+    numRecords = 0;
+    csv = reportCsv;
+    headerPrinted = false;
+    for (unsigned c = 0; c < MAX_CPUS; c++) {
+        lastBusy[c] = 0;
+        lastUser[c] = 0;
+    }
+}
+
+Accounting::~Accounting()
+{
+    delete [] records;
+}
+
+int
+Accounting::AddRecord(const char *name, int pid)
+{
+    if (capacity == 0)
+        return -1;
+
+    if (numRecords == capacity) {
+        UsageRecord *bigger = new UsageRecord [2 * capacity];
+        memcpy(bigger, records, numRecords * sizeof *records);
+        delete [] records;
+        records = bigger;
+        capacity *= 2;
+    }
+    UsageRecord *record = &records[numRecords];
+    strncpy(record->name, name, sizeof record->name - 1);
+    record->name[sizeof record->name - 1] = '\0';
+    record->process = pid >= 0;
+    record->pid = pid;
+    memset(&record->usage, 0, sizeof record->usage);
+    return numRecords++;
+}
+
+void
+Accounting::CountOn(int record, unsigned long Usage::*counter, unsigned n)
+{
+    if (record < 0)
+        return;
+    ASSERT((unsigned) record < numRecords);
+    records[record].usage.*counter += n;
+}
+
+void
+Accounting::Count(unsigned long Usage::*counter, unsigned n)
+{
+    if (capacity == 0)
+        return;
+
+    CountOn(currentThread->usageRecord, counter, n);
+#ifdef USER_PROGRAM
+    if (currentThread->space != NULL)
+        CountOn(currentThread->space->usageRecord, counter, n);
+#endif
+}
+
+void
+Accounting::CountFor(AddressSpace *space, unsigned long Usage::*counter)
+{
+    if (capacity == 0)
+        return;
+
+    CountOn(currentThread->usageRecord, counter, 1);
+#ifdef USER_PROGRAM
+    CountOn(space->usageRecord, counter, 1);
+#endif
+}
+
+/// The counters of a CPU only move while it runs a thread, so whatever they
+/// moved since the last charge on that CPU belongs to `thread`.
+void
+Accounting::ChargeTicks(Thread *thread)
+{
+    if (capacity == 0)
+        return;
+
+    Cpu *cpu = cpus[thread->cpu];
+    unsigned id = cpu->GetId();
+    unsigned long busy = cpu->busyTicks - lastBusy[id];
+    unsigned long user = cpu->userTicks - lastUser[id];
+    lastBusy[id] = cpu->busyTicks;
+    lastUser[id] = cpu->userTicks;
+
+    int owners[2] = { thread->usageRecord, -1 };
+#ifdef USER_PROGRAM
+    if (thread->space != NULL) {
+        owners[1] = thread->space->usageRecord;
+        if (owners[0] >= 0 && owners[1] >= 0)
+            records[owners[0]].pid = records[owners[1]].pid;
+    }
+#endif
+    for (unsigned i = 0; i < 2; i++) {
+        CountOn(owners[i], &Usage::userTicks, user);
+        CountOn(owners[i], &Usage::systemTicks, busy - user);
+    }
+}
+
+void
+Accounting::PrintHeader()
+{
+    if (headerPrinted)
+        return;
+    headerPrinted = true;
+
+    if (csv)
+        printf("kind,pid,name,user_ticks,system_ticks,instructions,"
+               "tlb_misses,page_faults,swaps_in,swaps_out,disk_sectors,"
+               "console_bytes\n");
+    else
+        printf("Accounting:\n"
+               "  kind     pid name                    user   system   "
+               "instrs tlb-miss   faults  swap-in swap-out  sectors  "
+               "console\n");
+}
+
+void
+Accounting::PrintRecord(const char *kind, const UsageRecord *record)
+{
+    const Usage &u = record->usage;
+
+    PrintHeader();
+    if (csv) {
+        printf("%s,", kind);
+        if (record->pid >= 0)
+            printf("%d", record->pid);
+        printf(",%s,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n", record->name,
+               u.userTicks, u.systemTicks, u.instructions, u.tlbMisses,
+               u.pageFaults, u.swapsIn, u.swapsOut, u.diskSectors,
+               u.consoleBytes);
+        return;
+    }
+    if (record->pid >= 0)
+        printf("  %-7s %4d", kind, record->pid);
+    else
+        printf("  %-7s %4s", kind, "-");
+    printf(" %-20s %8lu %8lu %8lu %8lu %8lu %8lu %8lu %8lu %8lu\n",
+           record->name, u.userTicks, u.systemTicks, u.instructions,
+           u.tlbMisses, u.pageFaults, u.swapsIn, u.swapsOut, u.diskSectors,
+           u.consoleBytes);
+}
+
+/// The CPU time of the thread that ends the process was charged as it
+/// finished, before letting go of its address space.
+void
+Accounting::PrintExit(int record)
+{
+    if (record < 0)
+        return;
+    PrintRecord("exit", &records[record]);
+}
+
+/// Processes first, then threads, each in order of creation.  The threads
+/// on a CPU are charged for their time so far first.  A table gets its
+/// header again, after the exits reported.
+void
+Accounting::Print()
+{
+    if (capacity == 0)
+        return;
+
+    if (!csv)
+        headerPrinted = false;
+
+    ChargeTicks(currentThread);
+    for (unsigned c = 0; c < numCpus; c++)
+        if (cpus[c]->current != NULL && cpus[c]->current != currentThread)
+            ChargeTicks(cpus[c]->current);
+    for (unsigned i = 0; i < numRecords; i++)
+        if (records[i].process)
+            PrintRecord("process", &records[i]);
+    for (unsigned i = 0; i < numRecords; i++)
+        if (!records[i].process)
+            PrintRecord("thread", &records[i]);
+}
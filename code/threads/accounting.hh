@@ -0,0 +1,101 @@
+/// Per-thread and per-process resource accounting (`-acct`).
+///
+/// Every thread, and every address space, gets a record of what it used:
+/// CPU time in user and kernel mode, user instructions completed, TLB
+/// misses, page faults, pages swapped in and out, disk sectors and console
+/// bytes.  Records outlive their owners, so that the report at halt shows
+/// every thread and process there was; and a process is also reported on
+/// its own when it exits.  The report is a table, or comma separated values
+/// with `-acct csv`.
+///
+/// CPU time is charged when a thread leaves its CPU (see `Scheduler::Run`),
+/// from the counters of the CPU; everything else when it happens, to the
+/// current thread and its address space.  A page swapped out goes to the
+/// space that loses it, but to the thread that had to make room.
+///
+/// Without `-acct` there are no records, and charging does nothing.
+///
+/// Copyright (c) 2016-2017 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_THREADS_ACCOUNTING__HH
+#define NACHOS_THREADS_ACCOUNTING__HH
+
+
+#include "cpu.hh"
+
+
+class Thread;
+class AddressSpace;
+
+/// Resources used.
+struct Usage {
+    unsigned long userTicks;
+    unsigned long systemTicks;
+    unsigned long instructions;
+    unsigned long tlbMisses;
+    unsigned long pageFaults;
+    unsigned long swapsIn;
+    unsigned long swapsOut;
+    unsigned long diskSectors;
+    unsigned long consoleBytes;
+};
+
+/// What a thread, or an address space, used.
+struct UsageRecord {
+    char name[24];
+    bool process;
+    int pid;  ///< Of the process, or of the last one a thread ran in.
+    Usage usage;
+};
+
+class Accounting {
+public:
+
+    /// Keep records if `enabled`, and report them as comma separated
+    /// values if `csv`.
+    Accounting(bool enabled, bool csv);
+
+    ~Accounting();
+
+    /// Start a record for a thread, or for the process `pid` if it is not
+    /// negative.  Return the record number, or -1 if not accounting.
+    int AddRecord(const char *name, int pid = -1);
+
+    /// Charge `n` of `counter` to the current thread and its address
+    /// space.
+    void Count(unsigned long Usage::*counter, unsigned n = 1);
+
+    /// Charge one of `counter` to the current thread and to `space`.
+    void CountFor(AddressSpace *space, unsigned long Usage::*counter);
+
+    /// Charge `thread` the CPU time its CPU used since the last charge.
+    void ChargeTicks(Thread *thread);
+
+    /// Report record `record`, of a process that exits.
+    void PrintExit(int record);
+
+    /// Report every record.
+    void Print();
+
+private:
+
+    /// Charge `n` of `counter` to record `record`, if any.
+    void CountOn(int record, unsigned long Usage::*counter, unsigned n);
+
+    void PrintHeader();
+    void PrintRecord(const char *kind, const UsageRecord *record);
+
+    UsageRecord *records;
+    unsigned numRecords, capacity;
+    bool csv;
+    bool headerPrinted;
+
+    /// CPU counters at the last charge, for every CPU.
+    unsigned long lastBusy[MAX_CPUS];
+    unsigned long lastUser[MAX_CPUS];
+};
+
+
+#endif
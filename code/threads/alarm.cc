@@ -0,0 +1,156 @@
+/// Routines for the alarm clock.
+///
+/// Copyright (c) 2016-2017 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "alarm.hh"
+#include "system.hh"
+
+#include <limits.h>
+
+
+Alarm::Alarm()
+{
+    next = 0;
+    armed = 0;
+}
+
+Alarm::~Alarm()
+{
+    for (unsigned i = 0; i < ALARM_SLOTS; i++)
+        while (wheel[i].Remove() != NULL)
+            ;
+}
+
+void
+Alarm::Sleep(unsigned ticks)
+{
+    if (ticks == 0)
+        return;
+
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    DEBUG('t', "Thread %s sleeps for %u ticks\n",
+          currentThread->getName(), ticks);
+    Arm(currentThread, Deadline(ticks), NULL);
+    currentThread->Sleep();
+    interrupt->SetLevel(oldLevel);
+}
+
+unsigned long
+Alarm::Deadline(unsigned ticks)
+{
+    return (unsigned long) stats->totalTicks + ticks;
+}
+
+/// The thread goes on the slot of the first timer interrupt at or after
+/// `deadline`, or on the next one to come if that has gone by.
+void
+Alarm::Arm(Thread *thread, unsigned long deadline, ThreadQueue *queue)
+{
+    ASSERT(interrupt->getLevel() == INT_OFF);
+    ASSERT(!thread->alarmHook.IsLinked());
+
+    // With nobody on the wheel, the timer may have stopped for a while.
+    if (armed == 0 && next < stats->totalTicks / ALARM_GRAIN)
+        next = stats->totalTicks / ALARM_GRAIN;
+
+    unsigned long slot = (deadline + ALARM_GRAIN - 1) / ALARM_GRAIN;
+    if (slot < next)
+        slot = next;
+    thread->alarmSlot = slot;
+    thread->timedQueue = queue;
+    thread->timedOut = false;
+    wheel[slot % ALARM_SLOTS].Append(thread);
+    armed++;
+
+    if (timer->IsDynamic())
+        timer->DueWithin(slot * ALARM_GRAIN > stats->totalTicks
+                         ? slot * ALARM_GRAIN - stats->totalTicks : 1);
+}
+
+void
+Alarm::Unlink(Thread *thread)
+{
+    wheel[thread->alarmSlot % ALARM_SLOTS].Unlink(thread);
+    armed--;
+}
+
+bool
+Alarm::Disarm(Thread *thread)
+{
+    ASSERT(interrupt->getLevel() == INT_OFF);
+
+    if (thread->alarmHook.IsLinked())
+        Unlink(thread);
+    return !thread->timedOut;
+}
+
+/// Look at the slots from the next one on, up to `limit` or for a whole
+/// turn, whichever comes first.  A thread due in this turn ends the search;
+/// after a whole turn, every thread has been seen.
+unsigned long
+Alarm::NextDeadline(unsigned long limit)
+{
+    unsigned long earliest = ULONG_MAX;
+    unsigned long last = limit / ALARM_GRAIN;
+
+    if (armed == 0)
+        return limit;
+    for (unsigned long slot = next; slot <= last && slot < next + ALARM_SLOTS;
+         slot++) {
+        IntrusiveList<Thread, &Thread::alarmHook> *list =
+          &wheel[slot % ALARM_SLOTS];
+        for (Thread *thread = list->First(); thread != NULL;
+             thread = list->Next(thread)) {
+            if (thread->alarmSlot == slot)
+                return slot * ALARM_GRAIN < limit ? slot * ALARM_GRAIN : limit;
+            if (thread->alarmSlot < earliest)
+                earliest = thread->alarmSlot;
+        }
+    }
+    if (last < next + ALARM_SLOTS - 1)  // Nothing due up to `limit`.
+        return limit;
+    return earliest * ALARM_GRAIN < limit ? earliest * ALARM_GRAIN : limit;
+}
+
+/// Go through every slot passed since the last call, which may be more
+/// than one if the timer interrupts at random or the clock jumped ahead,
+/// but never more than a whole turn.
+void
+Alarm::Tick()
+{
+    unsigned long now = stats->totalTicks / ALARM_GRAIN;
+    if (armed == 0 || now < next) {
+        if (now >= next)
+            next = now + 1;
+        return;
+    }
+
+    unsigned long last = now - next < ALARM_SLOTS ? now
+                                                  : next + ALARM_SLOTS - 1;
+    for (unsigned long slot = next; slot <= last; slot++) {
+        IntrusiveList<Thread, &Thread::alarmHook> *list =
+          &wheel[slot % ALARM_SLOTS];
+        Thread *thread = list->First();
+        while (thread != NULL) {
+            Thread *following = list->Next(thread);
+            if (thread->alarmSlot <= now) {
+                Unlink(thread);
+                ThreadQueue *queue = thread->timedQueue;
+                if (queue == NULL)
+                    scheduler->ReadyToRun(thread);
+                else if (queue->Contains(thread)) {
+                    // Still waiting: it timed out.
+                    queue->Unlink(thread);
+                    thread->timedOut = true;
+                    scheduler->ReadyToRun(thread);
+                }
+                // Otherwise it has been woken up already.
+            }
+            thread = following;
+        }
+    }
+    next = now + 1;
+}
@@ -0,0 +1,91 @@
+/// Alarm clock: threads sleeping until a given time.
+///
+/// Sleeping threads are kept on a hashed timer wheel: `ALARM_SLOTS` lists,
+/// the timer interrupt advancing one slot every `ALARM_GRAIN` ticks.  A
+/// thread due in `n` slots goes on slot `(now + n) % ALARM_SLOTS`, whatever
+/// `n` is, so arming and disarming take constant time; a slot may hold
+/// threads due in later turns of the wheel, which stay there until then.
+/// Every timer interrupt wakes up all the threads due since the last one
+/// at once.
+///
+/// Besides plain sleeping, a thread may wait on some queue (of a
+/// `Semaphore` or a `Condition`) with a deadline: if it is still on the
+/// queue when the deadline passes, it is taken off and woken up, and told
+/// that it timed out.
+///
+/// Copyright (c) 2016-2017 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_THREADS_ALARM__HH
+#define NACHOS_THREADS_ALARM__HH
+
+
+#include "thread.hh"
+#include "machine/statistics.hh"
+
+
+/// Number of slots of the wheel.
+const unsigned ALARM_SLOTS = 256;
+
+/// Ticks per slot.  Deadlines are rounded up to a multiple of it.
+const unsigned ALARM_GRAIN = TIMER_TICKS;
+
+typedef IntrusiveList<Thread, &Thread::queueHook> ThreadQueue;
+
+class Alarm {
+public:
+
+    /// Initialize the wheel, with no thread sleeping.
+    Alarm();
+
+    /// Forget the threads still sleeping, if Nachos halts meanwhile.
+    ~Alarm();
+
+    /// Put the current thread to sleep for at least `ticks` ticks.
+    void Sleep(unsigned ticks);
+
+    /// The time `ticks` ticks from now, for `Arm`.
+    unsigned long Deadline(unsigned ticks);
+
+    /// Wake up `thread`, which is about to sleep, when `deadline` passes.
+    /// If `queue` is not `NULL`, take `thread` off it first, unless it was
+    /// taken off already.  Interrupts must be off.
+    void Arm(Thread *thread, unsigned long deadline, ThreadQueue *queue);
+
+    /// Cancel the alarm of `thread`, if still armed.  Return false if the
+    /// alarm took `thread` off its queue, that is, if it timed out.
+    /// Interrupts must be off.
+    bool Disarm(Thread *thread);
+
+    /// Wake up the threads whose deadline has passed.  Called on every
+    /// timer interrupt.
+    void Tick();
+
+    /// Time the first sleeping thread is due at, if not later than `limit`;
+    /// otherwise `limit`.
+    unsigned long NextDeadline(unsigned long limit);
+
+    /// Is no thread sleeping?
+    bool IsEmpty()
+    {
+        return armed == 0;
+    }
+
+private:
+
+    /// Take `thread` off the wheel.
+    void Unlink(Thread *thread);
+
+    IntrusiveList<Thread, &Thread::alarmHook> wheel[ALARM_SLOTS];
+
+    /// Next slot to go through, counted since the start (not modulo
+    /// `ALARM_SLOTS`).
+    unsigned long next;
+
+    /// Number of threads on the wheel.
+    unsigned armed;
+};
+
+
+#endif
@@ -0,0 +1,234 @@
+/// Bounded channels.
+///
+/// A `Channel<T>` carries values of type `T` from any number of senders to
+/// any number of receivers, through a ring buffer of fixed capacity.
+/// Unlike `Port`, a sender does not wait for its message to be received:
+/// it only blocks when the buffer is full, and a receiver only when it is
+/// empty, so a producer and a consumer can each run for as long as their
+/// quantum lasts instead of switching on every message.
+///
+/// Like `Semaphore`, a channel is built directly on disabled interrupts,
+/// and blocked threads wait on intrusive lists, so no operation allocates.
+/// A woken thread checks again whether it can proceed, since another one
+/// may have got there first.
+///
+/// Copyright (c) 2016-2017 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_THREADS_CHANNEL__HH
+#define NACHOS_THREADS_CHANNEL__HH
+
+
+#include "intrusive_list.hh"
+#include "system.hh"
+
+
+template <class T>
+class Channel {
+public:
+
+    /// Initialize a channel, empty, that buffers up to `capacity` values.
+    Channel(const char *debugName, unsigned capacity);
+
+    /// Nobody may be waiting on the channel.  Values still buffered are
+    /// lost.
+    ~Channel();
+
+    const char *GetName()
+    {
+        return name;
+    }
+
+    /// Put `item` in the channel, waiting while it is full.
+    void Send(T item);
+
+    /// Take the oldest value from the channel, waiting while it is empty.
+    T Receive();
+
+    /// Put `item` in the channel if there is room.  Never blocks.
+    bool TrySend(T item);
+
+    /// Take the oldest value into `*item`, if there is any.  Never blocks.
+    bool TryReceive(T *item);
+
+    /// Wait until the channel is not empty, then take up to `max` values
+    /// into `items`, oldest first.  Returns how many were taken.
+    unsigned ReceiveMany(T *items, unsigned max);
+
+    /// Number of values buffered.
+    unsigned Count()
+    {
+        return count;
+    }
+
+    unsigned GetCapacity()
+    {
+        return capacity;
+    }
+
+private:
+
+    /// Store `item` and wake up a receiver.  Interrupts must be off.
+    void Put(T item);
+
+    /// Take the oldest value and wake up a sender.  Interrupts must be off.
+    T Take();
+
+    /// Wake up the first thread in `queue`, if any.
+    static void WakeOne(IntrusiveList<Thread, &Thread::queueHook> *queue);
+
+    const char *name;
+
+    /// Ring buffer: `count` values starting at `head`.
+    T *buffer;
+    unsigned capacity;
+    unsigned head;
+    unsigned count;
+
+    /// Threads waiting for room, and for values, in arrival order.
+    IntrusiveList<Thread, &Thread::queueHook> senders;
+    IntrusiveList<Thread, &Thread::queueHook> receivers;
+};
+
+template <class T>
+Channel<T>::Channel(const char *debugName, unsigned capacity_)
+{
+    ASSERT(capacity_ > 0);
+
+    name     = debugName;
+    capacity = capacity_;
+    buffer   = new T [capacity];
+    head     = 0;
+    count    = 0;
+}
+
+template <class T>
+Channel<T>::~Channel()
+{
+    ASSERT(senders.IsEmpty() && receivers.IsEmpty());
+    delete [] buffer;
+}
+
+template <class T>
+void
+Channel<T>::WakeOne(IntrusiveList<Thread, &Thread::queueHook> *queue)
+{
+    Thread *thread = queue->Remove();
+    if (thread != NULL)
+        scheduler->ReadyToRun(thread);
+}
+
+template <class T>
+void
+Channel<T>::Put(T item)
+{
+    ASSERT(count < capacity);
+
+    buffer[(head + count) % capacity] = item;
+    count++;
+    WakeOne(&receivers);
+}
+
+template <class T>
+T
+Channel<T>::Take()
+{
+    ASSERT(count > 0);
+
+    T item = buffer[head];
+    head = (head + 1) % capacity;
+    count--;
+    WakeOne(&senders);
+    return item;
+}
+
+template <class T>
+void
+Channel<T>::Send(T item)
+{
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+
+    while (count == capacity) {
+        DEBUG('s', "%s waits to send on channel %s\n",
+              currentThread->getName(), name);
+        senders.Append(currentThread);
+        currentThread->Sleep();
+    }
+    Put(item);
+
+    interrupt->SetLevel(oldLevel);
+}
+
+template <class T>
+T
+Channel<T>::Receive()
+{
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+
+    while (count == 0) {
+        DEBUG('s', "%s waits to receive on channel %s\n",
+              currentThread->getName(), name);
+        receivers.Append(currentThread);
+        currentThread->Sleep();
+    }
+    T item = Take();
+
+    interrupt->SetLevel(oldLevel);
+    return item;
+}
+
+template <class T>
+bool
+Channel<T>::TrySend(T item)
+{
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+
+    bool sent = count < capacity;
+    if (sent)
+        Put(item);
+
+    interrupt->SetLevel(oldLevel);
+    return sent;
+}
+
+template <class T>
+bool
+Channel<T>::TryReceive(T *item)
+{
+    ASSERT(item != NULL);
+
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+
+    bool received = count > 0;
+    if (received)
+        *item = Take();
+
+    interrupt->SetLevel(oldLevel);
+    return received;
+}
+
+/// Every value taken frees a slot, so it wakes up one sender.
+template <class T>
+unsigned
+Channel<T>::ReceiveMany(T *items, unsigned max)
+{
+    ASSERT(items != NULL);
+    ASSERT(max > 0);
+
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+
+    while (count == 0) {
+        receivers.Append(currentThread);
+        currentThread->Sleep();
+    }
+    unsigned n = 0;
+    while (n < max && count > 0)
+        items[n++] = Take();
+
+    interrupt->SetLevel(oldLevel);
+    return n;
+}
+
+
+#endif
@@ -0,0 +1,93 @@
+/// Routines for the simulated processors.
+///
+/// Copyright (c) 2016-2017 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "cpu.hh"
+#include "system.hh"
+
+
+Cpu::Cpu(unsigned cpuId)
+{
+    ASSERT(cpuId < MAX_CPUS);
+
+    id = cpuId;
+    current = NULL;
+    yieldOnReturn = false;
+    busyTicks = 0;
+    userTicks = 0;
+    dispatches = 0;
+    steals = 0;
+    turnUsed = 0;
+#ifdef USE_TLB
+    tlbSaved = false;
+    shootdowns = 0;
+#endif
+}
+
+/// A turn left over carries on into the next one, so that every CPU gets
+/// the same time in the long run, whatever the ticks it is charged in.
+bool
+Cpu::Charge(unsigned ticks, bool user)
+{
+    busyTicks += ticks;
+    if (user)
+        userTicks += ticks;
+    turnUsed += ticks;
+    if (turnUsed < CPU_SLICE)
+        return false;
+    turnUsed -= CPU_SLICE;
+    return true;
+}
+
+void
+Cpu::EndTurn()
+{
+    turnUsed = 0;
+}
+
+#ifdef USE_TLB
+/// The entries are in the page table already (see
+/// `AddressSpace::SaveState`), so the copy may be dropped at any time.
+void
+Cpu::SaveTlb()
+{
+    memcpy(tlb, machine->tlb, sizeof tlb);
+    tlbSaved = true;
+}
+
+void
+Cpu::RestoreTlb()
+{
+    if (!tlbSaved)
+        return;
+    memcpy(machine->tlb, tlb, sizeof tlb);
+    tlbSaved = false;
+}
+
+void
+Cpu::DropTlb(AddressSpace *space)
+{
+    if (!tlbSaved || current == NULL || current->space != space)
+        return;
+    DEBUG('t', "Shooting down the TLB of CPU %u\n", id);
+    tlbSaved = false;
+    shootdowns++;
+}
+#endif
+
+/// Busy time in tenths of a percent.
+void
+Cpu::Print(unsigned elapsed)
+{
+    unsigned long busy = elapsed > 0 ? 1000 * busyTicks / elapsed : 0;
+    printf("  CPU %u: busy %9lu ticks (%3lu.%lu%%), %6u dispatches, "
+           "%6u steals", id, busyTicks, busy / 10, busy % 10, dispatches,
+           steals);
+#ifdef USE_TLB
+    printf(", %6u TLB shootdowns", shootdowns);
+#endif
+    printf("\n");
+}
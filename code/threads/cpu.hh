@@ -0,0 +1,104 @@
+/// Simulated processors, for a multiprocessor Nachos (`-smp`).
+///
+/// All the CPUs share the host thread, and take turns on it in lockstep:
+/// in every round, each CPU runs its thread for `CPU_SLICE` ticks, one CPU
+/// after the other, and only when the last one is done does the clock move
+/// on by `CPU_SLICE` and interrupts fire.  Simulated time thus goes by as if
+/// the CPUs had run side by side.  A CPU with nothing to run sits its turn
+/// out; if none has anything, the clock jumps to the next interrupt, as on
+/// a uniprocessor.  Since only one CPU runs at a time, and turns change
+/// only where a thread could be preempted anyway, disabling interrupts is
+/// still enough for mutual exclusion in the kernel.
+///
+/// A CPU between turns keeps its thread, which stays `RUNNING`, with the
+/// user registers saved in it as on any switch; and under `USE_TLB`, its
+/// TLB.  An address space changing a page drops the TLBs other CPUs keep
+/// for it (see `AddressSpace::ShootDown`).
+///
+/// Every CPU has its own ready queues, in the `Scheduler`; see there for
+/// work stealing.
+///
+/// Copyright (c) 2016-2017 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_THREADS_CPU__HH
+#define NACHOS_THREADS_CPU__HH
+
+
+#include "machine/statistics.hh"
+#ifdef USE_TLB
+#include "machine/machine.hh"
+#endif
+
+
+class Thread;
+class AddressSpace;
+
+/// Most CPUs a machine may have.
+const unsigned MAX_CPUS = 8;
+
+/// Ticks every CPU runs for in a round.
+const unsigned CPU_SLICE = SYSTEM_TICK;
+
+class Cpu {
+public:
+
+    /// Initialize CPU number `cpuId`, idle.
+    Cpu(unsigned cpuId);
+
+    unsigned GetId()
+    {
+        return id;
+    }
+
+    /// Charge `ticks` ticks of work to the running thread, in user mode if
+    /// `user`.  Return true if the turn of this CPU is over.
+    bool Charge(unsigned ticks, bool user);
+
+    /// Give up the rest of the turn, for lack of work.
+    void EndTurn();
+
+#ifdef USE_TLB
+    /// Keep the TLB until this CPU gets its turn again.
+    void SaveTlb();
+
+    /// Load the TLB kept by `SaveTlb`, if still there.
+    void RestoreTlb();
+
+    /// Drop the TLB kept, if the thread of this CPU runs in `space`.
+    void DropTlb(AddressSpace *space);
+#endif
+
+    /// Print what this CPU did, out of `elapsed` ticks.
+    void Print(unsigned elapsed);
+
+    /// Thread running on this CPU, or `NULL` if idle.
+    Thread *current;
+
+    /// Whether the timer asked `current` to yield, at the end of the
+    /// round.
+    bool yieldOnReturn;
+
+    /// Ticks spent running threads, and in user mode out of those; threads
+    /// dispatched, and threads taken from other CPUs.
+    unsigned long busyTicks;
+    unsigned long userTicks;
+    unsigned dispatches;
+    unsigned steals;
+
+private:
+    unsigned id;
+
+    /// Ticks used of the current turn.
+    unsigned turnUsed;
+
+#ifdef USE_TLB
+    TranslationEntry tlb[TLB_SIZE];
+    bool tlbSaved;
+    unsigned shootdowns;
+#endif
+};
+
+
+#endif
@@ -0,0 +1,186 @@
+/// Intrusive doubly linked lists.
+///
+/// Unlike `List`, which allocates a `ListElement` to hold each item, an
+/// `IntrusiveList` links the items themselves, through a `ListHook` member
+/// each item embeds.  Insertion and removal never allocate, and an item
+/// can be unlinked from the middle of its list in constant time.
+///
+/// The price is that an item can be on as many lists at once as it has
+/// hooks.  For instance, a `Thread` is on at most one ready queue or one
+/// semaphore queue, so one hook serves both:
+///
+///     class Thread { ... ListHook<Thread> queueHook; };
+///     IntrusiveList<Thread, &Thread::queueHook> waiting;
+///
+/// Copyright (c) 2016-2017 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_THREADS_INTRUSIVELIST__HH
+#define NACHOS_THREADS_INTRUSIVELIST__HH
+
+
+#include "utility.hh"
+
+
+/// Links embedded in an item.  `list` is the list the item is on, `NULL` if
+/// it is not on any; it lets the list check that items are not inserted
+/// twice nor removed from the wrong list.
+template <class T>
+class ListHook {
+public:
+
+    ListHook()
+    {
+        next = prev = NULL;
+        list = NULL;
+    }
+
+    /// Is the item on some list?
+    bool IsLinked() const
+    {
+        return list != NULL;
+    }
+
+    T *next;
+    T *prev;
+    const void *list;
+};
+
+template <class T, ListHook<T> T::*hook>
+class IntrusiveList {
+public:
+
+    /// Initialize the list, empty.
+    IntrusiveList()
+    {
+        first = last = NULL;
+    }
+
+    /// The list does not own its items, so it must be empty when it is
+    /// destroyed.
+    ~IntrusiveList()
+    {
+        ASSERT(IsEmpty());
+    }
+
+    /// Put `item` at the end of the list.
+    void Append(T *item);
+
+    /// Put `item` at the beginning of the list.
+    void Prepend(T *item);
+
+    /// Take the item off the front of the list; `NULL` if it is empty.
+    T *Remove();
+
+    /// Take `item` off the list, wherever it is.
+    void Unlink(T *item);
+
+    /// Does the list contain `item`?
+    bool Contains(const T *item) const
+    {
+        return (item->*hook).list == this;
+    }
+
+    bool IsEmpty() const
+    {
+        return first == NULL;
+    }
+
+    /// Iteration: `for (T *t = l.First(); t != NULL; t = l.Next(t))`.
+    T *First() const
+    {
+        return first;
+    }
+
+    T *Next(const T *item) const
+    {
+        return (item->*hook).next;
+    }
+
+    /// Apply `func` to all items in the list.
+    void Apply(void (*func)(T *));
+
+private:
+
+    T *first;  ///< Head of the list, `NULL` if list is empty.
+    T *last;   ///< Last item of the list.
+
+    // Lists are not copyable: the hooks point back to this one.
+    IntrusiveList(const IntrusiveList &);
+    IntrusiveList &operator=(const IntrusiveList &);
+};
+
+template <class T, ListHook<T> T::*hook>
+void
+IntrusiveList<T, hook>::Append(T *item)
+{
+    ListHook<T> &h = item->*hook;
+    ASSERT(!h.IsLinked());
+
+    h.list = this;
+    h.next = NULL;
+    h.prev = last;
+    if (last != NULL)
+        (last->*hook).next = item;
+    else
+        first = item;
+    last = item;
+}
+
+template <class T, ListHook<T> T::*hook>
+void
+IntrusiveList<T, hook>::Prepend(T *item)
+{
+    ListHook<T> &h = item->*hook;
+    ASSERT(!h.IsLinked());
+
+    h.list = this;
+    h.prev = NULL;
+    h.next = first;
+    if (first != NULL)
+        (first->*hook).prev = item;
+    else
+        last = item;
+    first = item;
+}
+
+template <class T, ListHook<T> T::*hook>
+T *
+IntrusiveList<T, hook>::Remove()
+{
+    T *item = first;
+    if (item != NULL)
+        Unlink(item);
+    return item;
+}
+
+template <class T, ListHook<T> T::*hook>
+void
+IntrusiveList<T, hook>::Unlink(T *item)
+{
+    ListHook<T> &h = item->*hook;
+    ASSERT(h.list == this);
+
+    if (h.prev != NULL)
+        (h.prev->*hook).next = h.next;
+    else
+        first = h.next;
+    if (h.next != NULL)
+        (h.next->*hook).prev = h.prev;
+    else
+        last = h.prev;
+    h.next = h.prev = NULL;
+    h.list = NULL;
+}
+
+template <class T, ListHook<T> T::*hook>
+void
+IntrusiveList<T, hook>::Apply(void (*func)(T *))
+{
+    for (T *item = first; item != NULL; item = (item->*hook).next)
+        func(item);
+}
+
+
+#endif
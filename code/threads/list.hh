@@ -12,6 +12,7 @@
 #define NACHOS_THREADS_LIST__HH
 
 
+#include "pool.hh"
 #include "utility.hh"
 
 
@@ -20,6 +21,9 @@
 ///
 /// Internal data structures kept public so that `List` operations can access
 /// them directly.
+///
+/// Elements come from a `Pool`, so lists do not go to the heap once they
+/// have been used for a while.
 template <class Item>
 class ListElement {
 public:
@@ -27,6 +31,16 @@ public:
     // Initialize a list element.
     ListElement(Item itemPtr, int sortKey);
 
+    void *operator new(size_t size)
+    {
+        return Pool<ListElement>::Get(size);
+    }
+
+    void operator delete(void *p)
+    {
+        Pool<ListElement>::Put(p);
+    }
+
     ListElement *next;  ///< Next element on list, NULL if this is the last.
     int key;            ///< Priority, for a sorted list.
     Item item;          ///< Item on the list.
@@ -56,6 +70,10 @@ public:
     /// Take item off the front of the list.
     Item Remove();
 
+    /// Take `item` off the list, wherever it is.  Return false if it was not
+    /// on the list.
+    bool RemoveItem(Item item);
+
     /// Apply `func` to all elements in list.
     void Apply(void (*func)(Item));
 
@@ -170,6 +188,27 @@ List<Item>::Remove()
     return SortedRemove(NULL);
 }
 
+/// Walk the list until `item`, and unlink its element.
+template <class Item>
+bool
+List<Item>::RemoveItem(Item item)
+{
+    ListNode *prev = NULL;
+
+    for (ListNode *ptr = first; ptr != NULL; prev = ptr, ptr = ptr->next)
+        if (ptr->item == item) {
+            if (prev == NULL)
+                first = ptr->next;
+            else
+                prev->next = ptr->next;
+            if (last == ptr)
+                last = prev;
+            delete ptr;
+            return true;
+        }
+    return false;
+}
+
 /// Apply a function to each item on the list, by walking through the list,
 /// one element at a time.
 ///
@@ -10,13 +10,16 @@
 /// Usage
 /// =====
 ///
-///     nachos -d <debugflags> -rs <random seed #>
-///            -s -x <nachos file> -c <consoleIn> <consoleOut>
+///     nachos -d <debugflags> -rs <random seed #> -mlfq -fair -dt
+///            -smp <cpus> -acct [csv] -trace <file>
+///            -p <microseconds> -pt <instructions>
+///            -s -syscalls -x <nachos file> -c <consoleIn> <consoleOut>
+///            -lb <nachos file> <iterations> -bb <bits> <iterations>
 ///            -f -cp <unix file> <nachos file>
-///            -p <nachos file> -r <nachos file> -l -D -t
+///            -p <nachos file> -r <nachos file> -l -D -t -tr
 ///            -n <network reliability> -m <machine id>
 ///            -o <other machine id>
-///            -z
+///            -z -tt <thread test>
 ///
 /// General options
 /// ---------------
@@ -24,14 +27,45 @@
 /// * `-d` -- causes certain debugging messages to be printed (cf.
 ///   `utility.hh`).
 /// * `-rs` -- causes `Yield` to occur at random (but repeatable) spots.
+/// * `-mlfq` -- schedules with a multi-level feedback queue instead of
+///   static priorities.
+/// * `-fair` -- shares the CPU among threads in proportion to their
+///   weights, and reports every thread's share at halt.
+/// * `-dt` -- programs timer interrupts only when needed (dynamic ticks),
+///   instead of every `TIMER_TICKS`.
+/// * `-smp` -- simulates the given number of CPUs (up to `MAX_CPUS`), each
+///   with its own ready queues, taking turns on the host.  Only with static
+///   priorities.
+/// * `-acct` -- reports the CPU time, faults and I/O of every thread and
+///   process, when a process exits and at halt; as comma separated values
+///   if followed by `csv`.
+/// * `-trace` -- records context switches, interrupts, disk requests, page
+///   faults, swapping and system calls into the given file, for
+///   `bin/trace2json` to show as a timeline.
+/// * `-p` -- preempts kernel threads at random points, every given number
+///   of microseconds of host CPU time on average (1000 by default).
+/// * `-pt` -- preempts kernel threads every given number of host
+///   instructions (50000 by default), by tracing Nachos.  Much slower.
 /// * `-z` -- prints version and copyright information, and exits.
 ///
+/// *THREADS* options
+/// -----------------
+///
+/// * `-tt` -- selects the thread test to run: `inversion` (the default),
+///   `lock`, `nested`, `sched`, `pool`, `cond`, `channel`, `alarm`,
+///   `tickless`, `latency`, `fair`, `preempt`, `create`, `overflow`,
+///   `join` or `smp`.
+///
 /// *USER_PROGRAM* options
 /// ----------------------
 ///
 /// * `-s` -- causes user programs to be executed in single-step mode.
+/// * `-syscalls` -- reports at halt the calls, latency and bytes moved of
+///   every system call, in total and by process.
 /// * `-x` -- runs a user program.
 /// * `-c` -- tests the console.
+/// * `-lb` -- times loading every page of a program, repeatedly.
+/// * `-bb` -- times bitmap allocation on a bitmap of the given size.
 ///
 /// *FILESYS* options
 /// -----------------
@@ -43,6 +77,7 @@
 /// * `-l` -- lists the contents of the Nachos directory.
 /// * `-D` -- prints the contents of the entire file system.
 /// * `-t` -- tests the performance of the Nachos file system.
+/// * `-tr` -- tests concurrent readers of a file, with a few writers.
 ///
 /// *NETWORK* options
 /// -----------------
@@ -70,12 +105,15 @@
 
 // External functions used by this file.
 
-void ThreadTest();
+void ThreadTest(const char *which);
 void Copy(const char *unixFile, const char *nachosFile);
 void Print(const char *file);
 void PerformanceTest(void);
+void ReadMostlyTest(void);
 void StartProcess(const char *file);
 void ConsoleTest(const char *in, const char *out);
+void LoaderBenchmark(const char *file, int iterations);
+void BitMapBenchmark(unsigned numBits, int iterations);
 void MailTest(int networkID);
 
 static inline void
@@ -101,6 +139,9 @@ int
 main(int argc, char **argv)
 {
     int argCount;  // The number of arguments for a particular command.
+#ifdef THREADS
+    const char *threadTest = NULL;
+#endif
 
     DEBUG('t', "Entering main");
     Initialize(argc, argv);
@@ -111,6 +152,13 @@ main(int argc, char **argv)
             PrintVersion();
             return 0;
         }
+#ifdef THREADS
+        if (!strcmp(*argv, "-tt")) {        // Select the thread test.
+            ASSERT(argc > 1);
+            threadTest = *(argv + 1);
+            argCount = 2;
+        }
+#endif
 #ifdef USER_PROGRAM
         if (!strcmp(*argv, "-x")) {         // Run a user program.
             ASSERT(argc > 1);
@@ -127,6 +175,16 @@ main(int argc, char **argv)
             interrupt->Halt();  // Once we start the console, then Nachos
                                 // will loop forever waiting for console
                                 // input.
+        } else if (!strcmp(*argv, "-lb")) { // Time the program loader.
+            ASSERT(argc > 2);
+            LoaderBenchmark(*(argv + 1), atoi(*(argv + 2)));
+            argCount = 3;
+            interrupt->Halt();
+        } else if (!strcmp(*argv, "-bb")) { // Time bitmap allocation.
+            ASSERT(argc > 2);
+            BitMapBenchmark(atoi(*(argv + 1)), atoi(*(argv + 2)));
+            argCount = 3;
+            interrupt->Halt();
         }
 #endif
 #ifdef FILESYS
@@ -148,6 +206,10 @@ main(int argc, char **argv)
             fileSystem->Print();
         else if (!strcmp(*argv, "-t"))      // Performance test.
             PerformanceTest();
+        else if (!strcmp(*argv, "-tr")) {   // Concurrent readers test.
+            ReadMostlyTest();
+            interrupt->Halt();
+        }
 #endif
 #ifdef NETWORK
         if (!strcmp(*argv, "-o")) {
@@ -161,7 +223,7 @@ main(int argc, char **argv)
     }
 
 #ifdef THREADS
-    ThreadTest();
+    ThreadTest(threadTest);
 #endif
 
     currentThread->Finish();
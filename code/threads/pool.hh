@@ -0,0 +1,113 @@
+/// A free-list allocator for small objects of a fixed type.
+///
+/// Kernel queues allocate and free a node on every insertion and removal.
+/// `Pool<T>` keeps freed blocks on a free list and refills it a slab of
+/// `POOL_SLAB` blocks at a time, so once the kernel has reached its
+/// steady state these operations never touch the heap.  Slabs are never
+/// given back.
+///
+/// A class opts in by forwarding its `operator new` and `operator delete`
+/// to the pool of its own type:
+///
+///     void *operator new(size_t size) { return Pool<Foo>::Get(size); }
+///     void operator delete(void *p) { Pool<Foo>::Put(p); }
+///
+/// Like the rest of the kernel's data structures, pools rely on running on
+/// a uniprocessor: `Get` and `Put` never yield.  They are not preempted
+/// either: the timer signal of `-p` could otherwise switch threads halfway
+/// through a change to the free list, and hand the same block out twice.
+///
+/// Copyright (c) 2016-2017 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_THREADS_POOL__HH
+#define NACHOS_THREADS_POOL__HH
+
+
+#include "utility.hh"
+#include "preemptive.hh"
+
+#include <stddef.h>
+
+
+/// Number of blocks allocated at once when a pool runs dry.
+const unsigned POOL_SLAB = 64;
+
+template <class T>
+class Pool {
+public:
+
+    /// Return a block for a `T`.  `size` must be `sizeof (T)`.
+    static void *Get(size_t size);
+
+    /// Give back a block obtained from `Get`.
+    static void Put(void *block);
+
+    /// Number of blocks ever allocated from the heap, for statistics.
+    static unsigned Allocated()
+    {
+        return allocated;
+    }
+
+private:
+
+    /// A free block.  Sized and aligned to hold a `T`.
+    union Block {
+        Block *next;
+        alignas(T) char data[sizeof (T)];
+    };
+
+    static Block *freeList;
+    static unsigned allocated;
+};
+
+template <class T>
+typename Pool<T>::Block *Pool<T>::freeList = NULL;
+
+template <class T>
+unsigned Pool<T>::allocated = 0;
+
+/// Take the first block off the free list, allocating a new slab first if
+/// the list is empty.
+///
+/// * `size` is the size requested by `operator new`.
+template <class T>
+void *
+Pool<T>::Get(size_t size)
+{
+    ASSERT(size == sizeof (T));
+
+    HoldPreemption();
+    if (freeList == NULL) {
+        Block *slab = new Block [POOL_SLAB];
+        for (unsigned i = 0; i < POOL_SLAB; i++) {
+            slab[i].next = freeList;
+            freeList = &slab[i];
+        }
+        allocated += POOL_SLAB;
+    }
+    Block *block = freeList;
+    freeList = block->next;
+    AllowPreemption();
+    return block;
+}
+
+/// Push a block back on the free list.
+///
+/// * `block` is the block to free; `NULL` is ignored, as with `delete`.
+template <class T>
+void
+Pool<T>::Put(void *block)
+{
+    if (block == NULL)
+        return;
+    Block *b = (Block *) block;
+    HoldPreemption();
+    b->next = freeList;
+    freeList = b;
+    AllowPreemption();
+}
+
+
+#endif
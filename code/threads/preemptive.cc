@@ -16,14 +16,154 @@
 #include <sys/ptrace.h>
 #include <sys/wait.h>
 #include <sys/user.h>
+#include <sys/time.h>
+#include <signal.h>
+#include <ucontext.h>
+#include <errno.h>
 
 
 static void ContextSwitch();
 static void MonitorProcess(int childPid, unsigned long timeSliceLength);
 static void LetMeBeMonitored();
+static void ArmTimer();
+static void TimerSignalHandler(int sig, siginfo_t *info, void *context);
 
 static bool inContextSwitch = false;
 
+/// Only changed by the running thread, which cannot be switched out while
+/// it is not zero, so it needs no more than `volatile` against the handler.
+volatile unsigned preemptionHolds = 0;
+
+/// Timer signal mode: average slice in microseconds (0 if the timer is not
+/// in use), and how many signals switched right away or were deferred.
+static unsigned long signalSlice = 0;
+static unsigned long preemptions = 0;
+static unsigned long deferrals = 0;
+
+/// Limits of the Nachos executable code, set by the linker.  The C library
+/// and the rest of the shared objects lie outside.
+extern "C" char __executable_start, etext;
+
+/// Stop the timer signal, if it was set up, so that it does not fire while
+/// Nachos is being torn down.
+PreemptiveScheduler::~PreemptiveScheduler()
+{
+    if (signalSlice == 0)
+        return;
+
+    struct itimerval off;
+    memset(&off, 0, sizeof off);
+    setitimer(ITIMER_VIRTUAL, &off, NULL);
+    signal(SIGVTALRM, SIG_IGN);
+    signalSlice = 0;
+
+    DEBUG('p', "Preemptive scheduler: %lu preemptions, %lu deferred\n",
+          preemptions, deferrals);
+}
+
+/// Set up the timer signal preemptive scheduler.
+///
+/// The handler must be able to run again while it is switched out, in the
+/// middle of a `Yield` -- another thread may be preempted before the
+/// first one is resumed and returns from it -- so the signal is not blocked
+/// while it is handled (`SA_NODEFER`).  Slow system calls are restarted.
+///
+/// * `microseconds` is the average slice, in host CPU time.
+void PreemptiveScheduler::SetUpTimer(unsigned long microseconds)
+{
+    ASSERT(microseconds > 0);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof action);
+    action.sa_sigaction = TimerSignalHandler;
+    action.sa_flags = SA_SIGINFO | SA_NODEFER | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGVTALRM, &action, NULL) != 0) {
+        DEBUG('p', "Preemptive scheduler: unable to install the handler\n");
+        ASSERT(false);
+    }
+
+    signalSlice = microseconds;
+    ArmTimer();
+    DEBUG('p', "Preemptive scheduler: timer signal every %lu us\n",
+          microseconds);
+}
+
+/// Arm the timer for one slice, of random length.  It counts CPU time used
+/// by Nachos only, so it never interrupts a blocking system call.
+///
+/// The lengths come from a private generator: `Random` takes a lock in the
+/// C library, which the interrupted thread may be holding.
+static void
+ArmTimer()
+{
+    static unsigned seed = 2463534242U;
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+
+    struct itimerval slice;
+    unsigned long length = signalSlice / 2 + seed % (signalSlice + 1);
+
+    memset(&slice, 0, sizeof slice);
+    slice.it_value.tv_sec = length / 1000000;
+    slice.it_value.tv_usec = length % 1000000;
+    if (slice.it_value.tv_sec == 0 && slice.it_value.tv_usec == 0)
+        slice.it_value.tv_usec = 1;
+    setitimer(ITIMER_VIRTUAL, &slice, NULL);
+}
+
+/// Whether the code interrupted by the signal, described by `context`, is
+/// Nachos' own.  Code in the C library is not: switching there could let
+/// another thread into `malloc` or `printf` while they are halfway through
+/// updating their data.
+static bool
+InNachosCode(void *context)
+{
+    ucontext_t *uc = (ucontext_t *) context;
+#ifdef HOST_i386
+    char *pc = (char *) uc->uc_mcontext.gregs[REG_EIP];
+#elif defined(HOST_x86_64)
+    char *pc = (char *) uc->uc_mcontext.gregs[REG_RIP];
+#else
+    char *pc = &__executable_start;
+    (void) uc;
+#endif
+    return pc >= &__executable_start && pc < &etext;
+}
+
+/// Handler of the timer signal: a time slice is over.
+///
+/// Yield right away if the interrupted thread is running kernel code with
+/// interrupts enabled, and has not held preemption; otherwise defer the
+/// switch to the next time interrupts are enabled, which
+/// `Interrupt::OneTick` does as soon as the current critical section, or
+/// simulated user instruction, is over.
+static void
+TimerSignalHandler(int sig, siginfo_t *info, void *context)
+{
+    int savedErrno = errno;
+
+    if (signalSlice == 0 || interrupt == NULL || currentThread == NULL) {
+        errno = savedErrno;
+        return;
+    }
+    ArmTimer();
+
+    if (inContextSwitch)
+        ;  // Already switching.
+    else if (interrupt->getLevel() == INT_OFF || preemptionHolds > 0
+               || interrupt->getStatus() != SYSTEM_MODE
+               || !InNachosCode(context)) {
+        deferrals++;
+        interrupt->YieldOnReturn();
+    } else {
+        preemptions++;
+        currentThread->Yield();
+    }
+    errno = savedErrno;
+}
+
 /// Set up the preemptive scheduler.
 ///
 /// * `timeSliceLength` means how many machine instructions will last the
@@ -149,7 +289,7 @@ static void ContextSwitch(void)
     inContextSwitch = true;
 
     // Make a context switch if interrupts are enabled.
-    if (interrupt->getLevel() == INT_ON) {
+    if (interrupt->getLevel() == INT_ON && preemptionHolds == 0) {
         inContextSwitch = false;
         currentThread->Yield();
     } else {
@@ -1,6 +1,19 @@
 /// Extension to make kernel threads be periodically preempted.
 ///
-/// It only works on Linux x86 environments.
+/// There are two ways of doing it:
+///
+/// * `SetUpTimer` arms a host timer signal (`SIGVTALRM`) that makes the
+///   running kernel thread yield, wherever it is.  Nachos runs at native
+///   speed in between.  When it is not safe to switch right away (interrupts
+///   are off, a user instruction or the idle loop is being simulated, or the
+///   thread is inside the C library) the switch is deferred with
+///   `Interrupt::YieldOnReturn`, which takes effect the next time interrupts
+///   are enabled.  The same is done inside `HoldPreemption` and
+///   `AllowPreemption`.
+/// * `SetUp` single-steps Nachos from a monitor process with `ptrace`, and
+///   injects a context switch every so many host instructions.  Slices are
+///   exact, but execution is orders of magnitude slower.  It only works on
+///   Linux x86 environments.
 ///
 /// Copyright (c) 2007      Universidad de Las Palmas de Gran Canaria.
 ///               2016-2017 Docentes de la Universidad Nacional de Rosario.
@@ -13,21 +26,50 @@
 #define NACHOS_THREADS_PREEMPTIVE__HH
 
 
+/// How many sections that must not be preempted the running thread is in.
+extern volatile unsigned preemptionHolds;
+
+/// Keep the running thread from being preempted until the matching
+/// `AllowPreemption`, even with interrupts on.  For short sections that do
+/// not yield and cannot turn interrupts off, because turning them on again
+/// would advance the simulated clock: the free lists of `Pool`, for one.
+/// Calls nest.
+inline void
+HoldPreemption()
+{
+    preemptionHolds++;
+}
+
+inline void
+AllowPreemption()
+{
+    preemptionHolds--;
+}
+
 class PreemptiveScheduler {
 public:
 
     PreemptiveScheduler()
     {}
 
-    ~PreemptiveScheduler()
-    {}
+    /// Stop the timer signal, if it was set up.
+    ~PreemptiveScheduler();
 
-    /// Set up time slicing between kernel threads.
+    /// Set up time slicing between kernel threads, with `ptrace`.
     ///
     /// * `timeSliceLength` is the time slice duration, measured in native
     ///   x86 machine instructions.
     void SetUp(unsigned long timeSliceLength);
 
+    /// Set up time slicing between kernel threads, with a timer signal.
+    ///
+    /// * `microseconds` is the average time slice duration, measured in
+    ///   host CPU time.  Every slice is drawn at random between half and one
+    ///   and a half times that, so that threads are preempted at different
+    ///   points on every run.  The host only checks CPU timers on its clock
+    ///   tick, so shorter slices last a tick.
+    void SetUpTimer(unsigned long microseconds);
+
 };
 
 
@@ -9,8 +9,9 @@
 /// needed to wait for a lock, and the lock was busy, we would end up calling
 /// `FindNextToRun`, and that would put us in an infinite loop.
 ///
-/// Very simple implementation -- no priorities, straight FIFO.  Might need
-/// to be improved in later assignments.
+/// Priority scheduling: FIFO among threads of the same priority.  Every
+/// operation on the ready queues is constant time.  Fair share: operations
+/// on the heap are logarithmic in the number of ready threads.
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2017 Docentes de la Universidad Nacional de Rosario.
@@ -21,60 +22,299 @@
 #include "scheduler.hh"
 #include "system.hh"
 
+#include <limits.h>
+
+
+/// Clamp a priority to the range of the ready queues.
+static inline int
+QueueFor(int prio)
+{
+    return prio > MAX_PRIO ? MAX_PRIO : prio < 0 ? 0 : prio;
+}
 
 /// Initialize the list of ready but not running threads to empty.
-Scheduler::Scheduler()
+///
+/// * `schedPolicy` is the scheduling policy to follow.
+Scheduler::Scheduler(SchedPolicy schedPolicy)
 {
-	int i;
-	for (i=0; i<=MAX_PRIO ; i++)
-		rdyLists[i]= new List<Thread*>;
+    for (unsigned c = 0; c < MAX_CPUS; c++) {
+        rdyMask[c] = 0;
+        numReady[c] = 0;
+    }
+    policy = schedPolicy;
+    lastBoost = 0;
+    boosts = 0;
+
+    heapCapacity = policy == FAIR_SCHED ? 64 : 0;
+    heap = heapCapacity > 0 ? new Thread *[heapCapacity] : NULL;
+    heapSize = 0;
+    minVruntime = 0;
+    lastCharge = 0;
+
+    sharesCapacity = heapCapacity;
+    shares = sharesCapacity > 0 ? new ShareRecord [sharesCapacity] : NULL;
+    numShares = 0;
+    freeShares = -1;
 }
 
 /// De-allocate the list of ready threads.
+///
+/// The queues live inside the threads, so there is only the fair share heap
+/// to free.  Threads still ready when Nachos halts are just unlinked.
 Scheduler::~Scheduler()
 {
-	int i;
-	for (i=0; i<=MAX_PRIO ; i++)
-		delete rdyLists[i];
-		
+    for (unsigned c = 0; c < MAX_CPUS; c++)
+        for (int i = 0; i <= MAX_PRIO; i++)
+            while (rdyLists[c][i].Remove() != NULL)
+                ;
+    delete [] heap;
+    delete [] shares;
+}
+
+int
+Scheduler::QueueOf(Thread *thread, int prio)
+{
+    int queue = QueueFor(prio);
+    if (policy == MLFQ_SCHED && MAX_PRIO - thread->mlfqLevel > queue)
+        queue = MAX_PRIO - thread->mlfqLevel;
+    return queue;
+}
+
+int
+Scheduler::QuantumOf(Thread *thread)
+{
+    if (policy == MLFQ_SCHED)
+        return (MLFQ_BASE_QUANTUM << thread->mlfqLevel) * TIMER_TICKS;
+    if (policy == FAIR_SCHED)
+        return FAIR_QUANTUM * TIMER_TICKS;
+    return QUANTUM * TIMER_TICKS;
+}
+
+/// Append `thread` to the queue of priority `prio` of its CPU.  Under fair
+/// share the priority is only remembered, and the thread goes on the heap.
+void
+Scheduler::Enqueue(Thread *thread, int prio)
+{
+    ASSERT(thread->readyPrio < 0);  // Not on a queue already.
+
+    thread->readyPrio = prio;
+    if (policy == FAIR_SCHED) {
+        HeapPush(thread);
+        return;
+    }
+    rdyLists[thread->cpu][prio].Append(thread);
+    rdyMask[thread->cpu] |= 1U << prio;
+    numReady[thread->cpu]++;
 }
 
+/// Unlink `thread` from the middle of its queue.
+void
+Scheduler::Dequeue(Thread *thread)
+{
+    int prio = thread->readyPrio;
+    ASSERT(prio >= 0 && prio <= MAX_PRIO);
+
+    if (policy == FAIR_SCHED) {
+        HeapRemove(thread->heapIndex);
+        thread->readyPrio = -1;
+        return;
+    }
+    rdyLists[thread->cpu][prio].Unlink(thread);
+    if (rdyLists[thread->cpu][prio].IsEmpty())
+        rdyMask[thread->cpu] &= ~(1U << prio);
+    numReady[thread->cpu]--;
+    thread->readyPrio = -1;
+}
 
 /// Mark a thread as ready, but not running.
 /// Put it on the ready list, for later scheduling onto the CPU.
 ///
+/// Under MLFQ, a thread waking up from a block moves one level up.  A
+/// thread keeps the rest of its quantum when it yields, and gets a fresh
+/// one when it wakes up or after using it up.
+///
+/// Under fair share, a new thread starts at the smallest virtual runtime
+/// of the others, and a waking one no more than a quantum behind it.
+///
 /// * `thread` is the thread to be put on the ready list.
 void
 Scheduler::ReadyToRun(Thread *thread)
 {
+    if (policy == MLFQ_SCHED) {
+        if (thread->boostEpoch != boosts) {  // Missed a boost while blocked.
+            thread->mlfqLevel = 0;
+            thread->boostEpoch = boosts;
+        } else if (thread->getStatus() == BLOCKED && thread->mlfqLevel > 0)
+            thread->mlfqLevel--;
+    }
+    if (thread->getStatus() == BLOCKED || thread->quantumLeft <= 0)
+        thread->quantumLeft = QuantumOf(thread);
+
+    int prio = QueueOf(thread, thread->GetEffectivePriority());
+
+    // Under MLFQ a thread that wakes up at a higher level than the running
+    // one preempts it at the next tick, instead of waiting for what may be
+    // a long low level quantum.
+    if (policy == MLFQ_SCHED && thread->getStatus() == BLOCKED
+          && currentThread->getStatus() == RUNNING
+          && interrupt->getStatus() != IDLE_MODE
+          && prio > QueueOf(currentThread,
+                            currentThread->GetEffectivePriority()))
+        interrupt->YieldOnReturn();
+
+    if (policy == FAIR_SCHED) {
+        unsigned long long credit = thread->getStatus() == BLOCKED
+                                    ? FAIR_QUANTUM * TIMER_TICKS : 0;
+        if (thread->vruntime + credit < minVruntime)
+            thread->vruntime = minVruntime > credit ? minVruntime - credit : 0;
+
+        // As under MLFQ, a thread that wakes up behind the running one
+        // takes the CPU at the next interrupt.
+        if (thread->getStatus() == BLOCKED
+              && currentThread->getStatus() == RUNNING
+              && interrupt->getStatus() != IDLE_MODE) {
+            Charge(currentThread);
+            if (thread->vruntime < currentThread->vruntime)
+                interrupt->YieldOnReturn();
+        }
+    }
 
-	// int prio= thread->GetPriority();
-	int prio = thread->GetEffectivePriority();
     thread->setStatus(READY);
-    if (prio >= MAX_PRIO)
-		prio = MAX_PRIO;
-	if (prio < 0)
-		prio = 0;
-	DEBUG('t', "Putting thread %s on ready list %d.\n", thread->getName(),prio);
-    rdyLists[prio]->Append(thread);
+    DEBUG('t', "Putting thread %s on ready list %d.\n", thread->getName(), prio);
+    Enqueue(thread, prio);
+
+    // Under dynamic ticks, the timer may be stopped while a thread runs
+    // alone; now there may be somebody to share the CPU with.
+    if (timer->IsDynamic())
+        timer->DueWithin(TimeToPreempt());
 }
 
 /// Return the next thread to be scheduled onto the CPU.
 ///
+/// The highest non empty queue of the current CPU is the highest bit set in
+/// its `rdyMask`.  Under
+/// fair share, it is the top of the heap; and if the running thread is
+/// yielding, it goes on running unless that one is behind it.
+///
 /// If there are no ready threads, return `NULL`.
 ///
 /// Side effect: thread is removed from the ready list.
 Thread *
 Scheduler::FindNextToRun()
 {
-	int i;
+    if (policy == FAIR_SCHED) {
+        if (heapSize == 0)
+            return NULL;
+        Thread *thread = heap[0];
+        if (currentThread->getStatus() == RUNNING) {
+            Charge(currentThread);
+            if (currentThread->vruntime <= thread->vruntime)
+                return NULL;
+        }
+        Dequeue(thread);
+        if (thread->vruntime > minVruntime)
+            minVruntime = thread->vruntime;
+        return thread;
+    }
 
-	for (i=MAX_PRIO; i>=0 ; i--)
-		if (!rdyLists[i]->IsEmpty())
-		   return rdyLists[i]->Remove();
+    unsigned mask = rdyMask[currentCpu->GetId()];
+    if (mask == 0)
+        return NULL;
 
-	return NULL;
-	
+    int prio = 8 * sizeof mask - 1 - __builtin_clz(mask);
+    Thread *thread = rdyLists[currentCpu->GetId()][prio].First();
+    Dequeue(thread);
+    return thread;
+}
+
+bool
+Scheduler::HasReady()
+{
+    if (policy == FAIR_SCHED)
+        return heapSize > 0;
+    for (unsigned c = 0; c < numCpus; c++)
+        if (rdyMask[c] != 0)
+            return true;
+    return false;
+}
+
+/// Take the thread from the CPU with the most threads ready, so that the
+/// queues even out, and move it to the current CPU.
+///
+/// If no other CPU has a thread ready, return `NULL`.
+Thread *
+Scheduler::Steal()
+{
+    unsigned victim = currentCpu->GetId();
+    for (unsigned c = 0; c < numCpus; c++)
+        if (numReady[c] > numReady[victim])
+            victim = c;
+    if (victim == currentCpu->GetId())
+        return NULL;
+
+    unsigned mask = rdyMask[victim];
+    int prio = 8 * sizeof mask - 1 - __builtin_clz(mask);
+    Thread *thread = rdyLists[victim][prio].First();
+    Dequeue(thread);
+    DEBUG('t', "CPU %u steals thread %s from CPU %u.\n",
+          currentCpu->GetId(), thread->getName(), victim);
+    currentCpu->steals++;
+    return thread;
+}
+
+/// Called with interrupts off, either because the current thread used up
+/// the turn of its CPU, in which case it stays on it and goes on at the
+/// next turn; or because it blocked, in which case its CPU looks for
+/// another thread to go on with right away: one of its own, or a stolen
+/// one.
+///
+/// A CPU with nothing to run sits its turn out.  If none has anything, wait
+/// for an interrupt, as a uniprocessor would.
+///
+/// NOTE: the next thread is found by the CPU whose turn it is, so
+/// `currentCpu` changes before `currentThread` does, in `Run`.
+void
+Scheduler::SwitchCpu()
+{
+    Cpu *cpu = currentCpu;
+    unsigned idle = 0;  // CPUs in a row with nothing to run.
+
+    if (currentThread->getStatus() == RUNNING)
+        cpu = NextCpu(cpu);
+    else {
+        cpu->current = NULL;
+        cpu->EndTurn();
+    }
+
+    for (;;) {
+        currentCpu = cpu;
+        Thread *next = cpu->current;
+        if (next == NULL && (next = FindNextToRun()) == NULL)
+            next = Steal();
+        if (next == currentThread && next->getStatus() == RUNNING)
+            return;  // Everybody else is idle.
+        if (next != NULL) {
+            Run(next);
+            return;
+        }
+
+        if (++idle >= numCpus && !HasReady()) {
+            ProgramTimer();
+            interrupt->Idle();
+            idle = 0;
+        } else
+            cpu = NextCpu(cpu);
+    }
+}
+
+Cpu *
+Scheduler::NextCpu(Cpu *cpu)
+{
+    unsigned next = cpu->GetId() + 1;
+    if (next < numCpus)
+        return cpus[next];
+    interrupt->EndRound();
+    return cpus[0];
 }
 
 /// Dispatch the CPU to `nextThread`.
@@ -98,12 +338,29 @@ Scheduler::Run(Thread *nextThread){
         // If this thread is a user program, save the user's CPU registers.
         currentThread->SaveUserState();
         currentThread->space->SaveState();
+#ifdef USE_TLB
+        // Still running: it is just the turn of another CPU.
+        if (oldThread->getStatus() == RUNNING)
+            cpus[oldThread->cpu]->SaveTlb();
+#endif
     }
 #endif
 
     oldThread->CheckOverflow();  // Check if the old thread had an undetected
                                  // stack overflow.
+    Charge(oldThread);
+    if (oldThread->getStatus() != RUNNING)  // Leaving its CPU.
+        accounting->ChargeTicks(oldThread);
 
+    if (nextThread->getStatus() != RUNNING) {  // Not another CPU's turn.
+        stats->numContextSwitches++;
+        currentCpu->current = nextThread;
+        currentCpu->yieldOnReturn = false;
+        currentCpu->dispatches++;
+        nextThread->cpu = currentCpu->GetId();
+        nextThread->quantumCharged = stats->totalTicks;
+        tracer->RecordThread(TRACE_THREAD_START, nextThread);
+    }
     currentThread = nextThread;  // Switch to the next thread.
     currentThread->setStatus(RUNNING);  // `nextThread` is now running.
 
@@ -123,10 +380,13 @@ Scheduler::Run(Thread *nextThread){
     // need to delete its carcass.  Note we cannot delete the thread before
     // now (for example, in `Thread::Finish`), because up to this point, we
     // were still running on the old thread's stack!
+    // The global is cleared first: were the destructor to let another thread
+    // run, that one must not find the carcass and delete it again.
     if (threadToBeDestroyed != NULL) {
-        DEBUG('t', "Deleting thread \"%s\"\n", threadToBeDestroyed->getName());
-        delete threadToBeDestroyed;
+        Thread *carcass = threadToBeDestroyed;
         threadToBeDestroyed = NULL;
+        DEBUG('t', "Deleting thread \"%s\"\n", carcass->getName());
+        delete carcass;
     }
 
 #ifdef USER_PROGRAM
@@ -134,51 +394,369 @@ Scheduler::Run(Thread *nextThread){
         // If there is an address space to restore, do it.
         currentThread->RestoreUserState();
         currentThread->space->RestoreState();
+#ifdef USE_TLB
+        currentCpu->RestoreTlb();
+#endif
         DEBUG('t', "Restoring registers and memory of thread \"%s\"\n", currentThread->getName());
 
     }
 #endif
 }
 
-/// Busca en cola de prioridad orig, lo elimina si está
-/// Lo agrega en la cola de prioridad targ
+/// Move `thread` to the back of the ready queue for priority `targ`, after a
+/// change of its effective priority (priority donation in `Lock`).  Threads
+/// that are not ready are left alone: they are queued with their new
+/// priority when they become ready.
+///
+/// * `thread` is the thread whose priority changed.
+/// * `targ` is its new effective priority.
+void
+Scheduler::ChangePriorityList(Thread* thread, int targ)
+{
+    if (thread->readyPrio < 0)
+        return;
 
-void //pensar bien
-Scheduler::ChangePriorityList(Thread* thread, int orig, int targ){
-	ASSERT( orig>=0 && targ >=0 && orig<=MAX_PRIO && targ <=MAX_PRIO);
-	List<Thread*> * new_orig = new List<Thread*>;
-	Thread *temp;
-	while (!rdyLists[orig]->IsEmpty()) {
-		temp = rdyLists[orig]->Remove();
-		if (temp != thread) //¿Cómo comparar threads?
-			new_orig->Append(temp);
-	}
-	DEBUG('t', "Sacamos el hilo %s de la lista %d si estaba.\n", thread->getName(),orig);
-	if (thread->getStatus()==READY){
-		rdyLists[targ]->Append(thread);
-	DEBUG('t', "Putting thread %s on ready list %d.\n", thread->getName(),targ);
-	}
-	delete rdyLists[orig];
-	rdyLists[orig] = new_orig;
+    DEBUG('t', "Moving thread %s from ready list %d to %d.\n",
+          thread->getName(), thread->readyPrio, QueueOf(thread, targ));
+    Dequeue(thread);
+    Enqueue(thread, QueueOf(thread, targ));
 }
 
+/// Called from the timer interrupt handler, with interrupts off, for every
+/// running thread.  Charge the time it ran since the last charge to its
+/// quantum; once the quantum is over, under MLFQ move the thread one level
+/// down (it will be queued there when it yields) and ask for a yield.
+bool
+Scheduler::TimerTick(Thread *thread)
+{
+    unsigned now = stats->totalTicks;
 
+    Charge(thread);
+    if (policy == MLFQ_SCHED
+          && now - lastBoost >= MLFQ_BOOST_PERIOD * TIMER_TICKS)
+        Boost();
 
-/// Print the scheduler state -- in other words, the contents of the ready
-/// list.
+    if (thread->quantumLeft <= 0)  // Used up, or never dispatched: main.
+        thread->quantumLeft = QuantumOf(thread);
+    thread->quantumLeft -= now - thread->quantumCharged;
+    thread->quantumCharged = now;
+    if (thread->quantumLeft > 0)
+        return false;
+
+    if (policy == MLFQ_SCHED && thread->mlfqLevel < MLFQ_LEVELS - 1) {
+        thread->mlfqLevel++;
+        DEBUG('t', "Thread %s used up its quantum, down to level %d.\n",
+              thread->getName(), thread->mlfqLevel);
+    }
+    return true;
+}
+
+/// A quantum already used up is renewed by the next interrupt, which is
+/// then due right away.
+unsigned
+Scheduler::TimeToPreempt()
+{
+    unsigned now = stats->totalTicks;
+    unsigned left = UINT_MAX;
+
+    for (unsigned c = 0; c < numCpus; c++) {
+        Thread *thread = cpus[c]->current;
+        if (thread == NULL || thread->getStatus() != RUNNING)
+            continue;
+        unsigned used = now - thread->quantumCharged;
+        unsigned quantum = thread->quantumLeft > 0 ? thread->quantumLeft : 0;
+        unsigned due = quantum > used ? quantum - used : 1;
+        if (due < left)
+            left = due;
+    }
+    if (policy == MLFQ_SCHED) {
+        unsigned boost = lastBoost + MLFQ_BOOST_PERIOD * TIMER_TICKS;
+        unsigned due = boost > now ? boost - now : 1;
+        if (due < left)
+            left = due;
+    }
+    return left != UINT_MAX ? left : TIMER_TICKS;
+}
+
+/// Move every ready thread, and the running one, to MLFQ level 0.  Blocked
+/// threads are moved when they wake up (see `ReadyToRun`).  There is only
+/// one CPU under MLFQ.
+void
+Scheduler::Boost()
+{
+    DEBUG('t', "Boosting every thread to level 0.\n");
+    lastBoost = stats->totalTicks;
+    boosts++;
+
+    // Lower queues first, so that they end up behind the higher ones.
+    IntrusiveList<Thread, &Thread::queueHook> *queues = rdyLists[0];
+    for (int i = MAX_PRIO - 1; i >= 0; i--) {
+        Thread *thread;
+        while ((thread = queues[i].First()) != NULL) {
+            Dequeue(thread);
+            thread->mlfqLevel = 0;
+            thread->boostEpoch = boosts;
+            Enqueue(thread, QueueOf(thread, thread->GetEffectivePriority()));
+        }
+    }
+    for (Thread *thread = queues[MAX_PRIO].First(); thread != NULL;
+         thread = queues[MAX_PRIO].Next(thread)) {
+        thread->mlfqLevel = 0;
+        thread->boostEpoch = boosts;
+    }
+    currentThread->mlfqLevel = 0;
+    currentThread->boostEpoch = boosts;
+}
+
+/// Lending under fair share: the holder goes back to the virtual runtime
+/// of the waiter if that is smaller, so that it runs, and releases the
+/// lock, when the waiter would.  The time it uses from there on is charged
+/// as usual, and what it went back is kept in `vruntimeLent`, for `Repay`;
+/// so lending more than once to the same holder only counts the lowest
+/// point reached.
 ///
-/// For debugging.
+/// * `holder` is the thread holding a lock.
+/// * `waiter` is a thread about to wait for it.
+void
+Scheduler::Lend(Thread *holder, Thread *waiter)
+{
+    if (policy != FAIR_SCHED)
+        return;
+
+    if (waiter == currentThread)
+        Charge(waiter);
+    if (waiter->vruntime >= holder->vruntime)
+        return;
+
+    DEBUG('t', "Thread %s lends its place to %s.\n",
+          waiter->getName(), holder->getName());
+    holder->vruntimeLent += holder->vruntime - waiter->vruntime;
+    holder->vruntime = waiter->vruntime;
+    if (holder->heapIndex >= 0)
+        SiftUp(holder->heapIndex);
+}
+
+/// The holder ends up where it would be had it not been lent anything: its
+/// own virtual runtime plus the time it ran meanwhile.
+void
+Scheduler::Repay(Thread *holder)
+{
+    ASSERT(holder == currentThread);
+
+    if (holder->vruntimeLent == 0)
+        return;
+
+    DEBUG('t', "Thread %s pays back %llu of virtual runtime.\n",
+          holder->getName(), holder->vruntimeLent);
+    holder->vruntime += holder->vruntimeLent;
+    holder->vruntimeLent = 0;
+}
+
+/// Charge the CPU time used since the last call to `thread`, which must be
+/// the running one.  The clock is system plus user time, so that idle time
+/// is not charged to anybody.
+void
+Scheduler::Charge(Thread *thread)
+{
+    if (policy != FAIR_SCHED)
+        return;
+
+    unsigned now = stats->systemTicks + stats->userTicks;
+    unsigned used = now - lastCharge;
+    lastCharge = now;
+
+    thread->vruntime += (unsigned long long) used * FAIR_DEFAULT_WEIGHT
+                        / thread->weight;
+    if (thread->shareRecord >= 0) {
+        shares[thread->shareRecord].ticks += used;
+        shares[thread->shareRecord].weight = thread->weight;
+    }
+}
+
+/// Add `thread` at the bottom of the heap and let it rise to its place.
+void
+Scheduler::HeapPush(Thread *thread)
+{
+    ASSERT(thread->heapIndex < 0);
+
+    if (heapSize == heapCapacity) {
+        Thread **bigger = new Thread *[2 * heapCapacity];
+        memcpy(bigger, heap, heapSize * sizeof *heap);
+        delete [] heap;
+        heap = bigger;
+        heapCapacity *= 2;
+    }
+    HeapPlace(thread, heapSize++);
+    SiftUp(thread->heapIndex);
+}
+
+/// Take the thread in position `i` out of the heap, filling the hole with
+/// the last one.
+void
+Scheduler::HeapRemove(unsigned i)
+{
+    ASSERT(i < heapSize);
+
+    heap[i]->heapIndex = -1;
+    heapSize--;
+    if (i == heapSize)
+        return;
+    HeapPlace(heap[heapSize], i);
+    SiftUp(i);
+    SiftDown(heap[i]->heapIndex);
+}
+
+void
+Scheduler::SiftUp(unsigned i)
+{
+    Thread *thread = heap[i];
+    while (i > 0 && thread->vruntime < heap[(i - 1) / 2]->vruntime) {
+        HeapPlace(heap[(i - 1) / 2], i);
+        i = (i - 1) / 2;
+    }
+    HeapPlace(thread, i);
+}
+
+void
+Scheduler::SiftDown(unsigned i)
+{
+    Thread *thread = heap[i];
+    for (;;) {
+        unsigned child = 2 * i + 1;
+        if (child >= heapSize)
+            break;
+        if (child + 1 < heapSize
+              && heap[child + 1]->vruntime < heap[child]->vruntime)
+            child++;
+        if (heap[child]->vruntime >= thread->vruntime)
+            break;
+        HeapPlace(heap[child], i);
+        i = child;
+    }
+    HeapPlace(thread, i);
+}
+
+void
+Scheduler::HeapPlace(Thread *thread, unsigned i)
+{
+    heap[i] = thread;
+    thread->heapIndex = i;
+}
+
+/// Start a CPU time record for `thread`, in a free one if there is any.
+/// Records outlive their threads, so that finished ones show up in the
+/// report.
+int
+Scheduler::AddShareRecord(Thread *thread)
+{
+    if (policy != FAIR_SCHED)
+        return -1;
+
+    int r = freeShares;
+    if (r >= 0)
+        freeShares = shares[r].nextFree;
+    else {
+        if (numShares == sharesCapacity) {
+            ShareRecord *bigger = new ShareRecord [2 * sharesCapacity];
+            memcpy(bigger, shares, numShares * sizeof *shares);
+            delete [] shares;
+            shares = bigger;
+            sharesCapacity *= 2;
+        }
+        r = numShares++;
+    }
+    ShareRecord *record = &shares[r];
+    strncpy(record->name, thread->getName(), sizeof record->name - 1);
+    record->name[sizeof record->name - 1] = '\0';
+    record->weight = thread->GetWeight();
+    record->ticks = 0;
+    record->threads = 1;
+    record->live = true;
+    return r;
+}
+
+void
+Scheduler::ReleaseShareRecord(int r)
+{
+    ASSERT(r >= 0 && (unsigned) r < numShares);
+    ShareRecord *record = &shares[r];
+    ASSERT(record->threads > 0 && record->live);
+
+    record->live = false;
+    for (unsigned i = 0; i < numShares; i++) {
+        ShareRecord *gone = &shares[i];
+        if ((int) i == r || gone->threads == 0 || gone->live
+              || gone->weight != record->weight
+              || strcmp(gone->name, record->name) != 0)
+            continue;
+        gone->ticks += record->ticks;
+        gone->threads += record->threads;
+        record->threads = 0;
+        record->nextFree = freeShares;
+        freeShares = r;
+        return;
+    }
+}
+
+/// Print, for every thread, or kind of thread gone, that got the CPU, its
+/// weight, the CPU time it used and its share of the total.
+void
+Scheduler::PrintShares()
+{
+    if (policy != FAIR_SCHED)
+        return;
+
+    Charge(currentThread);
+    unsigned long total = 0;
+    for (unsigned i = 0; i < numShares; i++)
+        total += shares[i].ticks;
+    if (total == 0)
+        return;
+
+    // Shares in tenths of a percent.
+    printf("CPU shares:\n");
+    for (unsigned i = 0; i < numShares; i++)
+        if (shares[i].threads > 0 && shares[i].ticks > 0) {
+            unsigned long share = 1000 * shares[i].ticks / total;
+            printf("  %3u %-24s weight %7u, ticks %9lu, share %3lu.%lu%%",
+                   i, shares[i].name, shares[i].weight, shares[i].ticks,
+                   share / 10, share % 10);
+            if (shares[i].threads > 1)
+                printf(", %u threads", shares[i].threads);
+            printf("\n");
+        }
+}
+
+/// Every CPU was there for the whole run, so its idle time is what it did
+/// not spend running threads.
+void
+Scheduler::PrintCpus()
+{
+    if (numCpus == 1)
+        return;
+
+    printf("CPUs:\n");
+    for (unsigned c = 0; c < numCpus; c++)
+        cpus[c]->Print(stats->totalTicks);
+}
+
 static void
-ThreadPrint(Thread* t)
+ThreadPrint(Thread *t)
 {
     t->Print();
 }
 
+/// Print the scheduler state -- in other words, the contents of the ready
+/// list.
+///
+/// For debugging.
 void
 Scheduler::Print()
 {
     printf("Ready list contents:\n");
-    int i;
-    for (i=MAX_PRIO;i>=0; i--)
-		rdyLists[i]->Apply(ThreadPrint);
+    for (unsigned i = 0; i < heapSize; i++)
+        ThreadPrint(heap[i]);
+    for (unsigned c = 0; c < numCpus; c++)
+        for (int i = MAX_PRIO; i >= 0; i--)
+            rdyLists[c][i].Apply(ThreadPrint);
 }
@@ -2,6 +2,48 @@
 ///
 /// Primarily, the list of threads that are ready to run.
 ///
+/// There is one FIFO queue per priority.  The queues are `IntrusiveList`s
+/// linked through `Thread::queueHook`, so queueing never allocates, and a
+/// bitmap records which queues are not empty, so the highest priority ready
+/// thread is found without scanning.
+///
+/// Two policies share those queues:
+///
+/// * static priorities (the default): a thread goes on the queue of its
+///   effective priority, and threads of equal priority are time sliced
+///   every `QUANTUM` timer interrupts;
+/// * a multi-level feedback queue (`-mlfq`): queue `MAX_PRIO - L` holds
+///   threads at level `L`.  A thread that uses up its quantum moves one
+///   level down, where quanta are twice as long; one that blocks (on the
+///   console, the disk, `Join`...) moves one level up.  Every
+///   `MLFQ_BOOST_PERIOD` timer interrupts everyone goes back to level 0, so
+///   CPU bound threads cannot be starved.  A thread that wakes up above
+///   the running one preempts it.  Static and donated priorities still act
+///   as a floor.
+///
+/// A third policy, fair share (`-fair`), does not use the queues.  Ready
+/// threads are kept in a binary min-heap ordered by virtual runtime: the
+/// CPU time a thread has used, scaled down by its weight (see
+/// `Thread::SetWeight`).  The thread that has had the least CPU for its
+/// weight runs next, so in the long run every thread gets a share of the
+/// CPU proportional to its weight.  Threads that wake up or are created
+/// start no further behind than the rest, so sleeping does not build up
+/// credit.  Priority donation in `Lock` becomes lending virtual runtime: a
+/// lock holder moves up to the place of the waiter it blocks.  The CPU time
+/// of every thread is recorded, and reported at halt.
+///
+/// Quanta are accounted per thread, by `TimerTick`, in ticks: a thread is
+/// charged the time since it was dispatched or last charged, so timer
+/// interrupts that come early (at an alarm deadline under `-dt`, or at
+/// random under `-rs`) do not make its quantum shorter.  Boosts go by the
+/// clock too.
+///
+/// Under SMP (`-smp`, static priorities only), every CPU has queues of its
+/// own, and a thread goes on those of the CPU it last ran on, or of the CPU
+/// that created it; so every CPU only looks at its own queues.  A CPU with
+/// nothing left to run steals the first thread of the highest priority from
+/// the CPU with the most threads ready, before giving up its turn.
+///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2017 Docentes de la Universidad Nacional de Rosario.
 /// All rights reserved.  See `copyright.h` for copyright notice and
@@ -12,8 +54,50 @@
 
 #define MAX_PRIO 7  /* chequear */
 
-#include "list.hh"
 #include "thread.hh"
+#include "cpu.hh"
+
+
+/// Scheduling policies.
+enum SchedPolicy {
+    PRIORITY_SCHED,
+    MLFQ_SCHED,
+    FAIR_SCHED
+};
+
+/// Time slice of the static priority policy, in timer periods
+/// (`TIMER_TICKS`).
+const int QUANTUM = 20;
+
+/// Number of MLFQ levels: one per ready queue.
+const int MLFQ_LEVELS = MAX_PRIO + 1;
+
+/// Quantum of MLFQ level 0, in timer periods; it doubles at every level.
+const int MLFQ_BASE_QUANTUM = 2;
+
+/// Timer periods between two MLFQ priority boosts.
+const unsigned MLFQ_BOOST_PERIOD = 200;
+
+/// Time slice of the fair share policy, in timer periods.
+const int FAIR_QUANTUM = 4;
+
+/// Weight of a thread that did not ask for another one, and the largest
+/// weight a thread may ask for.  A thread of weight `2 * w` gets twice as
+/// much CPU as one of weight `w`.
+const unsigned FAIR_DEFAULT_WEIGHT = 1024;
+const unsigned FAIR_MAX_WEIGHT = 1024 * 1024;
+
+/// CPU time used by a thread, kept after the thread is gone for the report
+/// at halt.  Records of threads that are gone are merged by name and weight,
+/// so there are only as many of them as different kinds of threads.
+struct ShareRecord {
+    char name[24];
+    unsigned weight;
+    unsigned long ticks;
+    unsigned threads;  ///< Threads merged into it; 0 if the record is free.
+    bool live;         ///< Whether its thread is still there.
+    int nextFree;      ///< Next free record, if free.
+};
 
 
 /// The following class defines the scheduler/dispatcher abstraction --
@@ -23,7 +107,7 @@ class Scheduler {
 public:
 
     /// Initialize list of ready threads.
-    Scheduler();
+    Scheduler(SchedPolicy schedPolicy = PRIORITY_SCHED);
 
     /// De-allocate ready list.
     ~Scheduler(); 
@@ -34,18 +118,124 @@ public:
     /// Dequeue first thread on the ready list, if any, and return thread.
     Thread* FindNextToRun();
 
+    /// Is any thread ready, besides the running ones?
+    bool HasReady();
+
+    /// Under SMP, dequeue a thread of another CPU for the current one, if
+    /// any.
+    Thread *Steal();
+
+    /// Under SMP, let the CPUs after the current one take their turns,
+    /// until one gets back to the current thread.
+    void SwitchCpu();
+
     /// Cause `nextThread` to start running.
     void Run(Thread* nextThread);
 
     // Print contents of ready list.
     void Print();
 
-	void ChangePriorityList(Thread* thread, int orig, int targ);
+    /// Move `thread`, if it is ready, to the queue of priority `targ`.
+    void ChangePriorityList(Thread* thread, int targ);
+
+    /// Charge the time since the last charge to the quantum of `thread`,
+    /// which is running.  Return true if the quantum is over and it should
+    /// yield.
+    bool TimerTick(Thread *thread);
+
+    /// Ticks from now until the scheduler needs a timer interrupt: the end
+    /// of the first quantum of a running thread to end, or the next MLFQ
+    /// boost.
+    unsigned TimeToPreempt();
+
+    SchedPolicy GetPolicy()
+    {
+        return policy;
+    }
+
+    /// Under fair share, let the lock holder `holder` run in place of
+    /// `waiter`, if that is earlier.
+    void Lend(Thread *holder, Thread *waiter);
+
+    /// Give back to `holder`, the running thread, the virtual runtime it
+    /// was lent, once nobody waits on a lock it holds.
+    void Repay(Thread *holder);
+
+    /// Record the CPU time of a new thread from now on.  Return the record
+    /// number, or -1 if the policy does not keep records.
+    int AddShareRecord(Thread *thread);
+
+    /// The thread of record `record` is gone: merge the record into that of
+    /// a thread of the same name and weight gone before, if any, and free
+    /// it.
+    void ReleaseShareRecord(int record);
+
+    /// Charge the CPU time used since the last charge to the running
+    /// `thread`.
+    void Charge(Thread *thread);
+
+    /// Print the CPU time and share of every thread, under fair share.
+    void PrintShares();
+
+    /// Print what every CPU did, under SMP.
+    void PrintCpus();
 
 private:
 
-    // Queue of threads that are ready to run, but not running.
-    List<Thread*> *rdyLists[MAX_PRIO+1]; 
+    /// Queue for `thread` if its effective priority is `prio`.
+    int QueueOf(Thread *thread, int prio);
+
+    /// Length of `thread`'s quantum at its current level.
+    int QuantumOf(Thread *thread);
+
+    /// Move every thread back to MLFQ level 0.
+    void Boost();
+
+    /// The CPU after `cpu`, ending the round if `cpu` is the last one.
+    Cpu *NextCpu(Cpu *cpu);
+
+    /// Append `thread` to the queue of priority `prio`.
+    void Enqueue(Thread *thread, int prio);
+
+    /// Unlink `thread` from the queue it is on.
+    void Dequeue(Thread *thread);
+
+    /// Fair share heap operations.
+    void HeapPush(Thread *thread);
+    void HeapRemove(unsigned i);
+    void SiftUp(unsigned i);
+    void SiftDown(unsigned i);
+    void HeapPlace(Thread *thread, unsigned i);
+
+    /// Queues of threads that are ready to run, but not running, for
+    /// every CPU.
+    IntrusiveList<Thread, &Thread::queueHook> rdyLists[MAX_CPUS][MAX_PRIO+1];
+
+    /// Bit `p` of `rdyMask[c]` is set iff queue `p` of CPU `c` is not
+    /// empty; `numReady[c]` is the number of threads in them.
+    unsigned rdyMask[MAX_CPUS];
+    unsigned numReady[MAX_CPUS];
+
+    SchedPolicy policy;
+
+    /// Time of the last boost, and number of boosts so far.  Blocked
+    /// threads catch up with a boost when they wake up, by comparing their
+    /// `boostEpoch` with `boosts`.
+    unsigned lastBoost;
+    unsigned boosts;
+
+    /// Fair share: ready threads, a min-heap on `Thread::vruntime`; the
+    /// virtual runtime new and waking threads catch up with; and the CPU
+    /// clock at the last `Charge`.
+    Thread **heap;
+    unsigned heapSize, heapCapacity;
+    unsigned long long minVruntime;
+    unsigned lastCharge;
+
+    /// Records in use or free, and the first free one, or -1.
+    ShareRecord *shares;
+    unsigned numShares, sharesCapacity;
+    int freeShares;
 
 };
 
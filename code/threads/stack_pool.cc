@@ -0,0 +1,159 @@
+/// Routines to manage the pool of thread stacks.
+///
+/// Copyright (c) 2016-2017 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "stack_pool.hh"
+#include "system.hh"
+
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+
+/// Stack for the fault handler: the faulting one has no room left.
+static char faultStack[64 * 1024];
+
+/// Handler for segmentation faults.  If the fault hit the guard page of the
+/// running thread's stack, say so and abort; otherwise fall back to the
+/// default action, which kills Nachos when the faulting instruction is
+/// retried.
+static void
+GuardFaultHandler(int sig, siginfo_t *info, void *context)
+{
+    if (currentThread != NULL && currentThread->InStackGuard(info->si_addr)) {
+        fprintf(stderr, "Stack overflow in thread \"%s\"\n",
+                currentThread->getName());
+        Abort();
+    }
+    signal(SIGSEGV, SIG_DFL);
+}
+
+StackPool::StackPool()
+{
+    numBuckets = 0;
+    maxFree = STACK_POOL_MAX_FREE;
+    mapped = 0;
+    reused = 0;
+
+    stack_t altStack;
+    altStack.ss_sp = faultStack;
+    altStack.ss_size = sizeof faultStack;
+    altStack.ss_flags = 0;
+    sigaltstack(&altStack, NULL);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof action);
+    action.sa_sigaction = GuardFaultHandler;
+    action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGSEGV, &action, NULL);
+}
+
+StackPool::~StackPool()
+{
+    SetMaxFree(0);
+}
+
+size_t
+StackPool::BytesFor(unsigned words)
+{
+    size_t page = getpagesize();
+    return (words * sizeof (HostMemoryAddress) + page - 1) / page * page;
+}
+
+StackPool::Bucket *
+StackPool::BucketFor(size_t bytes)
+{
+    for (unsigned i = 0; i < numBuckets; i++)
+        if (buckets[i].bytes == bytes)
+            return &buckets[i];
+    if (numBuckets == STACK_POOL_SIZES)
+        return NULL;
+
+    Bucket *bucket = &buckets[numBuckets++];
+    bucket->bytes = bytes;
+    bucket->first = NULL;
+    bucket->count = 0;
+    return bucket;
+}
+
+/// Take a free stack of the right size if there is one; otherwise map a new
+/// one together with its guard page.  The buckets and their free lists,
+/// like those of `Pool`, are changed with preemption held.
+HostMemoryAddress *
+StackPool::Get(unsigned words)
+{
+    ASSERT(words > 0);
+
+    size_t bytes = BytesFor(words);
+    HoldPreemption();  // Finding the bucket may add it.
+    Bucket *bucket = BucketFor(bytes);
+    if (bucket != NULL && bucket->first != NULL) {
+        FreeStack *stack = bucket->first;
+        bucket->first = stack->next;
+        bucket->count--;
+        reused++;
+        AllowPreemption();
+        return (HostMemoryAddress *) stack;
+    }
+    AllowPreemption();
+
+    size_t page = getpagesize();
+    char *region = (char *) mmap(NULL, page + bytes, PROT_READ | PROT_WRITE,
+                                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT(region != MAP_FAILED);
+    ASSERT(mprotect(region, page, PROT_NONE) == 0);
+    mapped++;
+    return (HostMemoryAddress *) (region + page);
+}
+
+/// Keep `stack` for a later `Get` if there is room for it; otherwise unmap
+/// it.
+void
+StackPool::Put(HostMemoryAddress *stack, unsigned words)
+{
+    ASSERT(stack != NULL);
+
+    size_t bytes = BytesFor(words);
+    HoldPreemption();
+    Bucket *bucket = BucketFor(bytes);
+    if (bucket != NULL && bucket->count < maxFree) {
+        FreeStack *free = (FreeStack *) stack;
+        free->next = bucket->first;
+        bucket->first = free;
+        bucket->count++;
+        AllowPreemption();
+        return;
+    }
+    AllowPreemption();
+
+    size_t page = getpagesize();
+    munmap((char *) stack - page, page + bytes);
+}
+
+/// Unmap the free stacks in excess of the new limit.
+void
+StackPool::SetMaxFree(unsigned max)
+{
+    size_t page = getpagesize();
+
+    maxFree = max;
+    for (unsigned i = 0; i < numBuckets; i++)
+        while (buckets[i].count > maxFree) {
+            FreeStack *stack = buckets[i].first;
+            buckets[i].first = stack->next;
+            buckets[i].count--;
+            munmap((char *) stack - page, page + buckets[i].bytes);
+        }
+}
+
+bool
+StackPool::InGuard(const void *addr, const HostMemoryAddress *stack)
+{
+    const char *bottom = (const char *) stack;
+    return (const char *) addr >= bottom - getpagesize()
+           && (const char *) addr < bottom;
+}
@@ -0,0 +1,97 @@
+/// Execution stacks for kernel threads.
+///
+/// Every stack is mapped with `mmap`, with a `PROT_NONE` guard page right
+/// below it: a thread that overflows its stack faults on the spot, instead
+/// of silently trashing whatever lies below and being caught (maybe) by the
+/// fencepost check at the next context switch.  The fault is reported by a
+/// `SIGSEGV` handler that runs on its own stack.
+///
+/// Stacks of finished threads are kept, up to `STACK_POOL_MAX_FREE` of
+/// each size, and handed to new threads, so programs that create and
+/// destroy threads all the time (`Exec`, `Join`...) do not map and unmap
+/// memory every time.
+///
+/// Copyright (c) 2016-2017 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_THREADS_STACKPOOL__HH
+#define NACHOS_THREADS_STACKPOOL__HH
+
+
+#include "utility.hh"
+
+#include <stddef.h>
+
+
+/// Free stacks kept for every size.
+const unsigned STACK_POOL_MAX_FREE = 64;
+
+/// Number of different stack sizes kept.  Stacks of other sizes are
+/// unmapped as soon as they are given back.
+const unsigned STACK_POOL_SIZES = 8;
+
+class StackPool {
+public:
+
+    /// Set up an empty pool, and the handler for guard page faults.
+    StackPool();
+
+    /// Unmap the free stacks.  Stacks in use are left alone.
+    ~StackPool();
+
+    /// Return the lowest address of a stack of `words` words.
+    HostMemoryAddress *Get(unsigned words);
+
+    /// Give back `stack`, of `words` words, obtained from `Get`.
+    void Put(HostMemoryAddress *stack, unsigned words);
+
+    /// Change how many free stacks of each size are kept; 0 disables
+    /// recycling.
+    void SetMaxFree(unsigned max);
+
+    /// Whether `addr` is in the guard page of `stack`.
+    static bool InGuard(const void *addr, const HostMemoryAddress *stack);
+
+    /// Stacks mapped and stacks recycled so far, for statistics.
+    unsigned long Mapped()
+    {
+        return mapped;
+    }
+
+    unsigned long Reused()
+    {
+        return reused;
+    }
+
+private:
+
+    /// A free stack; the link lives at its lowest address.
+    struct FreeStack {
+        FreeStack *next;
+    };
+
+    /// Free stacks of `bytes` bytes.
+    struct Bucket {
+        size_t bytes;
+        FreeStack *first;
+        unsigned count;
+    };
+
+    /// Bytes to map for a stack of `words` words, guard page excluded.
+    static size_t BytesFor(unsigned words);
+
+    /// The bucket for `bytes`, creating it if there is room; `NULL` if
+    /// there is not.
+    Bucket *BucketFor(size_t bytes);
+
+    Bucket buckets[STACK_POOL_SIZES];
+    unsigned numBuckets;
+    unsigned maxFree;
+
+    unsigned long mapped;
+    unsigned long reused;
+};
+
+
+#endif
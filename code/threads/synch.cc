@@ -34,7 +34,6 @@ Semaphore::Semaphore(const char *debugName, int initialValue)
 {
     name  = debugName;
     value = initialValue;
-    queue = new List<Thread *>;
     DEBUG('s',"Semaphore %s constructed with initial value %d\n",currentThread->getName(), name,initialValue);
 
 }
@@ -44,7 +43,6 @@ Semaphore::Semaphore(const char *debugName, int initialValue)
 /// Assume no one is still waiting on the semaphore!
 Semaphore::~Semaphore()
 {
-    delete queue;
 }
 
 /// Wait until semaphore `value > 0`, then decrement.
@@ -62,7 +60,7 @@ Semaphore::P()
       // Disable interrupts.
 
     while (value == 0) {  // Semaphore not available.
-        queue->Append(currentThread);  // So go to sleep.
+        queue.Append(currentThread);  // So go to sleep.
         currentThread->Sleep();
     }
     value--;  // Semaphore available, consume its value.
@@ -70,6 +68,29 @@ Semaphore::P()
     interrupt->SetLevel(oldLevel);  // Re-enable interrupts.
 }
 
+/// Like `P`, but the thread also sleeps on the alarm clock, which takes it
+/// off `queue` if the deadline passes first.
+bool
+Semaphore::P(unsigned timeout)
+{
+    DEBUG('s',"%s does semaphore %s P, timeout %u\n", currentThread->getName(),name,timeout);
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+
+    unsigned long deadline = alarmClock->Deadline(timeout);
+    bool inTime = true;
+    while (value == 0 && inTime) {
+        queue.Append(currentThread);
+        alarmClock->Arm(currentThread, deadline, &queue);
+        currentThread->Sleep();
+        inTime = alarmClock->Disarm(currentThread);
+    }
+    if (inTime)
+        value--;
+
+    interrupt->SetLevel(oldLevel);
+    return inTime;
+}
+
 /// Increment semaphore value, waking up a waiter if necessary.
 ///
 /// As with `P`, this operation must be atomic, so we need to disable
@@ -83,61 +104,163 @@ Semaphore::V()
     Thread   *thread;
     IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
 
-    thread = queue->Remove();
+    thread = queue.Remove();
     if (thread != NULL)  // Make thread ready, consuming the `V` immediately.
         scheduler->ReadyToRun(thread);
     value++;
     interrupt->SetLevel(oldLevel);
 }
 
-/// Dummy functions -- so we can compile our later assignments.
-///
-/// Note -- without a correct implementation of `Condition::Wait`, the test
-/// case in the network assignment will not work!
+/// The thread of highest effective priority in `queue`, the first one among
+/// equals; `NULL` if `queue` is empty.
+static Thread *
+HighestPriority(IntrusiveList<Thread, &Thread::queueHook> *queue)
+{
+    Thread *thread = NULL;
+    for (Thread *t = queue->First(); t != NULL; t = queue->Next(t))
+        if (thread == NULL
+              || t->GetEffectivePriority() > thread->GetEffectivePriority())
+            thread = t;
+    return thread;
+}
 
+/// Initialize a lock, free.
+///
+/// * `debugName` is an arbitrary name, useful for debugging.
 Lock::Lock(const char *debugName) {
-    sem = new Semaphore(debugName, 1);
     name = debugName;
     heldBy = NULL;    
+    nextHeld = NULL;
 }
 
+/// De-allocate a lock.  Nobody may hold it or be waiting for it.
 Lock::~Lock() {
     ASSERT (heldBy == NULL);
-    delete sem;
 }
 
+int
+Lock::WaiterPriority() {
+    int prio = -1;
+    for (Thread *t = waiters.First(); t != NULL; t = waiters.Next(t))
+        if (t->GetEffectivePriority() > prio)
+            prio = t->GetEffectivePriority();
+    return prio;
+}
+
+/// Walk the chain of holders from `thread`: each one inherits from the
+/// waiters of the locks it holds.  Stop as soon as a priority does not
+/// change, since nothing further down the chain can change either.
+void
+Lock::Propagate(Thread *thread) {
+    ASSERT(interrupt->getLevel() == INT_OFF);
+
+    for (unsigned depth = 0; thread != NULL && depth < DONATION_DEPTH;
+         depth++) {
+        int prio = thread->GetPriority();
+        for (Lock *lock = thread->heldLocks; lock != NULL;
+             lock = lock->nextHeld) {
+            int donated = lock->WaiterPriority();
+            if (donated > prio)
+                prio = donated;
+        }
+        if (prio == thread->effectivePriority)
+            break;
+
+        DEBUG('s', "Thread %s now runs at priority %d\n",
+              thread->getName(), prio);
+        thread->effectivePriority = prio;
+        scheduler->ChangePriorityList(thread, prio);
+        thread = thread->waitingOn != NULL ? thread->waitingOn->heldBy : NULL;
+    }
+}
+
+/// Block `thread` on the lock.  If it has a higher priority than the
+/// holder, lend it to the holder until it releases the lock, and on to
+/// whoever holds a lock the holder waits for, so that a thread of
+/// intermediate priority cannot keep any of them from running.
+void
+Lock::AddWaiter(Thread *thread) {
+    ASSERT(interrupt->getLevel() == INT_OFF);
+    ASSERT(heldBy != NULL && heldBy != thread);
+
+    DEBUG('s',"The lock has been already acquired by %s. Comparing priorities: ¿owner: %d < %d :current ? \n",heldBy->getName(), heldBy->GetEffectivePriority() , thread->GetEffectivePriority());
+    waiters.Append(thread);
+    thread->waitingOn = this;
+    Propagate(heldBy);
+
+    Thread *holder = heldBy;
+    for (unsigned depth = 0; holder != NULL && depth < DONATION_DEPTH;
+         depth++) {
+        scheduler->Lend(holder, thread);
+        holder = holder->waitingOn != NULL ? holder->waitingOn->heldBy : NULL;
+    }
+}
+
+/// Take the lock, sleeping on `waiters` for as long as it is busy.  The
+/// threads still waiting donate to us from now on.
 void
+Lock::Take() {
+    ASSERT(interrupt->getLevel() == INT_OFF);
 
+    while (heldBy != NULL) {  // Somebody may take it before we run.
+        AddWaiter(currentThread);
+        currentThread->Sleep();
+    }
+    heldBy = currentThread;
+    currentThread->waitingOn = NULL;
+    nextHeld = currentThread->heldLocks;
+    currentThread->heldLocks = this;
+    if (!waiters.IsEmpty())
+        Propagate(currentThread);
+}
+
+/// Wait until the lock is free and take it.
+void
 Lock::Acquire() {
     DEBUG('s',"Thread %s tries to acquire the lock %s\n",currentThread->getName(),name);
     ASSERT(!isHeldByCurrentThread());
-    if (heldBy!=NULL) {
-        DEBUG('s',"The lock has been already acquired by %s. Comparing priorities: ¿owner: %d < %d :current ? \n",heldBy->getName(), heldBy->GetEffectivePriority() , currentThread->GetEffectivePriority());
-        if (heldBy->GetEffectivePriority() < currentThread->GetEffectivePriority() ) {
-            DEBUG('s',"Upgrading owner's priority\n");
-            heldBy->ChangePriority(currentThread->GetEffectivePriority());
-            scheduler->ChangePriorityList(heldBy,heldBy->GetPriority(),heldBy->GetEffectivePriority());
-            //scheduler->ReadyToRun(currentThread); 
-        }
-    }
-    sem->P();
-    heldBy = currentThread; 
+
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    Take();
+    interrupt->SetLevel(oldLevel);
     DEBUG('s',"Thread %s acquired the lock %s\n",currentThread->getName(),name);       
 }
 
+/// Free the lock, giving back the priority lent to us through it (but not
+/// what comes through other locks we still hold), and wake up the waiter of
+/// highest priority, if there is one.  Under fair share, the virtual
+/// runtime lent is paid back once no lock we hold has waiters left.
 void
 Lock::Release(){
 	DEBUG('s',"Thread %s tries to release the lock %s\n",currentThread->getName(),name);
     ASSERT(isHeldByCurrentThread());
 
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
     DEBUG('s',"Thread %s released the lock %s\n",currentThread->getName(),name);
-    if (currentThread->GetEffectivePriority() != currentThread->GetPriority()){
-        scheduler->ChangePriorityList(heldBy,heldBy->GetEffectivePriority(),heldBy->GetPriority());
-        currentThread -> ResetPriority();
-    }
 
+    Lock **link = &currentThread->heldLocks;
+    while (*link != this)
+        link = &(*link)->nextHeld;
+    *link = nextHeld;
+    nextHeld = NULL;
     heldBy = NULL;
-    sem->V();    
+    Propagate(currentThread);
+
+    bool contended = false;
+    for (Lock *lock = currentThread->heldLocks; lock != NULL;
+         lock = lock->nextHeld)
+        if (!lock->waiters.IsEmpty())
+            contended = true;
+    if (!contended)
+        scheduler->Repay(currentThread);
+
+    Thread *thread = HighestPriority(&waiters);
+    if (thread != NULL) {
+        waiters.Unlink(thread);
+        thread->waitingOn = NULL;
+        scheduler->ReadyToRun(thread);
+    }
+    interrupt->SetLevel(oldLevel);
 }
 
 bool Lock::isHeldByCurrentThread(){
@@ -147,45 +270,180 @@ bool Lock::isHeldByCurrentThread(){
 
 Condition::Condition(const char *debugName, Lock *conditionLock){
     DEBUG('s',"Constructing conditional variable %s\n",debugName);
-    queue = new List<Semaphore*>;    
     name = debugName;
     lock = conditionLock;    
 }
 
 Condition::~Condition(){
-    delete queue;
 }
 
+/// Release the lock and sleep until signalled; return holding the lock
+/// again.
+///
+/// Interrupts stay off from queueing to sleeping, so a `Signal` cannot slip
+/// in between.  When the thread runs again, the signaller has moved it to
+/// the lock's queue and then released the lock.
 void Condition::Wait(){
     ASSERT(lock->isHeldByCurrentThread());
-    Semaphore *sem = new Semaphore("CondSem", 0);
-    queue->Append(sem);
+
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    queue.Append(currentThread);
     lock->Release();
-    sem->P(); 
-    lock->Acquire();   
-    delete sem;
+    currentThread->Sleep();
+    lock->Take();
+    interrupt->SetLevel(oldLevel);
 }
 
+/// If the deadline passes first, the alarm clock takes the thread off
+/// `queue` and wakes it up; it takes the lock again as usual.  Once
+/// signalled, the thread is on the lock's queue, where the alarm leaves it.
+bool Condition::Wait(unsigned timeout){
+    ASSERT(lock->isHeldByCurrentThread());
+
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    queue.Append(currentThread);
+    alarmClock->Arm(currentThread, alarmClock->Deadline(timeout), &queue);
+    lock->Release();
+    currentThread->Sleep();
+    bool signalled = alarmClock->Disarm(currentThread);
+    lock->Take();
+    interrupt->SetLevel(oldLevel);
+    return signalled;
+}
+
+/// Move the first waiter, if any, to the lock's queue.  It will be woken up
+/// when the caller releases the lock.
 void Condition::Signal(){
-    Semaphore *semTemp;
-    
     ASSERT(lock->isHeldByCurrentThread());    
-    if (!queue->IsEmpty()) {
-        semTemp = queue->Remove();
-        semTemp->V();
-    }
+
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    Thread *thread = queue.Remove();
+    if (thread != NULL)
+        lock->AddWaiter(thread);
+    interrupt->SetLevel(oldLevel);
 }
 
+/// Move every waiter to the lock's queue.
 void Condition::Broadcast(){
-    Semaphore *sem;
+    ASSERT(lock->isHeldByCurrentThread());
 
-    while (!queue->IsEmpty()) {
-        sem = queue->Remove();
-        sem->V();
-    }    
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    Thread *thread;
+    while ((thread = queue.Remove()) != NULL)
+        lock->AddWaiter(thread);
+    interrupt->SetLevel(oldLevel);
 }
 
 
+/// Initialize a reader-writer lock, free.
+RWLock::RWLock(const char *debugName)
+{
+    name = debugName;
+    readers = 0;
+    maxReaders = 0;
+    writer = NULL;
+}
+
+RWLock::~RWLock()
+{
+    ASSERT(readers == 0 && writer == NULL);
+}
+
+bool
+RWLock::IsWriteHeldByCurrentThread()
+{
+    return writer == currentThread;
+}
+
+void
+RWLock::AdmitReaders()
+{
+    Thread *thread;
+    while ((thread = readWaiters.Remove()) != NULL) {
+        readers++;
+        scheduler->ReadyToRun(thread);
+    }
+    if (readers > maxReaders)
+        maxReaders = readers;
+}
+
+void
+RWLock::AdmitWriter()
+{
+    Thread *thread = HighestPriority(&writeWaiters);
+    if (thread != NULL) {
+        writeWaiters.Unlink(thread);
+        writer = thread;
+        scheduler->ReadyToRun(thread);
+    }
+}
+
+/// Wait if there is a writer, holding the lock or waiting for it.  Whoever
+/// wakes us up counts us in as a reader.
+void
+RWLock::AcquireRead()
+{
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    ASSERT(writer != currentThread);
+
+    if (writer != NULL || !writeWaiters.IsEmpty()) {
+        DEBUG('s', "%s waits to read %s\n", currentThread->getName(), name);
+        readWaiters.Append(currentThread);
+        currentThread->Sleep();
+    } else if (++readers > maxReaders)
+        maxReaders = readers;
+
+    interrupt->SetLevel(oldLevel);
+}
+
+/// The last reader out lets a writer in.
+void
+RWLock::ReleaseRead()
+{
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    ASSERT(readers > 0 && writer == NULL);
+
+    if (--readers == 0)
+        AdmitWriter();
+
+    interrupt->SetLevel(oldLevel);
+}
+
+/// Wait if anybody holds the lock.  Whoever wakes us up makes us the
+/// writer.
+void
+RWLock::AcquireWrite()
+{
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    ASSERT(writer != currentThread);
+
+    if (writer != NULL || readers > 0) {
+        DEBUG('s', "%s waits to write %s\n", currentThread->getName(), name);
+        writeWaiters.Append(currentThread);
+        currentThread->Sleep();
+        ASSERT(writer == currentThread);
+    } else
+        writer = currentThread;
+
+    interrupt->SetLevel(oldLevel);
+}
+
+/// Readers waiting go first, then writers.
+void
+RWLock::ReleaseWrite()
+{
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    ASSERT(writer == currentThread);
+
+    writer = NULL;
+    if (!readWaiters.IsEmpty())
+        AdmitReaders();
+    else
+        AdmitWriter();
+
+    interrupt->SetLevel(oldLevel);
+}
+
 Port::Port(const char* debugName){
     full = false;
     name = debugName; 
@@ -244,4 +502,126 @@ void Port::Receive(int *data){
     write_allowed->Signal();
 
     lock->Release();
-}
\ No newline at end of file
+}
+
+
+Completion::Completion(const char *debugName)
+{
+    name = debugName;
+    done = false;
+    status = 0;
+    id = -1;
+    group = NULL;
+}
+
+Completion::~Completion()
+{
+    ASSERT(waiters.IsEmpty());
+#ifdef USER_PROGRAM
+    if (id >= 0)
+        procTable->Remove(id);
+#endif
+}
+
+void
+Completion::Complete(int st)
+{
+    ASSERT(interrupt->getLevel() == INT_OFF);
+    ASSERT(!done);
+
+    DEBUG('s', "Completion %s done with status %d\n", name, st);
+    done = true;
+    status = st;
+
+    Thread *thread;
+    while ((thread = waiters.Remove()) != NULL)
+        scheduler->ReadyToRun(thread);
+
+    if (group != NULL)
+        group->Completed(this);
+    else
+        delete this;  // Orphaned: nobody will reap it.
+}
+
+CompletionGroup::CompletionGroup()
+{
+}
+
+CompletionGroup::~CompletionGroup()
+{
+    ASSERT(waiters.IsEmpty());
+
+    Completion *completion;
+    while ((completion = running.Remove()) != NULL)
+        completion->group = NULL;
+    while ((completion = done.Remove()) != NULL)
+        delete completion;
+}
+
+void
+CompletionGroup::Add(Completion *completion)
+{
+    ASSERT(completion->group == NULL && !completion->done);
+
+    completion->group = this;
+    running.Append(completion);
+}
+
+void
+CompletionGroup::Completed(Completion *completion)
+{
+    running.Unlink(completion);
+    done.Append(completion);
+
+    Thread *thread = waiters.Remove();
+    if (thread != NULL)
+        scheduler->ReadyToRun(thread);
+}
+
+int
+CompletionGroup::Wait(Completion *completion)
+{
+    ASSERT(Contains(completion));
+
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    while (!completion->done) {
+        completion->waiters.Append(currentThread);
+        currentThread->Sleep();
+    }
+    done.Unlink(completion);
+    interrupt->SetLevel(oldLevel);
+
+    int status = completion->status;
+    delete completion;
+    return status;
+}
+
+bool
+CompletionGroup::WaitAny(int *id, int *status)
+{
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+
+    // Somebody else may reap the child that woke us up, so check again.
+    while (done.IsEmpty() && !running.IsEmpty()) {
+        waiters.Append(currentThread);
+        currentThread->Sleep();
+    }
+    Completion *completion = done.Remove();
+    interrupt->SetLevel(oldLevel);
+
+    if (completion == NULL)
+        return false;
+    *id = completion->id;
+    *status = completion->status;
+    delete completion;
+    return true;
+}
+
+void
+CompletionGroup::Discard(Completion *completion)
+{
+    ASSERT(Contains(completion) && !completion->done);
+
+    running.Unlink(completion);
+    delete completion;
+}
@@ -58,6 +58,10 @@ public:
     void P();
     void V();
 
+    /// `P`, giving up after `timeout` ticks.  Return whether the value
+    /// was decremented.
+    bool P(unsigned timeout);
+
 private:
 
     /// For debugging.
@@ -67,7 +71,7 @@ private:
     int value;
 
     /// Queue of threads waiting on `P` because the value is zero.
-    List<Thread *> *queue;
+    IntrusiveList<Thread, &Thread::queueHook> queue;
 };
 
 /// This class defines a “lock”.
@@ -81,8 +85,22 @@ private:
 ///
 /// For convenience, nobody but the thread that holds the lock can free it.
 /// There is no operation for reading the state of the lock.
+///
+/// `Release` frees the lock and wakes up the waiter of highest priority,
+/// which takes it if it is still free when it runs.  Handing it over
+/// instead would make a thread that releases and re-acquires the lock in a
+/// loop (as `Port` does) block behind the waiter every time.
+///
+/// Priority inheritance: the effective priority of a thread is the highest
+/// of its own and those of the threads waiting for the locks it holds.  As
+/// a thread blocked on a lock may itself hold locks that others wait for,
+/// donations follow the chain of holders, up to `DONATION_DEPTH` links,
+/// and they are recomputed from the locks still held on every release.
 
 
+/// Longest chain of lock holders a donation goes through.
+const unsigned DONATION_DEPTH = 16;
+
 class Lock {
   public:
 
@@ -97,9 +115,32 @@ class Lock {
   bool isHeldByCurrentThread();	
 
   private:         
+    friend class Condition;
+
+    /// Queue `thread`, which is blocked, for the lock, donating its
+    /// priority to the holder if it is higher.  Interrupts must be off.
+    void AddWaiter(Thread *thread);
+
+    /// Sleep until the lock is free and take it.  Interrupts must be off.
+    void Take();
+
+    /// Highest effective priority among the waiters, -1 if there are none.
+    int WaiterPriority();
+
+    /// Recompute the effective priority of `thread` from the locks it
+    /// holds, and pass the change on to the holder of the lock it waits
+    /// for, and so on.
+    static void Propagate(Thread *thread);
+
     const char* name;				
-    Semaphore *sem;                 
     Thread *heldBy;              
+
+    /// Next lock held by `heldBy`.
+    Lock *nextHeld;
+
+    /// Threads waiting to acquire the lock, in arrival order.  Each one has
+    /// its `waitingOn` pointing here.
+    IntrusiveList<Thread, &Thread::queueHook> waiters;
 };
 
 
@@ -136,6 +177,13 @@ class Lock {
 // The “Mesa” style is somewhat simpler to implement, but it does not
 // guarantee that the woken thread recover the control of the lock
 // immediately.
+//
+// This implementation is Mesa style with “wait morphing”: as the signaller
+// holds the lock, waking a waiter up would only make it block again on
+// `Lock::Acquire`.  Instead `Signal` and `Broadcast` move waiters straight
+// to the lock's queue, and they are woken up when it is released.
+// Waiters are queued through their own `Thread::queueHook`, so waiting
+// allocates nothing.
 class Condition {
 public:
 
@@ -157,13 +205,80 @@ public:
     void Signal();
     void Broadcast();
 
+    /// `Wait`, but for at most `timeout` ticks.  Return false if not
+    /// signalled in time.  The lock is held again either way.
+    bool Wait(unsigned timeout);
+
 private:
 
     const char *name;
     Lock* lock;
-    List<Semaphore*> *queue;
 
-    // Other needed fields are to be added here.
+    /// Threads blocked in `Wait`, in arrival order.
+    IntrusiveList<Thread, &Thread::queueHook> queue;
+};
+
+/// This class defines a “reader-writer lock”.
+///
+/// Any number of readers may hold it at once, or a single writer:
+///
+/// * `AcquireRead` -- wait until no writer holds the lock or waits for it,
+///   and share it with the other readers.
+/// * `AcquireWrite` -- wait until nobody holds the lock, and take it alone.
+///
+/// Writers are preferred: once one is waiting, new readers wait behind it,
+/// so a stream of readers cannot starve it.  Readers cannot be starved
+/// either: a writer hands the lock over to all the readers waiting, if
+/// any, before the next writer.  Among the writers, the one of highest
+/// priority goes first.  Unlike `Lock`, the lock is handed over to the
+/// threads it wakes up, which find it already theirs when they run.
+class RWLock {
+public:
+
+    RWLock(const char *debugName);
+
+    /// Nobody may hold the lock or be waiting for it.
+    ~RWLock();
+
+    const char *GetName()
+    {
+        return name;
+    }
+
+    void AcquireRead();
+    void ReleaseRead();
+    void AcquireWrite();
+    void ReleaseWrite();
+
+    bool IsWriteHeldByCurrentThread();
+
+    /// Most readers that have held the lock at once, for statistics.
+    unsigned MaxReaders()
+    {
+        return maxReaders;
+    }
+
+private:
+
+    /// Let every waiting reader in.  Interrupts must be off.
+    void AdmitReaders();
+
+    /// Hand the lock to the waiting writer of highest priority, if any.
+    /// Interrupts must be off.
+    void AdmitWriter();
+
+    const char *name;
+
+    /// Readers holding the lock, and the most there have been at once.
+    unsigned readers;
+    unsigned maxReaders;
+
+    /// Writer holding the lock, if any.
+    Thread *writer;
+
+    /// Threads waiting to read and to write.
+    IntrusiveList<Thread, &Thread::queueHook> readWaiters;
+    IntrusiveList<Thread, &Thread::queueHook> writeWaiters;
 };
 
 class Port {
@@ -193,6 +308,112 @@ class Port {
 
 };
 
+class CompletionGroup;
+
+/// The end of a joinable thread: whether it has finished, and its exit
+/// status.
+///
+/// A completion belongs to the `CompletionGroup` of the thread that created
+/// the joinable one (its parent), which reaps it -- waits for it, reads
+/// the status and deletes it.  Completing never blocks: a finishing thread
+/// just records its status and goes away.  If the parent goes away first,
+/// the completion is orphaned and deletes itself when it completes.
+///
+/// Under *USER_PROGRAM*, `id` is the process identifier of the thread, and
+/// deleting the completion frees it.
+class Completion {
+public:
+
+    Completion(const char *debugName);
+
+    /// Free the process identifier, if any.
+    ~Completion();
+
+    /// Record `status` and wake up whoever waits for it.  Never blocks.
+    /// Called once, by the finishing thread, with interrupts disabled.
+    void Complete(int status);
+
+    bool IsComplete()
+    {
+        return done;
+    }
+
+    int GetStatus()
+    {
+        return status;
+    }
+
+    int GetId()
+    {
+        return id;
+    }
+
+    void SetId(int newId)
+    {
+        id = newId;
+    }
+
+    /// Links for the list of the group the completion is on.
+    ListHook<Completion> groupHook;
+
+private:
+    friend class CompletionGroup;
+
+    const char *name;
+    bool done;
+    int status;
+    int id;
+
+    /// Group of the parent, `NULL` once orphaned.
+    CompletionGroup *group;
+
+    /// Threads waiting for this completion in particular.
+    IntrusiveList<Thread, &Thread::queueHook> waiters;
+};
+
+/// The children of a thread: completions still running, and completed ones
+/// not reaped yet, each on a list of its own, so that waiting for a given
+/// child or for any child takes constant time per child.
+class CompletionGroup {
+public:
+
+    CompletionGroup();
+
+    /// Orphan the children still running, and delete the completed ones.
+    ~CompletionGroup();
+
+    /// Add `completion` as a child.
+    void Add(Completion *completion);
+
+    /// Whether `completion` is one of the children.
+    bool Contains(Completion *completion)
+    {
+        return completion->group == this;
+    }
+
+    /// Wait for the child `completion`, delete it and return its status.
+    int Wait(Completion *completion);
+
+    /// Wait for any child and delete it, storing its id and status in `*id`
+    /// and `*status`.  Return false at once if there are no children.
+    bool WaitAny(int *id, int *status);
+
+    /// Delete the child `completion`, which has not started.
+    void Discard(Completion *completion);
+
+private:
+    friend class Completion;
+
+    /// Move `completion` from `running` to `done`.
+    void Completed(Completion *completion);
+
+    IntrusiveList<Completion, &Completion::groupHook> running;
+    IntrusiveList<Completion, &Completion::groupHook> done;
+
+    /// Threads waiting in `WaitAny`.
+    IntrusiveList<Thread, &Thread::queueHook> waiters;
+};
+
 
 
 
@@ -9,6 +9,9 @@
 #include "system.hh"
 #include "preemptive.hh"
 
+#include <ctype.h>
+#include <limits.h>
+
 /// This defines *all* of the global data structures used by Nachos.
 ///
 /// These are all initialized and de-allocated by this file.
@@ -20,10 +23,18 @@ Interrupt *interrupt;         ///< Interrupt status.
 Statistics *stats;            ///< Performance metrics.
 Timer *timer;                 ///< The hardware timer device, for invoking
                               ///< context switches.
+StackPool *stackPool;         ///< Stacks for kernel threads.
+Alarm *alarmClock;            ///< Sleeping threads.
+Cpu *cpus[MAX_CPUS];          ///< The processors.
+unsigned numCpus;             ///< How many there are (`-smp`).
+Cpu *currentCpu;              ///< The one whose turn it is.
+Accounting *accounting;       ///< Resources used, by whom.
+Tracer *tracer;               ///< Events of the kernel (`-trace`).
 
 // 2007, Jose Miguel Santos Espino
 PreemptiveScheduler *preemptiveScheduler = NULL;
-const long long DEFAULT_TIME_SLICE = 50000;
+const long long DEFAULT_TIME_SLICE = 50000;         // Instructions (`-pt`).
+const long long DEFAULT_SIGNAL_TIME_SLICE = 1000;  // Microseconds (`-p`).
 
 #ifdef FILESYS_NEEDED
 FileSystem *fileSystem;
@@ -31,6 +42,7 @@ FileSystem *fileSystem;
 
 #ifdef FILESYS
 SynchDisk *synchDisk;
+FileLockTable *fileLocks;
 #endif
 
 #ifdef USER_PROGRAM  // Requires either *FILESYS* or *FILESYS_STUB*.
@@ -38,6 +50,8 @@ Machine *machine;  ///< User program memory and registers.
 SynchConsole *synchconsole;
 BitMap *bitmap;
 ProcTable *procTable;
+FutexTable *futexTable;
+SyscallStats *syscallStats;
 #endif
 
 #ifdef VMEM
@@ -55,13 +69,15 @@ extern void Cleanup();
 ///
 /// The timer device is set up to interrupt the CPU periodically (once every
 /// `TimerTicks`).  This routine is called each time there is a timer
-/// interrupt, with interrupts disabled.
+/// interrupt, with interrupts disabled.  It wakes up the sleeping threads
+/// whose time has come.
 ///
 /// Note that instead of calling `Yield` directly (which would suspend the
 /// interrupt handler, not the interrupted thread which is what we wanted to
 /// context switch), we set a flag so that once the interrupt handler is
 /// done, it will appear as if the interrupted thread called Yield at the
-/// point it is was interrupted.
+/// point it is was interrupted.  Under SMP, the timer interrupts every CPU,
+/// and each one yields when its turn comes.
 ///
 /// * `dummy` is because every interrupt handler takes one argument, whether
 ///   it needs it or not.
@@ -69,12 +85,40 @@ extern void Cleanup();
 static void
 TimerInterruptHandler(void *dummy)
 {
-    static unsigned tick_counter =0;
-
-    if (tick_counter==0 && interrupt->getStatus() != IDLE_MODE)
+    alarmClock->Tick();
+
+    // The scheduler keeps track of every thread's quantum.
+    if (numCpus > 1) {
+        for (unsigned i = 0; i < numCpus; i++)
+            if (cpus[i]->current != NULL
+                  && scheduler->TimerTick(cpus[i]->current))
+                cpus[i]->yieldOnReturn = true;
+    } else if (interrupt->getStatus() != IDLE_MODE
+                 && scheduler->TimerTick(currentThread))
         interrupt->YieldOnReturn();
+    ProgramTimer();
+}
 
-    tick_counter=(tick_counter+1)%QUANTUM; // SO that we interrupt every QUANTUM ticks
+/// Under dynamic ticks, program the next timer interrupt for the first
+/// thing that needs it: the end of the running thread's quantum (or an MLFQ
+/// boost) if others are ready, or the next sleeping thread's deadline.  If there is neither,
+/// stop the timer: when everything is blocked, the clock then jumps
+/// straight to the next device interrupt.
+void
+ProgramTimer()
+{
+    if (!timer->IsDynamic())
+        return;
+
+    unsigned now = stats->totalTicks;
+    unsigned long limit = ULONG_MAX;
+    if (scheduler->HasReady())
+        limit = now + scheduler->TimeToPreempt();
+    unsigned long when = alarmClock->NextDeadline(limit);
+    if (when == ULONG_MAX)
+        timer->Stop();
+    else
+        timer->SetNext(when > now ? when - now : 1);
 }
 
 /// Initialize Nachos global data structures.
@@ -95,13 +139,20 @@ Initialize(int argc, char **argv)
     int argCount;
     const char *debugArgs = "";
     bool randomYield = false;
+    bool dynamicTicks = false;
+    SchedPolicy policy = PRIORITY_SCHED;
+    unsigned cpuCount = 1;
+    bool accountingOn = false, accountingCsv = false;
+    const char *traceFile = NULL;
 
     // 2007, Jose Miguel Santos Espino
     bool preemptiveScheduling = false;
+    bool tracedPreemption = false;
     long long timeSlice;
 
 #ifdef USER_PROGRAM
     bool debugUserProg = false;  // Single step user program.
+    bool syscallReport = false;  // Report system calls at halt.
 #endif
 #ifdef FILESYS_NEEDED
     bool format = false;  // Format disk.
@@ -126,20 +177,44 @@ Initialize(int argc, char **argv)
                                             // number generator.
             randomYield = true;
             argCount = 2;
+        } else if (!strcmp(*argv, "-mlfq")) {
+            policy = MLFQ_SCHED;  // Multi-level feedback queue scheduling.
+        } else if (!strcmp(*argv, "-fair")) {
+            policy = FAIR_SCHED;  // Proportional share scheduling.
+        } else if (!strcmp(*argv, "-dt")) {
+            dynamicTicks = true;  // Timer interrupts only when needed.
+        } else if (!strcmp(*argv, "-smp")) {
+            ASSERT(argc > 1);
+            cpuCount = atoi(*(argv + 1));  // Simulated processors.
+            ASSERT(cpuCount >= 1 && cpuCount <= MAX_CPUS);
+            argCount = 2;
+        } else if (!strcmp(*argv, "-acct")) {
+            accountingOn = true;  // Report resources used.
+            if (argc > 1 && !strcmp(*(argv + 1), "csv")) {
+                accountingCsv = true;
+                argCount = 2;
+            }
+        } else if (!strcmp(*argv, "-trace")) {
+            ASSERT(argc > 1);
+            traceFile = *(argv + 1);  // Record events of the kernel.
+            argCount = 2;
         }
         // 2007, Jose Miguel Santos Espino
-        else if (!strcmp(*argv, "-p")) {
+        else if (!strcmp(*argv, "-p") || !strcmp(*argv, "-pt")) {
             preemptiveScheduling = true;
-            if (argc == 1) {
-                timeSlice = DEFAULT_TIME_SLICE;
-            } else {
+            tracedPreemption = !strcmp(*argv, "-pt");
+            if (argc > 1 && isdigit(**(argv + 1))) {
                 timeSlice = atoi(*(argv+1));
                 argCount = 2;
-            }
+            } else
+                timeSlice = tracedPreemption ? DEFAULT_TIME_SLICE
+                                             : DEFAULT_SIGNAL_TIME_SLICE;
         }
 #ifdef USER_PROGRAM
         if (!strcmp(*argv, "-s"))
             debugUserProg = true;
+        else if (!strcmp(*argv, "-syscalls"))
+            syscallReport = true;
 #endif
 #ifdef FILESYS_NEEDED
         if (!strcmp(*argv, "-f"))
@@ -161,9 +236,20 @@ Initialize(int argc, char **argv)
     DebugInit(debugArgs);         // Initialize `DEBUG` messages.
     stats = new Statistics();     // Collect statistics.
     interrupt = new Interrupt;    // Start up interrupt handling.
-    scheduler = new Scheduler();  // Initialize the ready queue.
+    scheduler = new Scheduler(policy);  // Initialize the ready queue.
+
+    // Only static priorities have per-CPU queues.
+    ASSERT(cpuCount == 1 || policy == PRIORITY_SCHED);
+    numCpus = cpuCount;
+    for (unsigned i = 0; i < numCpus; i++)
+        cpus[i] = new Cpu(i);
+    currentCpu = cpus[0];
+    accounting = new Accounting(accountingOn, accountingCsv);
+    tracer = new Tracer(traceFile);
+    stackPool = new StackPool();
+    alarmClock = new Alarm();
     //if (randomYield)              // Start the timer (if needed).
-    timer = new Timer(TimerInterruptHandler, 0, randomYield); // ->Always
+    timer = new Timer(TimerInterruptHandler, 0, randomYield, dynamicTicks);
 
     threadToBeDestroyed = NULL;
 
@@ -172,6 +258,8 @@ Initialize(int argc, char **argv)
     // object to save its state.
     currentThread = new Thread("main");
     currentThread->setStatus(RUNNING);
+    currentCpu->current = currentThread;
+    tracer->RecordThread(TRACE_THREAD_START, currentThread);
 
     interrupt->Enable();
     CallOnUserAbort(Cleanup);  // If user hits ctl-C...
@@ -179,7 +267,10 @@ Initialize(int argc, char **argv)
     // Jose Miguel Santos Espino, 2007
     if (preemptiveScheduling) {
         preemptiveScheduler = new PreemptiveScheduler();
-        preemptiveScheduler->SetUp(timeSlice);
+        if (tracedPreemption)
+            preemptiveScheduler->SetUp(timeSlice);
+        else
+            preemptiveScheduler->SetUpTimer(timeSlice);
     }
 
 #ifdef USER_PROGRAM
@@ -187,6 +278,8 @@ Initialize(int argc, char **argv)
     synchconsole = new SynchConsole(NULL,NULL);
     bitmap = new BitMap(NUM_PHYS_PAGES);
     procTable = new ProcTable();
+    futexTable = new FutexTable();
+    syscallStats = new SyscallStats(syscallReport);
 #endif
 
 #ifdef VMEM
@@ -195,6 +288,7 @@ Initialize(int argc, char **argv)
 
 #ifdef FILESYS
     synchDisk = new SynchDisk("DISK");
+    fileLocks = new FileLockTable();
 #endif
 
 #ifdef FILESYS_NEEDED
@@ -224,6 +318,8 @@ Cleanup()
     delete synchconsole;
     delete bitmap;
     delete procTable;
+    delete futexTable;
+    delete syscallStats;
 #endif
 
 #ifdef VMEM
@@ -235,12 +331,21 @@ Cleanup()
 #endif
 
 #ifdef FILESYS
+    delete fileLocks;
     delete synchDisk;
 #endif
 
+    tracer->Write();
+
     delete timer;
+    delete alarmClock;
     delete scheduler;
+    for (unsigned i = 0; i < numCpus; i++)
+        delete cpus[i];
+    delete accounting;
+    delete tracer;
     delete interrupt;
+    delete stackPool;  // Only the free stacks: we are running on one.
 
     Exit(0);
 }
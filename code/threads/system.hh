@@ -8,17 +8,22 @@
 #ifndef NACHOS_THREADS_SYSTEM__HH
 #define NACHOS_THREADS_SYSTEM__HH
 
-#define QUANTUM 20
-
 #include "utility.hh"
 #include "thread.hh"
 #include "scheduler.hh"
+#include "stack_pool.hh"
+#include "alarm.hh"
+#include "cpu.hh"
+#include "accounting.hh"
+#include "tracer.hh"
 #include "machine/interrupt.hh"
 #include "machine/statistics.hh"
 #include "machine/timer.hh"
 #include "userprog/synchconsole.hh"
 #include "userprog/bitmap.hh"
 #include "userprog/proctable.hh"
+#include "userprog/futex_table.hh"
+#include "userprog/syscall_stats.hh"
 
 /// Initialization and cleanup routines.
 
@@ -28,6 +33,9 @@ extern void Initialize(int argc, char **argv);
 // Cleanup, called when Nachos is done.
 extern void Cleanup();
 
+// Program the next timer interrupt, under dynamic ticks.
+extern void ProgramTimer();
+
 
 extern Thread *currentThread;        ///< The thread holding the CPU.
 extern Thread *threadToBeDestroyed;  ///< The thread that just finished.
@@ -35,6 +43,13 @@ extern Scheduler *scheduler;         ///< The ready list.
 extern Interrupt *interrupt;         ///< Interrupt status.
 extern Statistics *stats;            ///< Performance metrics.
 extern Timer *timer;                 ///< The hardware alarm clock.
+extern StackPool *stackPool;         ///< Stacks for kernel threads.
+extern Alarm *alarmClock;            ///< Sleeping threads.
+extern Cpu *cpus[MAX_CPUS];          ///< The processors.
+extern unsigned numCpus;             ///< How many there are (`-smp`).
+extern Cpu *currentCpu;              ///< The one whose turn it is.
+extern Accounting *accounting;       ///< Resources used, by whom.
+extern Tracer *tracer;               ///< Events of the kernel (`-trace`).
 
 
 
@@ -44,6 +59,8 @@ extern Machine* machine;  // User program memory and registers.
 extern SynchConsole *synchconsole;
 extern BitMap *bitmap;
 extern ProcTable *procTable;
+extern FutexTable *futexTable;
+extern SyscallStats *syscallStats;
 #endif
 
 #ifdef VMEM
@@ -57,7 +74,9 @@ extern FileSystem *fileSystem;
 
 #ifdef FILESYS
 #include "filesys/synch_disk.hh"
+#include "filesys/file_lock_table.hh"
 extern SynchDisk *synchDisk;
+extern FileLockTable *fileLocks;
 #endif
 
 #ifdef NETWORK
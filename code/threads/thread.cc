@@ -32,28 +32,54 @@ const unsigned STACK_FENCEPOST = 0xdeadbeef;
 /// `Thread::Fork`.
 ///
 /// * `threadName` is an arbitrary string, useful for debugging.
-Thread::Thread(const char* threadName, bool join, int prio)
+/// * `stackWords` is the size of the stack the thread will run on, in
+///   words.
+Thread::Thread(const char* threadName, bool join, int prio,
+               unsigned stackWords)
 {
     DEBUG('t', "Creating thread \"%s\"\n", threadName);
     name     = threadName;
     stackTop = NULL;
     stack    = NULL;
+    stackSize = stackWords;
     status   = JUST_CREATED;
     priority = prio;
     effectivePriority = prio;
+    heldLocks = NULL;
+    waitingOn = NULL;
+    alarmSlot = 0;
+    timedQueue = NULL;
+    timedOut = false;
+    readyPrio = -1;
+    cpu = currentCpu != NULL ? currentCpu->GetId() : 0;
+    quantumLeft = 0;
+    quantumCharged = stats != NULL ? stats->totalTicks : 0;
+    mlfqLevel = 0;
+    boostEpoch = 0;
+    weight = FAIR_DEFAULT_WEIGHT;
+    vruntime = 0;
+    vruntimeLent = 0;
+    heapIndex = -1;
+    shareRecord = scheduler != NULL ? scheduler->AddShareRecord(this) : -1;
+    usageRecord = accounting != NULL ? accounting->AddRecord(threadName) : -1;
+    traceId = tracer != NULL ? tracer->AddThread(threadName) : -1;
 
 #ifdef USER_PROGRAM
     space    = NULL;
+    userStackSlot = -1;
 #endif
 
     int i;
     for (i=0 ; i < MAX_OPEN_FILES; i++)
         openFilesTable[i]=NULL;    
 
-    if (join)
-        port = new Port("JoinPort");
-    else
-        port = NULL;
+    // The creator of a joinable thread is its parent.
+    children = NULL;
+    if (join) {
+        completion = new Completion(threadName);
+        currentThread->GetChildren()->Add(completion);
+    } else
+        completion = NULL;
     
     number_running_threads++;
 }
@@ -70,16 +96,21 @@ Thread::~Thread()
 {
     DEBUG('t', "Deleting thread \"%s\"\n", name);
     ASSERT(this != currentThread);
-    if(port != NULL)
-        delete port;
+    ASSERT(!queueHook.IsLinked());  // Must not be left on a queue.
+    if (completion != NULL)  // Never ran.
+        currentThread->GetChildren()->Discard(completion);
+    delete children;
+    if (shareRecord >= 0)
+        scheduler->ReleaseShareRecord(shareRecord);
         
     #ifdef USER_PROGRAM
-        delete space;
+        // Only a thread that never ran still has its space here.
+        ReleaseSpace();
     #endif
 
     ASSERT(this != currentThread);
     if (stack != NULL)
-        DeallocBoundedArray((char *) stack, STACK_SIZE * sizeof *stack);
+        stackPool->Put(stack, stackSize);
     
     number_running_threads--;
 }
@@ -138,6 +169,12 @@ Thread::CheckOverflow()
         ASSERT(*stack == STACK_FENCEPOST);
     }
 }
+
+bool
+Thread::InStackGuard(const void *addr)
+{
+    return stack != NULL && StackPool::InGuard(addr, stack);
+}
 /// Ver bien como es lo de self
 
 void 
@@ -162,31 +199,75 @@ Thread::ResetPriority(){
 ///
 /// NOTE: we disable interrupts, so that we do not get a time slice between
 /// setting `threadToBeDestroyed`, and going to sleep.
+///
+/// A joinable thread leaves its exit status in its completion, for the
+/// parent to pick up whenever it likes: finishing never waits for it.
+///
+/// A user thread lets go of its address space first, while it can still
+/// block: the last one out writes mapped files back and removes the swap
+/// files, which waits on the disk, and maybe on file system locks held by
+/// the very thread that would otherwise run the destructor.  So whoever
+/// joins it finds the files written.
+///
+/// * `st` is the exit status.
 void
 Thread::Finish(int st)
 {
-    
-    
+#ifdef USER_PROGRAM
+    if (space != NULL) {
+        // Charged now, while the time still goes to the process too.
+        IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+        if (accounting != NULL)
+            accounting->ChargeTicks(this);
+        interrupt->SetLevel(oldLevel);
+        ReleaseSpace();
+    }
+#endif
+
     interrupt->SetLevel(INT_OFF);
     ASSERT(this == currentThread);
 
     DEBUG('t', "Finishing thread \"%s\"\n", getName());
 
-    if (port)
-        port->Send(st);
+    if (completion != NULL) {
+        completion->Complete(st);
+        completion = NULL;
+    }
 
+    // A thread that finished right before us and switched to a thread that
+    // was just starting (and so did not return into `Scheduler::Run`) has
+    // not been destroyed yet.  The global is cleared before deleting it, in
+    // case the destructor lets another thread run and finish.
+    while (threadToBeDestroyed != NULL) {
+        Thread *carcass = threadToBeDestroyed;
+        threadToBeDestroyed = NULL;
+        delete carcass;
+    }
     threadToBeDestroyed = currentThread;
     Sleep();  // Invokes `SWITCH`.
     // Not reached.
 }
 
+/// The running thread is charged the CPU time it used at its old weight
+/// first, so that the new one only counts from now on.
+void
+Thread::SetWeight(unsigned w)
+{
+    ASSERT(w > 0);
 
-void Thread::Join(){
-    ASSERT (port);
-    DEBUG('t', "Joining thread \"%s\"\n", name);
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    if (this == currentThread)
+        scheduler->Charge(this);
+    weight = w;
+    interrupt->SetLevel(oldLevel);
+}
 
-    int temp;
-    port->Receive(&temp);
+CompletionGroup *
+Thread::GetChildren()
+{
+    if (children == NULL)
+        children = new CompletionGroup();
+    return children;
 }
 
 /// Relinquish the CPU if any other thread is ready to run.
@@ -231,7 +312,8 @@ Thread::Yield()
 /// NOTE: if there are no threads on the ready queue, that means we have no
 /// thread to run.  `Interrupt::Idle` is called to signify that we should
 /// idle the CPU until the next I/O interrupt occurs (the only thing that
-/// could cause a thread to become ready to run).
+/// could cause a thread to become ready to run).  Under SMP, the other
+/// CPUs go on with their turns meanwhile (see `Scheduler::SwitchCpu`).
 ///
 /// NOTE: we assume interrupts are already disabled, because it is called
 /// from the synchronization routines which must disable interrupts for
@@ -248,7 +330,13 @@ Thread::Sleep()
     DEBUG('t', "Sleeping thread \"%s\"\n", getName());
 
     status = BLOCKED;
+    tracer->RecordThread(TRACE_THREAD_STOP, this);
+    if (numCpus > 1) {
+        scheduler->SwitchCpu();  // Returns when we have been signalled.
+        return;
+    }
     while ((nextThread = scheduler->FindNextToRun()) == NULL) {
+        ProgramTimer();     // Only for sleeping threads, if any.
         interrupt->Idle();  // No one to run, wait for an interrupt.
     }
 
@@ -275,6 +363,7 @@ InterruptEnable()
 
 /// Allocate and initialize an execution stack.
 ///
+/// The stack comes from `stackPool`, with a guard page below it.
 /// The stack is initialized with an initial stack frame for `ThreadRoot`,
 /// which:
 /// 1. enables interrupts;
@@ -286,11 +375,10 @@ InterruptEnable()
 void
 Thread::StackAllocate(VoidFunctionPtr func, void *arg)
 {
-    stack = (HostMemoryAddress *) AllocBoundedArray(STACK_SIZE
-                                                    * sizeof *stack);
+    stack = stackPool->Get(stackSize);
 
     // i386 & MIPS & SPARC stack works from high addresses to low addresses.
-    stackTop = stack + STACK_SIZE - 4;  // -4 to be on the safe side!
+    stackTop = stack + stackSize - 4;  // -4 to be on the safe side!
 
     // the 80386 passes the return address on the stack.  In order for
     // `SWITCH` to go to `ThreadRoot` when we switch to this thread, the
@@ -315,11 +403,15 @@ Thread::StackAllocate(VoidFunctionPtr func, void *arg)
 /// Note that a user program thread has *two* sets of CPU registers -- one
 /// for its state while executing user code, one for its state while
 /// executing kernel code.  This routine saves the former.
+///
+/// A thread switched out inside the atomic sequence of its space will
+/// start it over.
 void
 Thread::SaveUserState()
 {
     for (unsigned i = 0; i < NUM_TOTAL_REGS; i++)
         userRegisters[i] = machine->ReadRegister(i);
+    space->RestartAtomic(userRegisters);
 }
 
 /// Restore the CPU state of a user program on a context switch.
@@ -334,6 +426,22 @@ Thread::RestoreUserState()
         machine->WriteRegister(i, userRegisters[i]);
 }
 
+/// Give back the user stack and the space, deleting it if this was its last
+/// thread.
+void
+Thread::ReleaseSpace()
+{
+    if (space == NULL)
+        return;
+    if (userStackSlot >= 0)
+        space->FreeStack(userStackSlot);
+    AddressSpace *oldSpace = space;
+    space = NULL;
+    userStackSlot = -1;
+    if (oldSpace->Detach())
+        delete oldSpace;
+}
+
 
 int Thread::AddFile(OpenFile *f) {    // Los índices 0 y 1 están ya reservados para stdin stdout, que siempre están abiertos
     int i;
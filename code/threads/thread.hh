@@ -22,7 +22,9 @@
 /// small.)
 ///
 /// One thing to try if you find yourself with segmentation faults is to
-/// increase the size of thread stack -- `STACK_SIZE`.
+/// increase the size of thread stack -- `STACK_SIZE`, or the one given to
+/// the `Thread` constructor.  Overflows past the guard page below every
+/// stack are reported as soon as they happen (see `StackPool`).
 ///
 /// In this interface, forking a thread takes two steps.  We must first
 /// allocate a data structure for it:
@@ -40,6 +42,7 @@
 
 
 #include "utility.hh"
+#include "intrusive_list.hh"
 #include "filesys/open_file.hh" // INCLUDE AGREGADO 
 
 #ifdef USER_PROGRAM 
@@ -55,7 +58,8 @@
 /// registers.  We allocate room for the maximum of these two architectures.
 const unsigned MACHINE_STATE_SIZE = 17;
 
-/// Size of the thread's private execution stack.
+/// Default size of a thread's private execution stack.  A thread can ask
+/// for another one when it is created.
 ///
 /// In words.
 /// 
@@ -80,7 +84,9 @@ enum ThreadStatus {
 ///  Some threads also belong to a user address space; threads that only run
 ///  in the kernel have a `NULL` address space.
 
-class Port;
+class Completion;
+class CompletionGroup;
+class Lock;
 
 class Thread {
 private:
@@ -97,7 +103,8 @@ private:
 public:
 
     /// Initialize a `Thread`.
-   Thread(const char *debugName, bool join=0, int prio=0); /// join indica si el thread hará join
+   Thread(const char *debugName, bool join=0, int prio=0,
+          unsigned stackWords=STACK_SIZE); /// join indica si el thread hará join
 
     /// Deallocate a Thread.
     ///
@@ -123,6 +130,9 @@ public:
     /// Check if thread has overflowed its stack.
     void CheckOverflow();
 
+    /// Whether `addr` is in the guard page below the thread's stack.
+    bool InStackGuard(const void *addr);
+
     void ChangePriority(int newPriority);
     void ResetPriority();
 
@@ -145,8 +155,17 @@ public:
         printf("%s, ", name);
     }
 
-    void Join();
-    
+    /// End of the thread, for its parent to wait for; `NULL` if the
+    /// thread is not joinable.  Valid until the parent reaps it, even after
+    /// the thread itself is gone.
+    Completion *GetCompletion()
+    {
+        return completion;
+    }
+
+    /// Joinable threads created by this one.
+    CompletionGroup *GetChildren();
+
     int GetPriority(){
         return priority;
     }
@@ -155,9 +174,27 @@ public:
     int GetEffectivePriority(){
         return effectivePriority;
     }
+
+    /// Weight of the thread under the fair share policy: its CPU share is
+    /// proportional to it.
+    unsigned GetWeight()
+    {
+        return weight;
+    }
+
+    void SetWeight(unsigned w);
+
     int  AddFile(OpenFile *f);
     void CloseFile(int fd);
     OpenFile* GetFile(int fd);
+
+    /// Links for the one queue a thread can be waiting on: a ready queue of
+    /// the `Scheduler`, or the queue of a `Semaphore`, `Lock` or
+    /// `Condition`.
+    ListHook<Thread> queueHook;
+
+    /// Links for the slot of the `Alarm` wheel the thread sleeps on.
+    ListHook<Thread> alarmHook;
     
 
  
@@ -172,6 +209,9 @@ private:
     /// stack.)
     HostMemoryAddress *stack;
 
+    /// Size of the stack, in words.
+    unsigned stackSize;
+
     /// Ready, running or blocked.
     ThreadStatus status;
 
@@ -180,10 +220,56 @@ private:
     /// Allocate a stack for thread.  Used internally by `Fork`.
     void StackAllocate(VoidFunctionPtr func, void *arg);
 
-    Port *port; ///Será usado para implementar join
+    Completion *completion;  /// Será usado para implementar join
+    CompletionGroup *children;  ///< Created on demand.
     int priority;
     int effectivePriority;
 
+    /// Locks held, linked through `Lock::nextHeld`, and lock waited for,
+    /// for priority inheritance (see `Lock`).
+    friend class Lock;
+    Lock *heldLocks;
+    Lock *waitingOn;
+
+    /// Alarm: slot the thread is due at, queue to take it off when it times
+    /// out, and whether it did.
+    friend class Alarm;
+    unsigned long alarmSlot;
+    IntrusiveList<Thread, &Thread::queueHook> *timedQueue;
+    bool timedOut;
+
+    /// Ready queue the thread is on (see `Scheduler`), -1 if it is not
+    /// ready; and CPU it last ran on, whose queues it goes on.
+    friend class Scheduler;
+    int readyPrio;
+    unsigned cpu;
+
+    /// Scheduler accounting: ticks left in the current quantum, and the
+    /// time up to which they have been charged; MLFQ level (0 is the
+    /// highest) and last priority boost seen.
+    int quantumLeft;
+    unsigned quantumCharged;
+    int mlfqLevel;
+    unsigned boostEpoch;
+
+    /// Fair share accounting: weight, CPU time used scaled by the weight,
+    /// how much of it was forgiven by lending while holding a lock (to be
+    /// paid back), position in the scheduler's heap (-1 if not there) and
+    /// CPU time record.
+    unsigned weight;
+    unsigned long long vruntime;
+    unsigned long long vruntimeLent;
+    int heapIndex;
+    int shareRecord;
+
+    /// Record of the resources used (see `Accounting`), -1 if none.
+    friend class Accounting;
+    int usageRecord;
+
+    /// Number in the event trace (see `Tracer`), -1 if not tracing.
+    friend class Tracer;
+    int traceId;
+
     OpenFile *openFilesTable[MAX_OPEN_FILES];
 
 
@@ -206,6 +292,15 @@ public:
 
     // User code this thread is running.
     AddressSpace *space;
+
+    /// Slot of `space` this thread's user stack is on, if it was created
+    /// with the `Fork` system call; -1 for the main stack.
+    int userStackSlot;
+
+private:
+
+    // Let go of `space` and `userStackSlot`.
+    void ReleaseSpace();
 #endif
 };
 
@@ -13,7 +13,12 @@
 
 #include "system.hh"
 #include "synch.hh"
+#include "scheduler.hh"
+#include "synch_list.hh"
+#include "channel.hh"
 #include <utility>
+#include <sys/time.h>
+#include <limits.h>
 using namespace std;
 
 void
@@ -109,11 +114,1088 @@ void InversionPrioridadesTest ()
 	currentThread ->Yield();
 }
 
+////////////////////////////////////////////////////////////////////
+
+/// Scheduler stress benchmark.
+///
+/// Fork `SCHED_THREADS` threads spread over every priority, move each one
+/// between ready queues `SCHED_MOVES` times while they wait, and then let
+/// them run, every one yielding `SCHED_YIELDS` times before it finishes.
+/// With constant time queues the cost per operation does not grow with the
+/// number of ready threads.
+
+static const int SCHED_THREADS = 2000;
+static const int SCHED_MOVES   = 10;
+static const int SCHED_YIELDS  = 20;
+
+static Semaphore *schedDone;
+static int schedLeft;
+
+static void
+SchedThread(void *)
+{
+    for (int i = 0; i < SCHED_YIELDS; i++)
+        currentThread->Yield();
+    if (--schedLeft == 0)
+        schedDone->V();
+}
+
+static long
+Usecs(const struct timeval *start)
+{
+    struct timeval end;
+
+    gettimeofday(&end, NULL);
+    return (end.tv_sec - start->tv_sec) * 1000000L
+           + (end.tv_usec - start->tv_usec);
+}
+
+void
+SchedulerBenchmark()
+{
+    Thread **threads = new Thread *[SCHED_THREADS];
+    char **names = new char *[SCHED_THREADS];
+    struct timeval start;
+
+    schedDone = new Semaphore("schedDone", 0);
+    schedLeft = SCHED_THREADS;
+
+    // With interrupts off nobody runs until the main thread blocks, so
+    // every thread is still ready while their priorities are changed.
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    gettimeofday(&start, NULL);
+    for (int i = 0; i < SCHED_THREADS; i++) {
+        names[i] = new char [16];
+        sprintf(names[i], "sched %d", i);
+        threads[i] = new Thread(names[i], false, i % (MAX_PRIO + 1));
+        threads[i]->Fork(SchedThread, NULL);
+    }
+    long forkUsecs = Usecs(&start);
+
+    gettimeofday(&start, NULL);
+    for (int round = 0; round < SCHED_MOVES; round++)
+        for (int i = 0; i < SCHED_THREADS; i++) {
+            Thread *t = threads[i];
+            t->ChangePriority((t->GetPriority() + round + 1) % (MAX_PRIO + 1));
+            scheduler->ChangePriorityList(t, t->GetEffectivePriority());
+            t->ResetPriority();
+            scheduler->ChangePriorityList(t, t->GetPriority());
+        }
+    long moveUsecs = Usecs(&start);
+
+    gettimeofday(&start, NULL);
+    schedDone->P();
+    interrupt->SetLevel(oldLevel);
+    long runUsecs = Usecs(&start);
+
+    printf("Scheduler benchmark, %d threads:\n"
+           "    fork: %ld us, %d priority changes: %ld us, "
+           "%d yields: %ld us\n",
+           SCHED_THREADS, forkUsecs, 2 * SCHED_MOVES * SCHED_THREADS,
+           moveUsecs, SCHED_YIELDS * SCHED_THREADS, runUsecs);
+
+    // The last threads may not have been destroyed yet.
+    currentThread->Yield();
+    for (int i = 0; i < SCHED_THREADS; i++)
+        delete [] names[i];
+    delete [] names;
+    delete [] threads;
+    delete schedDone;
+}
+
+////////////////////////////////////////////////////////////////////
+
+/// Check that scheduling and synchronization reach a steady state without
+/// heap allocations.
+///
+/// Two threads pass a token back and forth through a `SynchList` and a pair
+/// of semaphores, yielding in between.  After a warm-up round, the pools
+/// behind list nodes and pending interrupts must not grow any more.
+
+static const int PING_ROUNDS = 1000;
+
+static SynchList<int> *pingBox;
+static Semaphore *pingSem, *pongSem;
+
+static void
+Pong(void *)
+{
+    for (int i = 0; i < PING_ROUNDS; i++) {
+        pingSem->P();
+        ASSERT(pingBox->Remove() == i);
+        currentThread->Yield();
+        pongSem->V();
+    }
+}
+
+static unsigned
+PoolBlocks()
+{
+    return Pool< ListElement<int> >::Allocated()
+           + Pool<PendingInterrupt>::Allocated();
+}
+
+void
+PoolTest()
+{
+    unsigned warm = 0;
+
+    pingBox = new SynchList<int>;
+    pingSem = new Semaphore("ping", 0);
+    pongSem = new Semaphore("pong", 0);
+    Thread *pong = new Thread("pong");
+    pong->Fork(Pong, NULL);
+
+    for (int i = 0; i < PING_ROUNDS; i++) {
+        if (i == PING_ROUNDS / 10)
+            warm = PoolBlocks();
+        pingBox->Append(i);
+        pingSem->V();
+        currentThread->Yield();
+        pongSem->P();
+    }
+    ASSERT(PoolBlocks() == warm);
+    printf("Pool test: %d rounds, %u pooled blocks, no allocation after "
+           "warm-up\n", PING_ROUNDS, warm);
+
+    delete pingBox;
+    delete pingSem;
+    delete pongSem;
+}
+
+////////////////////////////////////////////////////////////////////
+
+/// Condition variable test.
+///
+/// A producer sends `COND_MESSAGES` values through a `Port` and then through
+/// a `SynchList`, both built on `Lock` and `Condition`; the consumer checks
+/// that they arrive in order.  Reports the context switches per message.
+
+static const int COND_MESSAGES = 1000;
+
+static Port *condPort;
+static SynchList<int> *condList;
+static Semaphore *condDone;
+
+static void
+CondConsumer(void *)
+{
+    int value;
+
+    for (int i = 0; i < COND_MESSAGES; i++) {
+        condPort->Receive(&value);
+        ASSERT(value == i);
+    }
+    for (int i = 0; i < COND_MESSAGES; i++)
+        ASSERT(condList->Remove() == i);
+    condDone->V();
+}
+
+void
+ConditionTest()
+{
+    condPort = new Port("condPort");
+    condList = new SynchList<int>;
+    condDone = new Semaphore("condDone", 0);
+    Thread *consumer = new Thread("consumer");
+    consumer->Fork(CondConsumer, NULL);
+
+    unsigned switches = stats->numContextSwitches;
+    for (int i = 0; i < COND_MESSAGES; i++)
+        condPort->Send(i);
+    unsigned portSwitches = stats->numContextSwitches - switches;
+
+    switches = stats->numContextSwitches;
+    for (int i = 0; i < COND_MESSAGES; i++) {
+        condList->Append(i);
+        currentThread->Yield();
+    }
+    condDone->P();
+    unsigned listSwitches = stats->numContextSwitches - switches;
+
+    printf("Condition test: %d messages, context switches per message: "
+           "port %.2f, synch list %.2f\n", COND_MESSAGES,
+           (double) portSwitches / COND_MESSAGES,
+           (double) listSwitches / COND_MESSAGES);
+
+    delete condPort;
+    delete condList;
+    delete condDone;
+}
+
+////////////////////////////////////////////////////////////////////
+
+/// Interactive latency test.
+///
+/// `LATENCY_HOGS` CPU bound threads compete with one that repeatedly waits
+/// for a simulated device and then does a little work.  Measures how many
+/// ticks pass between the device interrupt and the thread running again.
+/// Run it with and without `-mlfq` to compare the policies.
+
+static const int LATENCY_HOGS   = 4;
+static const int LATENCY_ROUNDS = 50;
+static const int LATENCY_DELAY  = 500;
+
+static Semaphore *ioDone, *latencyDone;
+static unsigned ioDoneAt;
+static unsigned long latencySum, latencyMax;
+static bool hogsStop;
+
+/// Name of the scheduling policy in use, for the test reports.
+static const char *
+PolicyName()
+{
+    switch (scheduler->GetPolicy()) {
+        case MLFQ_SCHED:
+            return "mlfq";
+        case FAIR_SCHED:
+            return "fair";
+        default:
+            return "priority";
+    }
+}
+
+static void
+IoComplete(void *)
+{
+    ioDoneAt = stats->totalTicks;
+    ioDone->V();
+}
+
+/// Advance simulated time, as a running thread would.
+static void
+Burn(int ticks)
+{
+    for (int i = 0; i < ticks; i += SYSTEM_TICK) {
+        interrupt->SetLevel(INT_OFF);
+        interrupt->SetLevel(INT_ON);
+    }
+}
+
+static void
+Hog(void *)
+{
+    while (!hogsStop)
+        Burn(SYSTEM_TICK);
+}
+
+static void
+Interactive(void *)
+{
+    for (int i = 0; i < LATENCY_ROUNDS; i++) {
+        interrupt->Schedule(IoComplete, NULL, LATENCY_DELAY, CONSOLE_READ_INT);
+        ioDone->P();
+        unsigned long latency = stats->totalTicks - ioDoneAt;
+        latencySum += latency;
+        if (latency > latencyMax)
+            latencyMax = latency;
+        Burn(100);
+    }
+    hogsStop = true;
+    latencyDone->V();
+}
+
+void
+LatencyTest()
+{
+    ioDone = new Semaphore("ioDone", 0);
+    latencyDone = new Semaphore("latencyDone", 0);
+    for (int i = 0; i < LATENCY_HOGS; i++)
+        (new Thread("hog"))->Fork(Hog, NULL);
+    (new Thread("interactive"))->Fork(Interactive, NULL);
+
+    latencyDone->P();
+    printf("Latency test (%s): %d rounds, ticks from interrupt to running: "
+           "average %lu, max %lu\n",
+           PolicyName(),
+           LATENCY_ROUNDS, latencySum / LATENCY_ROUNDS, latencyMax);
+}
+
+////////////////////////////////////////////////////////////////////
+
+/// Fair share test.
+///
+/// `FAIR_HOGS` CPU bound threads of weights 1, 2, 4... times the default
+/// spin for `FAIR_RUN` ticks, counting the work each one gets done.  Under
+/// `-fair` the counts follow the weights; under the other policies they
+/// are about the same.
+
+static const int FAIR_HOGS = 3;
+static const int FAIR_RUN  = 200000;
+
+static Semaphore *fairDone;
+static bool fairStop;
+static unsigned long fairWork[FAIR_HOGS];
+
+static void
+FairStop(void *)
+{
+    fairStop = true;
+}
+
+static void
+FairHog(void *arg)
+{
+    unsigned long *work = (unsigned long *) arg;
+    while (!fairStop) {
+        Burn(SYSTEM_TICK);
+        (*work)++;
+    }
+    fairDone->V();
+}
+
 void
-ThreadTest()
+FairShareTest()
+{
+    fairDone = new Semaphore("fairDone", 0);
+    for (int i = 0; i < FAIR_HOGS; i++) {
+        Thread *t = new Thread("fair hog");
+        t->SetWeight(FAIR_DEFAULT_WEIGHT << i);
+        t->Fork(FairHog, &fairWork[i]);
+    }
+    interrupt->Schedule(FairStop, NULL, FAIR_RUN, CONSOLE_READ_INT);
+    for (int i = 0; i < FAIR_HOGS; i++)
+        fairDone->P();
+
+    unsigned long total = 0;
+    for (int i = 0; i < FAIR_HOGS; i++)
+        total += fairWork[i];
+    printf("Fair share test (%s): shares of weights 1:2:4:", PolicyName());
+    for (int i = 0; i < FAIR_HOGS; i++)
+        printf(" %.1f%%", 100.0 * fairWork[i] / total);
+    printf("\n");
+    delete fairDone;
+}
+
+////////////////////////////////////////////////////////////////////
+
+/// Host preemption test.
+///
+/// `PREEMPT_THREADS` threads spin through `PREEMPT_SPINS` iterations of
+/// plain C++, never enabling or disabling interrupts, so simulated time
+/// stands still and only host preemption (`-p` or `-pt`) can switch among
+/// them.  Counts how many times the spinning thread changed, and how long
+/// it all took on the host.
+
+static const int PREEMPT_THREADS = 4;
+static const unsigned long PREEMPT_SPINS = 50000000;
+
+static Semaphore *preemptDone;
+static volatile int preemptLast;
+static volatile unsigned long preemptChanges;
+
+static void
+Spinner(void *arg)
 {
-    //LockTest();
-    InversionPrioridadesTest();  
+    int me = *(int *) arg;
+    for (unsigned long i = 0; i < PREEMPT_SPINS; i++)
+        if (preemptLast != me) {
+            preemptLast = me;
+            preemptChanges++;
+        }
+    preemptDone->V();
+}
 
+void
+PreemptionTest()
+{
+    static int ids[PREEMPT_THREADS];
+    struct timeval start, end;
+
+    preemptDone = new Semaphore("preemptDone", 0);
+    preemptLast = -1;
+    gettimeofday(&start, NULL);
+    for (int i = 0; i < PREEMPT_THREADS; i++) {
+        ids[i] = i;
+        (new Thread("spinner"))->Fork(Spinner, &ids[i]);
+    }
+    for (int i = 0; i < PREEMPT_THREADS; i++)
+        preemptDone->P();
+    gettimeofday(&end, NULL);
+
+    long ms = (end.tv_sec - start.tv_sec) * 1000
+              + (end.tv_usec - start.tv_usec) / 1000;
+    printf("Preemption test: %d threads, %lu switches while spinning, "
+           "%ld ms\n", PREEMPT_THREADS, preemptChanges - PREEMPT_THREADS,
+           ms);
+    delete preemptDone;
+}
+
+////////////////////////////////////////////////////////////////////
+
+/// Thread creation benchmark.
+///
+/// Create `CREATE_THREADS` threads one after the other, letting each one
+/// run and be destroyed before the next, first with stacks recycled by
+/// `stackPool` and then with recycling off.
+
+static const int CREATE_THREADS = 20000;
+
+static void
+Nothing(void *)
+{
+}
+
+/// Time the creation of `CREATE_THREADS` threads, in nanoseconds per
+/// thread.
+static long
+TimeCreation()
+{
+    struct timeval start, end;
+
+    gettimeofday(&start, NULL);
+    for (int i = 0; i < CREATE_THREADS; i++) {
+        (new Thread("short lived"))->Fork(Nothing, NULL);
+        currentThread->Yield();
+    }
+    currentThread->Yield();  // Let the last one be destroyed.
+    gettimeofday(&end, NULL);
+
+    long us = (end.tv_sec - start.tv_sec) * 1000000
+              + (end.tv_usec - start.tv_usec);
+    return us * 1000 / CREATE_THREADS;
+}
+
+void
+CreationBenchmark()
+{
+    unsigned long mapped = stackPool->Mapped();
+    long pooled = TimeCreation();
+    unsigned long pooledMaps = stackPool->Mapped() - mapped;
+
+    stackPool->SetMaxFree(0);
+    mapped = stackPool->Mapped();
+    long unpooled = TimeCreation();
+    unsigned long unpooledMaps = stackPool->Mapped() - mapped;
+    stackPool->SetMaxFree(STACK_POOL_MAX_FREE);
+
+    printf("Creation benchmark, %d threads: recycled stacks %ld ns/thread "
+           "(%lu mapped), fresh stacks %ld ns/thread (%lu mapped)\n",
+           CREATE_THREADS, pooled, pooledMaps, unpooled, unpooledMaps);
+}
+
+////////////////////////////////////////////////////////////////////
+
+/// Stack overflow test.
+///
+/// A thread with a small stack recurses without end.  It must be stopped
+/// by its guard page, with a message naming it, rather than run over
+/// whatever lies below its stack.
+
+static int
+Recurse(int depth)
+{
+    volatile char frame[256];
+    frame[0] = depth;
+    if (depth == INT_MAX)  // Never: the stack runs out long before.
+        return 0;
+    return Recurse(depth + 1) + frame[0];
+}
+
+static void
+Overflow(void *)
+{
+    Recurse(0);
+}
+
+void
+OverflowTest()
+{
+    (new Thread("overflow", false, 0, 1024))->Fork(Overflow, NULL);
+    currentThread->Yield();
+    printf("Overflow test: the thread came back FAILED\n");
 }
 
+////////////////////////////////////////////////////////////////////
+
+/// Join test.
+///
+/// `JOIN_CHILDREN` joinable threads exit with their number as status.  All
+/// of them must be able to finish, and be destroyed, before their parent
+/// joins any; then the parent reaps half of them one by one and the rest
+/// with `WaitAny`.
+
+static const int JOIN_CHILDREN = 1000;
+
+extern unsigned number_running_threads;
+
+static void
+ExitWith(void *status)
+{
+    currentThread->Finish((int) (HostMemoryAddress) status);
+}
+
+void
+JoinTest()
+{
+    Completion **completions = new Completion *[JOIN_CHILDREN];
+    for (int i = 0; i < JOIN_CHILDREN; i++) {
+        Thread *t = new Thread("child", true);
+        completions[i] = t->GetCompletion();
+        t->Fork(ExitWith, (void *) (HostMemoryAddress) i);
+    }
+    while (number_running_threads > 1)
+        currentThread->Yield();
+
+    CompletionGroup *children = currentThread->GetChildren();
+    bool ok = true;
+    for (int i = 0; i < JOIN_CHILDREN; i += 2)
+        ok = ok && children->Wait(completions[i]) == i;
+    int id, status, reaped = 0;
+    long sum = 0;
+    while (children->WaitAny(&id, &status)) {
+        ok = ok && status % 2 == 1;
+        sum += status;
+        reaped++;
+    }
+    ok = ok && reaped == JOIN_CHILDREN / 2
+         && sum == (long) JOIN_CHILDREN * JOIN_CHILDREN / 4;
+
+    printf("Join test: %d children finished before being joined, "
+           "statuses %s\n", JOIN_CHILDREN, ok ? "PASSED" : "FAILED");
+    delete [] completions;
+}
+
+////////////////////////////////////////////////////////////////////
+
+/// Nested priority inversion.
+///
+/// `Low` (priority 1) holds locks A and C; `Mid` (3) holds B and waits for
+/// A; `High` (5) waits for B, and `Other` (2) waits for C.  `Low` must run
+/// at priority 5 through `Mid`, drop to 2 when it releases A (C is still
+/// wanted by `Other`) and to 1 when it releases C; `Mid` must keep 5 until
+/// it releases B.
+
+static Lock *nestedA, *nestedB, *nestedC;
+static Semaphore *nestedReady, *nestedGo, *nestedDone;
+static int lowAfterA, lowAfterC, midAfterA, midAfterB;
+
+static void
+NestedLow(void *)
+{
+    nestedC->Acquire();
+    nestedA->Acquire();
+    nestedReady->V();
+    nestedGo->P();
+    nestedA->Release();
+    lowAfterA = currentThread->GetEffectivePriority();
+    nestedC->Release();
+    lowAfterC = currentThread->GetEffectivePriority();
+    nestedDone->V();
+}
+
+static void
+NestedMid(void *)
+{
+    nestedB->Acquire();
+    nestedA->Acquire();
+    nestedA->Release();
+    midAfterA = currentThread->GetEffectivePriority();
+    nestedB->Release();
+    midAfterB = currentThread->GetEffectivePriority();
+    nestedDone->V();
+}
+
+static void
+NestedWaiter(void *arg)
+{
+    Lock *wanted = (Lock *) arg;
+    wanted->Acquire();
+    wanted->Release();
+    nestedDone->V();
+}
+
+void
+NestedInversionTest()
+{
+    nestedA = new Lock("A");
+    nestedB = new Lock("B");
+    nestedC = new Lock("C");
+    nestedReady = new Semaphore("nestedReady", 0);
+    nestedGo = new Semaphore("nestedGo", 0);
+    nestedDone = new Semaphore("nestedDone", 0);
+
+    Thread *low = new Thread("Low", false, 1);
+    low->Fork(NestedLow, NULL);
+    nestedReady->P();
+
+    // Each thread runs, being above us, until it blocks on its lock.
+    Thread *mid = new Thread("Mid", false, 3);
+    mid->Fork(NestedMid, NULL);
+    currentThread->Yield();
+    (new Thread("High", false, 5))->Fork(NestedWaiter, nestedB);
+    currentThread->Yield();
+    (new Thread("Other", false, 2))->Fork(NestedWaiter, nestedC);
+    currentThread->Yield();
+
+    int lowInherited = low->GetEffectivePriority();
+    int midInherited = mid->GetEffectivePriority();
+    nestedGo->V();
+    for (int i = 0; i < 4; i++)
+        nestedDone->P();
+
+    bool ok = lowInherited == 5 && midInherited == 5 && lowAfterA == 2
+              && lowAfterC == 1 && midAfterA == 5 && midAfterB == 3;
+    printf("Nested inversion test: Low ran at %d, then %d and %d; "
+           "Mid ran at %d, then %d and %d: %s\n", lowInherited, lowAfterA,
+           lowAfterC, midInherited, midAfterA, midAfterB,
+           ok ? "PASSED" : "FAILED");
+
+    delete nestedA;
+    delete nestedB;
+    delete nestedC;
+    delete nestedReady;
+    delete nestedGo;
+    delete nestedDone;
+}
+
+////////////////////////////////////////////////////////////////////
+
+/// Channel throughput benchmark.
+///
+/// `PIPE_PRODUCERS` producers send `PIPE_MESSAGES` values each to a stage
+/// that doubles them and passes them on to `PIPE_CONSUMERS` consumers, once
+/// through a pair of `Port`s and once through a pair of `Channel`s, which
+/// the stage and the consumers drain `PIPE_BATCH` values at a time.
+/// Reports the context switches per message and the time taken, and checks
+/// that every value arrives and that `TrySend` and `TryReceive` never block.
+
+static const int PIPE_PRODUCERS = 2;
+static const int PIPE_CONSUMERS = 2;
+static const int PIPE_MESSAGES  = 5000;
+static const int PIPE_TOTAL     = PIPE_PRODUCERS * PIPE_MESSAGES;
+static const unsigned PIPE_CAPACITY = 32;
+static const unsigned PIPE_BATCH    = 8;
+
+static Port *portIn, *portOut;
+static Channel<int> *chanIn, *chanOut;
+static Semaphore *pipeDone;
+static long pipeSum;
+
+static void
+PortProducer(void *)
+{
+    for (int i = 0; i < PIPE_MESSAGES; i++)
+        portIn->Send(i);
+    pipeDone->V();
+}
+
+static void
+PortStage(void *)
+{
+    int value;
+
+    for (int i = 0; i < PIPE_TOTAL; i++) {
+        portIn->Receive(&value);
+        portOut->Send(2 * value);
+    }
+    pipeDone->V();
+}
+
+static void
+PortConsumer(void *)
+{
+    int value;
+
+    for (int i = 0; i < PIPE_TOTAL / PIPE_CONSUMERS; i++) {
+        portOut->Receive(&value);
+        pipeSum += value;
+    }
+    pipeDone->V();
+}
+
+static void
+ChannelProducer(void *)
+{
+    for (int i = 0; i < PIPE_MESSAGES; i++)
+        chanIn->Send(i);
+    pipeDone->V();
+}
+
+static void
+ChannelStage(void *)
+{
+    int values[PIPE_BATCH];
+
+    for (int left = PIPE_TOTAL; left > 0; ) {
+        unsigned n = chanIn->ReceiveMany(values, min<unsigned>(PIPE_BATCH,
+                                                               left));
+        for (unsigned i = 0; i < n; i++)
+            chanOut->Send(2 * values[i]);
+        left -= n;
+    }
+    pipeDone->V();
+}
+
+static void
+ChannelConsumer(void *)
+{
+    int values[PIPE_BATCH];
+
+    for (int left = PIPE_TOTAL / PIPE_CONSUMERS; left > 0; ) {
+        unsigned n = chanOut->ReceiveMany(values, min<unsigned>(PIPE_BATCH,
+                                                                left));
+        for (unsigned i = 0; i < n; i++)
+            pipeSum += values[i];
+        left -= n;
+    }
+    pipeDone->V();
+}
+
+/// Run a pipeline made of the given threads; return whether every value
+/// arrived, and the context switches and time taken.
+static bool
+RunPipeline(VoidFunctionPtr producer, VoidFunctionPtr stage,
+            VoidFunctionPtr consumer, unsigned *switches, long *usecs)
+{
+    struct timeval start;
+
+    pipeSum = 0;
+    unsigned startSwitches = stats->numContextSwitches;
+    gettimeofday(&start, NULL);
+    for (int i = 0; i < PIPE_PRODUCERS; i++)
+        (new Thread("producer"))->Fork(producer, NULL);
+    (new Thread("stage"))->Fork(stage, NULL);
+    for (int i = 0; i < PIPE_CONSUMERS; i++)
+        (new Thread("consumer"))->Fork(consumer, NULL);
+    for (int i = 0; i < PIPE_PRODUCERS + 1 + PIPE_CONSUMERS; i++)
+        pipeDone->P();
+    *usecs = Usecs(&start);
+    *switches = stats->numContextSwitches - startSwitches;
+
+    return pipeSum == (long) PIPE_PRODUCERS * PIPE_MESSAGES
+                      * (PIPE_MESSAGES - 1);
+}
+
+void
+ChannelBenchmark()
+{
+    unsigned portSwitches, chanSwitches;
+    long portUsecs, chanUsecs;
+
+    portIn = new Port("portIn");
+    portOut = new Port("portOut");
+    chanIn = new Channel<int>("chanIn", PIPE_CAPACITY);
+    chanOut = new Channel<int>("chanOut", PIPE_CAPACITY);
+    pipeDone = new Semaphore("pipeDone", 0);
+
+    bool ok = RunPipeline(PortProducer, PortStage, PortConsumer,
+                          &portSwitches, &portUsecs);
+    ok = RunPipeline(ChannelProducer, ChannelStage, ChannelConsumer,
+                     &chanSwitches, &chanUsecs) && ok;
+
+    Channel<int> small("small", 2);
+    int value;
+    ok = ok && !small.TryReceive(&value) && small.TrySend(1)
+         && small.TrySend(2) && !small.TrySend(3) && small.TryReceive(&value)
+         && value == 1 && small.Count() == 1;
+    small.TryReceive(&value);
+
+    printf("Channel benchmark, %d messages through a pipeline of %d "
+           "producers, one stage and %d consumers:\n"
+           "    port: %.2f context switches per message, %ld us\n"
+           "    channel of %u: %.2f context switches per message, %ld us\n"
+           "    %s\n", PIPE_TOTAL, PIPE_PRODUCERS, PIPE_CONSUMERS,
+           (double) portSwitches / PIPE_TOTAL, portUsecs, PIPE_CAPACITY,
+           (double) chanSwitches / PIPE_TOTAL, chanUsecs,
+           ok ? "PASSED" : "FAILED");
+
+    // The last threads may not have been destroyed yet.
+    currentThread->Yield();
+    delete portIn;
+    delete portOut;
+    delete chanIn;
+    delete chanOut;
+    delete pipeDone;
+}
+
+////////////////////////////////////////////////////////////////////
+
+/// Alarm clock test.
+///
+/// Threads sleep for times from less than a slot of the wheel to more than
+/// a whole turn; each must wake up no sooner than asked, and soon after.
+/// Then a timed `P` on a semaphore nobody signals must give up in time and
+/// one signalled before the deadline must succeed, and likewise for a
+/// timed `Condition::Wait`.
+
+static const unsigned ALARM_TIMES[] = {
+    50, 100, 250, 1000, 3333, 10000, 30000, 60000
+};
+static const int ALARM_SLEEPERS = sizeof ALARM_TIMES / sizeof *ALARM_TIMES;
+static const unsigned ALARM_SLACK = 4 * ALARM_GRAIN;
+
+static Semaphore *alarmDone;
+static Lock *alarmLock;
+static Condition *alarmCond;
+static bool alarmOk;
+
+static bool
+InTime(unsigned start, unsigned ticks)
+{
+    unsigned elapsed = stats->totalTicks - start;
+    return elapsed >= ticks && elapsed <= ticks + ALARM_SLACK;
+}
+
+static void
+AlarmSleeper(void *arg)
+{
+    unsigned ticks = (unsigned) (HostMemoryAddress) arg;
+    unsigned start = stats->totalTicks;
+    alarmClock->Sleep(ticks);
+    alarmOk = alarmOk && InTime(start, ticks);
+    alarmDone->V();
+}
+
+static void
+AlarmSignaller(void *)
+{
+    alarmClock->Sleep(200);
+    alarmDone->V();
+    alarmClock->Sleep(200);
+    alarmLock->Acquire();
+    alarmCond->Signal();
+    alarmLock->Release();
+}
+
+void
+AlarmTest()
+{
+    alarmDone = new Semaphore("alarmDone", 0);
+    alarmLock = new Lock("alarmLock");
+    alarmCond = new Condition("alarmCond", alarmLock);
+    alarmOk = true;
+
+    unsigned start = stats->totalTicks;
+    for (int i = 0; i < ALARM_SLEEPERS; i++)
+        (new Thread("sleeper"))->Fork(AlarmSleeper,
+                                      (void *) (HostMemoryAddress)
+                                        ALARM_TIMES[i]);
+    for (int i = 0; i < ALARM_SLEEPERS; i++)
+        alarmDone->P();
+    unsigned slept = stats->totalTicks - start;
+
+    Semaphore never("never", 0);
+    start = stats->totalTicks;
+    bool ok = !never.P(500) && InTime(start, 500);
+
+    (new Thread("signaller"))->Fork(AlarmSignaller, NULL);
+    start = stats->totalTicks;
+    ok = ok && alarmDone->P(5000) && InTime(start, 200);
+
+    alarmLock->Acquire();
+    start = stats->totalTicks;
+    ok = ok && alarmCond->Wait(5000) && InTime(start, 200)
+         && alarmLock->isHeldByCurrentThread();
+    start = stats->totalTicks;
+    ok = ok && !alarmCond->Wait(300) && InTime(start, 300)
+         && alarmLock->isHeldByCurrentThread();
+    alarmLock->Release();
+
+    printf("Alarm test: %d sleepers over %u ticks, %s; timed P and Wait: "
+           "%s\n", ALARM_SLEEPERS, slept,
+           alarmOk ? "all on time" : "some late or early",
+           alarmOk && ok ? "PASSED" : "FAILED");
+
+    delete alarmDone;
+    delete alarmCond;
+    delete alarmLock;
+}
+
+////////////////////////////////////////////////////////////////////
+
+/// Dynamic ticks test.
+///
+/// The main thread sleeps for `TICKLESS_SLEEP` ticks with nothing else to
+/// do, and then two threads share the CPU for `TICKLESS_BURN` ticks each.
+/// Reports the timer interrupts and host time of each phase: with `-dt`,
+/// the sleep takes a single interrupt, and sharing the CPU as many as
+/// without it.
+
+static const unsigned TICKLESS_SLEEP = 10000000;
+static const int TICKLESS_BURN = 20000;
+
+static Semaphore *ticklessDone;
+
+static void
+TicklessHog(void *)
+{
+    Burn(TICKLESS_BURN);
+    ticklessDone->V();
+}
+
+void
+TicklessTest()
+{
+    struct timeval start;
+
+    ticklessDone = new Semaphore("ticklessDone", 0);
+
+    unsigned interrupts = timer->GetInterrupts();
+    unsigned ticks = stats->totalTicks;
+    gettimeofday(&start, NULL);
+    alarmClock->Sleep(TICKLESS_SLEEP);
+    long sleepUsecs = Usecs(&start);
+    unsigned sleepInterrupts = timer->GetInterrupts() - interrupts;
+    bool ok = InTime(ticks, TICKLESS_SLEEP);
+
+    interrupts = timer->GetInterrupts();
+    unsigned switches = stats->numContextSwitches;
+    for (int i = 0; i < 2; i++)
+        (new Thread("hog"))->Fork(TicklessHog, NULL);
+    for (int i = 0; i < 2; i++)
+        ticklessDone->P();
+    unsigned burnInterrupts = timer->GetInterrupts() - interrupts;
+    switches = stats->numContextSwitches - switches;
+    ok = ok && switches > 2;
+
+    printf("Tickless test (%s ticks):\n"
+           "    sleeping %u ticks: %u timer interrupts, %ld us\n"
+           "    two threads running: %u timer interrupts, %u context "
+           "switches\n"
+           "    %s\n", timer->IsDynamic() ? "dynamic" : "periodic",
+           TICKLESS_SLEEP, sleepInterrupts, sleepUsecs, burnInterrupts,
+           switches, ok ? "PASSED" : "FAILED");
+
+    delete ticklessDone;
+}
+
+////////////////////////////////////////////////////////////////////
+
+/// Multiprocessor test, for `-smp`.
+///
+/// `SMP_THREADS` threads, all created on the first CPU, run for
+/// `SMP_ROUNDS` rounds of `SMP_WORK` ticks each: first on their own, then
+/// with half of every round inside a critical section of a `Lock` they all
+/// share.  Reports the speedup of each phase, as the time the CPUs were
+/// busy over the time taken, and the threads stolen by idle CPUs.  The
+/// critical sections must not overlap, and the lock caps the speedup at
+/// about two.
+
+static const int SMP_THREADS = 8;
+static const int SMP_ROUNDS  = 20;
+static const int SMP_WORK    = 200;
+
+static Semaphore *smpDone;
+static Lock *smpLock;
+static bool smpLocked;
+static int smpInside;
+static int smpCount;
+static bool smpOk;
+
+static void
+SmpWorker(void *)
+{
+    for (int i = 0; i < SMP_ROUNDS; i++) {
+        if (!smpLocked) {
+            Burn(SMP_WORK);
+            continue;
+        }
+        smpLock->Acquire();
+        if (smpInside++ != 0)
+            smpOk = false;
+        Burn(SMP_WORK / 2);
+        smpCount++;
+        smpInside--;
+        smpLock->Release();
+        Burn(SMP_WORK / 2);
+    }
+    smpDone->V();
+}
+
+static unsigned long
+BusyTicks()
+{
+    unsigned long busy = 0;
+    for (unsigned c = 0; c < numCpus; c++)
+        busy += cpus[c]->busyTicks;
+    return busy;
+}
+
+/// Return the speedup of a phase, in tenths.
+static unsigned long
+SmpPhase(bool locked)
+{
+    unsigned long busy = BusyTicks();
+    unsigned start = stats->totalTicks;
+
+    smpLocked = locked;
+    for (int i = 0; i < SMP_THREADS; i++)
+        (new Thread("smp worker"))->Fork(SmpWorker, NULL);
+    for (int i = 0; i < SMP_THREADS; i++)
+        smpDone->P();
+
+    busy = BusyTicks() - busy;
+    unsigned elapsed = stats->totalTicks - start;
+    return elapsed > 0 ? 10 * busy / elapsed : 0;
+}
+
+void
+SmpTest()
+{
+    smpDone = new Semaphore("smpDone", 0);
+    smpLock = new Lock("smpLock");
+    smpInside = 0;
+    smpCount = 0;
+    smpOk = true;
+
+    unsigned long alone = SmpPhase(false);
+    unsigned long locked = SmpPhase(true);
+    unsigned steals = 0;
+    for (unsigned c = 0; c < numCpus; c++)
+        steals += cpus[c]->steals;
+    smpOk = smpOk && smpCount == SMP_THREADS * SMP_ROUNDS;
+
+    printf("SMP test (%u CPUs, %d threads):\n"
+           "    independent: speedup %lu.%lu\n"
+           "    sharing a lock: speedup %lu.%lu\n"
+           "    %u threads stolen\n"
+           "    %s\n", numCpus, SMP_THREADS, alone / 10, alone % 10,
+           locked / 10, locked % 10, steals, smpOk ? "PASSED" : "FAILED");
+
+    delete smpLock;
+    delete smpDone;
+}
+
+/// Run the thread test named `which`: `lock`, `inversion`, `nested`,
+/// `sched`, `pool`, `cond`, `channel`, `alarm`, `tickless`, `latency`,
+/// `fair`, `preempt`, `create`, `overflow`, `join` or `smp`.  By default,
+/// the priority inversion test.
+void
+ThreadTest(const char *which)
+{
+    if (which == NULL || !strcmp(which, "inversion"))
+        InversionPrioridadesTest();
+    else if (!strcmp(which, "nested"))
+        NestedInversionTest();
+    else if (!strcmp(which, "lock"))
+        LockTest();
+    else if (!strcmp(which, "sched"))
+        SchedulerBenchmark();
+    else if (!strcmp(which, "pool"))
+        PoolTest();
+    else if (!strcmp(which, "cond"))
+        ConditionTest();
+    else if (!strcmp(which, "channel"))
+        ChannelBenchmark();
+    else if (!strcmp(which, "alarm"))
+        AlarmTest();
+    else if (!strcmp(which, "tickless"))
+        TicklessTest();
+    else if (!strcmp(which, "latency"))
+        LatencyTest();
+    else if (!strcmp(which, "fair"))
+        FairShareTest();
+    else if (!strcmp(which, "preempt"))
+        PreemptionTest();
+    else if (!strcmp(which, "create"))
+        CreationBenchmark();
+    else if (!strcmp(which, "overflow"))
+        OverflowTest();
+    else if (!strcmp(which, "join"))
+        JoinTest();
+    else if (!strcmp(which, "smp"))
+        SmpTest();
+    else
+        printf("Unknown thread test %s\n", which);
+}
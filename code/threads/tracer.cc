@@ -0,0 +1,127 @@
+/// Routines for the event trace.
+///
+/// Copyright (c) 2016-2017 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "tracer.hh"
+#include "system.hh"
+
+
+/// Category of every kind of event.
+static const TraceCategory CATEGORIES[NUM_TRACE_EVENTS] = {
+    TRACE_SCHED, TRACE_SCHED, TRACE_INTR, TRACE_DISK, TRACE_DISK,
+    TRACE_DISK, TRACE_VM, TRACE_VM, TRACE_VM, TRACE_SYSCALL, TRACE_SYSCALL
+};
+
+Tracer::Tracer(const char *traceFile)
+{
+    tracing = traceFile != NULL;
+    fileName = NULL;
+    threads = NULL;
+    numThreads = 0;
+    capacity = 0;
+    for (unsigned c = 0; c < NUM_TRACE_CATEGORIES; c++) {
+        rings[c] = NULL;
+        recorded[c] = 0;
+    }
+    if (!tracing)
+        return;
+
+    fileName = new char [strlen(traceFile) + 1];
+    strcpy(fileName, traceFile);
+    for (unsigned c = 0; c < NUM_TRACE_CATEGORIES; c++)
+        rings[c] = new TraceEvent [TRACE_RING_SIZE];
+    capacity = 64;
+    threads = new TraceThread [capacity];
+}
+
+Tracer::~Tracer()
+{
+    delete [] fileName;
+    for (unsigned c = 0; c < NUM_TRACE_CATEGORIES; c++)
+        delete [] rings[c];
+    delete [] threads;
+}
+
+int
+Tracer::AddThread(const char *name)
+{
+    if (!tracing)
+        return -1;
+
+    if (numThreads == capacity) {
+        TraceThread *bigger = new TraceThread [2 * capacity];
+        memcpy(bigger, threads, numThreads * sizeof *threads);
+        delete [] threads;
+        threads = bigger;
+        capacity *= 2;
+    }
+    TraceThread *t = &threads[numThreads];
+    t->thread = numThreads;
+    strncpy(t->name, name, TRACE_NAME_LENGTH - 1);
+    t->name[TRACE_NAME_LENGTH - 1] = '\0';
+    return numThreads++;
+}
+
+/// Events go on the CPU of their thread: the one starting or stopping, or
+/// else the current one.
+void
+Tracer::Add(unsigned type, int arg, Thread *thread)
+{
+    ASSERT(type < NUM_TRACE_EVENTS);
+
+    TraceCategory category = CATEGORIES[type];
+    TraceEvent *event = &rings[category][recorded[category]
+                                         % TRACE_RING_SIZE];
+    recorded[category]++;
+
+    if (thread == NULL)
+        thread = currentThread;
+    event->ticks = stats->totalTicks;
+    event->type = type;
+    event->cpu = thread != NULL ? thread->cpu : 0;
+    event->thread = thread != NULL ? thread->traceId : -1;
+    event->arg = arg;
+}
+
+void
+Tracer::Write()
+{
+    if (!tracing)
+        return;
+
+    TraceHeader header;
+    header.traceMagic = TRACEMAGIC;
+    header.numThreads = numThreads;
+    header.numEvents = 0;
+    header.numLost = 0;
+    for (unsigned c = 0; c < NUM_TRACE_CATEGORIES; c++)
+        if (recorded[c] > TRACE_RING_SIZE) {
+            header.numEvents += TRACE_RING_SIZE;
+            header.numLost += recorded[c] - TRACE_RING_SIZE;
+        } else
+            header.numEvents += recorded[c];
+
+    int fd = OpenForWrite(fileName);
+    WriteFile(fd, (char *) &header, sizeof header);
+    WriteFile(fd, (char *) threads, numThreads * sizeof *threads);
+
+    // Oldest first: a full ring starts where the next event would go.
+    for (unsigned c = 0; c < NUM_TRACE_CATEGORIES; c++) {
+        unsigned start = 0, count = recorded[c];
+        if (recorded[c] > TRACE_RING_SIZE) {
+            start = recorded[c] % TRACE_RING_SIZE;
+            count = TRACE_RING_SIZE;
+        }
+        unsigned first = count < TRACE_RING_SIZE - start
+                         ? count : TRACE_RING_SIZE - start;
+        WriteFile(fd, (char *) &rings[c][start], first * sizeof *rings[c]);
+        WriteFile(fd, (char *) rings[c], (count - first) * sizeof *rings[c]);
+    }
+    Close(fd);
+
+    DEBUG('t', "Trace written to \"%s\": %d events, %d lost\n", fileName,
+          header.numEvents, header.numLost);
+}
@@ -0,0 +1,90 @@
+/// Binary event trace of the kernel (`-trace`).
+///
+/// Context switches, interrupts, disk requests, page faults, swapping and
+/// system calls are recorded, with the simulated time, into ring buffers
+/// allocated up front, one per category; so recording is cheap, and does
+/// not change the timing of the run the way `DEBUG` output does.  When a
+/// buffer fills up, its oldest events are overwritten.  The trace is
+/// written at cleanup, in the format of `bin/trace.h`; `bin/trace2json`
+/// turns it into a timeline for Chrome's trace viewer.
+///
+/// Under `-smp` the clock moves once a round, so events are only as precise
+/// as `CPU_SLICE`.
+///
+/// Without `-trace` nothing is allocated, and recording does nothing.
+///
+/// Copyright (c) 2016-2017 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_THREADS_TRACER__HH
+#define NACHOS_THREADS_TRACER__HH
+
+
+#include "utility.hh"
+#include "bin/trace.h"
+
+
+class Thread;
+
+/// Categories of events, each with a buffer of its own, so that a flood of
+/// one kind does not push the others out.
+enum TraceCategory {
+    TRACE_SCHED,
+    TRACE_INTR,
+    TRACE_DISK,
+    TRACE_VM,
+    TRACE_SYSCALL,
+    NUM_TRACE_CATEGORIES
+};
+
+/// Events kept of every category.
+const unsigned TRACE_RING_SIZE = 16384;
+
+class Tracer {
+public:
+
+    /// Trace into `fileName`, or nothing if it is `NULL`.
+    Tracer(const char *fileName);
+
+    ~Tracer();
+
+    /// Give a thread a number in the trace, under `name`.  Return -1 if
+    /// not tracing.
+    int AddThread(const char *name);
+
+    /// Record an event of kind `type` on the current thread.
+    void Record(unsigned type, int arg = 0)
+    {
+        if (tracing)
+            Add(type, arg, NULL);
+    }
+
+    /// Record `thread` starting or stopping on its CPU.
+    void RecordThread(unsigned type, Thread *thread)
+    {
+        if (tracing)
+            Add(type, 0, thread);
+    }
+
+    /// Write the trace out.
+    void Write();
+
+private:
+
+    void Add(unsigned type, int arg, Thread *thread);
+
+    bool tracing;
+    char *fileName;
+
+    /// Events of every category, and how many were ever recorded; the next
+    /// goes at that count modulo `TRACE_RING_SIZE`.
+    TraceEvent *rings[NUM_TRACE_CATEGORIES];
+    unsigned long recorded[NUM_TRACE_CATEGORIES];
+
+    TraceThread *threads;
+    unsigned numThreads, capacity;
+};
+
+
+#endif
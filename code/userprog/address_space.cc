@@ -18,11 +18,25 @@
 
 #include "address_space.hh"
 #include "threads/system.hh"
+#ifdef FILESYS
+#include "filesys/file_header.hh"
+#endif
 
 #define DEMAND_LOADING
 
 static unsigned global_pids = 0;
 
+#ifdef VMEM
+#ifdef FILESYS
+/// Files do not grow, and cannot be larger than `MAX_FILE_SIZE`: swap files
+/// are created that large, as many as it takes.
+static const unsigned SWAP_FILE_PAGES = MAX_FILE_SIZE / PAGE_SIZE;
+#else
+/// Host files grow as they are written: one is always enough.
+static const unsigned SWAP_FILE_PAGES = USER_ADDR_SPACE_SIZE / PAGE_SIZE;
+#endif
+#endif
+
 /// Do little endian to big endian conversion on the bytes in the object file
 /// header, in case the file was generated on a little endian machine, and we
 /// are re now running on a big endian machine.
@@ -55,11 +69,18 @@ SwapHeader(NoffHeader *noffH)
 ///
 /// * `executable` is the file containing the object code to load into
 ///   memory.
-AddressSpace::AddressSpace(OpenFile *exe, const char *name){
+AddressSpace::AddressSpace(OpenFile *exe, const char *name)
+  : pageTable(USER_ADDR_SPACE_SIZE / PAGE_SIZE)
+{
 	
     m_name = name;
     m_pid = global_pids++;
+    usageRecord = accounting->AddRecord(name, m_pid);
+    syscallRecord = syscallStats->AddProcess(name, m_pid);
     executable = exe;
+    threads = 1;
+    stackSlots = new BitMap(USER_MAX_THREADS);
+    atomicStart = atomicEnd = 0;
 
 
     executable->ReadAt((char *) &noffH, sizeof noffH, 0);
@@ -68,80 +89,250 @@ AddressSpace::AddressSpace(OpenFile *exe, const char *name){
 
     ASSERT(noffH.noffMagic == NOFFMAGIC);     
 
-    unsigned size;          // Size in bytes of the whole program
-    unsigned initSizeBytes; // Data segment size in bytes
-    unsigned codeSizeBytes; // Code segment size in bytes
-    unsigned unitSizeBytes; // Uninitialized data size in bytes
-    unsigned numPagesZero;  // Uninitialized data size in pages
-
 	nCodePages = divRoundUp(noffH.code.size, PAGE_SIZE);
-	codeSizeBytes = nCodePages * PAGE_SIZE;
-
     nDataPages = divRoundUp(noffH.initData.size, PAGE_SIZE);
-    initSizeBytes = nDataPages * PAGE_SIZE;
-
-    unitSizeBytes = noffH.uninitData.size + USER_STACK_SIZE; 
 
-    numPagesZero = divRoundUp(unitSizeBytes, PAGE_SIZE);
-    unitSizeBytes = numPagesZero * PAGE_SIZE;
+    // The heap starts on the first page past the end of the image.
+    unsigned imageEnd = 0;
+    const Segment *segments[] = { &noffH.code, &noffH.initData,
+                                  &noffH.uninitData };
+    for (unsigned i = 0; i < 3; i++) {
+        unsigned end = segments[i]->virtualAddr + segments[i]->size;
+        if (segments[i]->size > 0 && end > imageEnd)
+            imageEnd = end;
+    }
+    heapStart = divRoundUp(imageEnd, PAGE_SIZE);
+    brk       = heapStart * PAGE_SIZE;
+    numPages  = pageTable.Size();
+    ASSERT(brk <= USER_MMAP_BASE && "Program doesn't fit below the mapping region.");
+
+    DEBUG('a', "Initializing address space, %u image pages, %u pages in total\n",
+          heapStart, numPages);
+    stats->numPages = heapStart;
+    stats->numFrames = NUM_PHYS_PAGES;
 
-    size = initSizeBytes + codeSizeBytes + unitSizeBytes;
-    numPages = nCodePages + nDataPages + numPagesZero;
+#ifdef VMEM
+    numSwapSlots = 0;
+#endif
 
-    DEBUG('a', "Initializing address space, num pages %u, size %u\n", numPages, size);
-    stats->numPages = numPages;
-    stats->numFrames = NUM_PHYS_PAGES;
+    cow.assign(numPages, false);
 
-#ifndef VMEM
-    ASSERT(numPages <= NUM_PHYS_PAGES && "Program doesn't fit in physical memory.");    
+#ifdef DEMAND_LOADING
+    init_demand_loading();
 #else
-    DEBUG('v', "Total size in pages is %d \n",numPages);
+    init_non_demand_loading();
 #endif
 
-    // CREAR EL ARCHIVO DE SWAP
+}
+
+AddressSpace::AddressSpace(AddressSpace *parent)
+  : pageTable(parent->pageTable.Size())
+{
+    ASSERT(parent == currentThread->space);
+
+    m_name     = parent->m_name;
+    m_pid      = global_pids++;
+    usageRecord = accounting->AddRecord(m_name, m_pid);
+    syscallRecord = syscallStats->AddProcess(m_name, m_pid);
+    threads    = 1;
+    atomicStart = parent->atomicStart;
+    atomicEnd   = parent->atomicEnd;
+    noffH      = parent->noffH;
+    nCodePages = parent->nCodePages;
+    nDataPages = parent->nDataPages;
+    numPages   = parent->numPages;
+    heapStart  = parent->heapStart;
+    brk        = parent->brk;
+
+    // Pages never touched by the parent are still demand loaded, so the
+    // child needs its own handle on the executable.
+    executable = fileSystem->Open(m_name);
+    ASSERT(executable != NULL);
+
+    DEBUG('a', "Forking address space %d into %d, num pages %u\n",
+          parent->m_pid, m_pid, numPages);
+
+    // Only the forking thread goes on in the child, on the same stack.
+    stackSlots = new BitMap(USER_MAX_THREADS);
+    if (currentThread->userStackSlot >= 0)
+        stackSlots->Mark(currentThread->userStackSlot);
+
 #ifdef VMEM
-    char swapFilename[32];
-    sprintf(swapFilename, "SWAP.%d", m_pid);
-    ASSERT(fileSystem->Create(swapFilename, MEMORY_SIZE));
-    swap_file = fileSystem->Open(swapFilename);
-    DEBUG('v', "Creating swap file %s total size is %d\n",swapFilename,numPages*PAGE_SIZE);
+    numSwapSlots = 0;
+#endif
 
-    ASSERT(swap_file != NULL);
+    // Bring the parent's page table up to date with the TLB, and flush the
+    // TLB so its next writes see the read-only bits set below.
+    parent->SaveState();
+    parent->RestoreState();
+#ifdef USE_TLB
+    parent->ShootDown();
+#endif
 
-    for (unsigned i = 0; i < numPages; i++)
-        for (unsigned j = 0; j < PAGE_SIZE; j++){
-            swap_file->Write("0", 1);
+    // Mapped files are opened again rather than shared; get the parent's
+    // changes into them first so the child starts from the same contents.
+    for (unsigned i = 0; i < parent->mappings.size(); i++)
+        parent->FlushMapping(&parent->mappings[i], false);
+
+    cow.assign(numPages, false);
+
+    // Only the parent's allocated leaves need looking at.
+    for (unsigned i = 0; i < numPages; i++) {
+        if (parent->pageTable.Find(i) == NULL)
+            continue;
+        int slot = StackSlotOf(i);
+        if (slot >= 0 && !stackSlots->Test(slot))
+            continue;  // Stack of a thread left behind.
+
+        TranslationEntry &mine   = pageTable[i];
+        TranslationEntry &theirs = parent->pageTable[i];
+
+        mine = theirs;
+
+        if (!theirs.valid || parent->FindMapping(i) != NULL) {
+            mine.valid        = false;
+            mine.physicalPage = -1;  // Not loaded yet: load it on demand.
+            continue;
         }
-#endif
 
-#ifdef DEMAND_LOADING
-    init_demand_loading();
+#ifdef VMEM
+        if (theirs.physicalPage == -1) {
+            // Swapped out: the child gets its own copy in its swap.
+            char page[PAGE_SIZE];
+            parent->ReadSwap(i, page);
+            WriteSwap(i, page);
+            continue;
+        }
+
+        paginador->ShareFrame(theirs.physicalPage, this);
+        if (!theirs.readOnly || parent->cow[i]) {
+            theirs.readOnly = mine.readOnly = true;
+            parent->cow[i]  = cow[i]        = true;
+        }
+        // Neither swap file holds this page yet.
+        theirs.dirty = mine.dirty = true;
 #else
-    init_non_demand_loading();
+        int frame = bitmap->Find();
+        ASSERT(frame >= 0 && "physical memory is full!");
+        memcpy(&machine->mainMemory[frame * PAGE_SIZE],
+               &machine->mainMemory[theirs.physicalPage * PAGE_SIZE],
+               PAGE_SIZE);
+        mine.physicalPage = frame;
 #endif
+    }
 
+    for (unsigned i = 0; i < parent->mappings.size(); i++) {
+        const MappedFile &m = parent->mappings[i];
+        MappedFile copy = m;
+        copy.name = new char [strlen(m.name) + 1];
+        strcpy(copy.name, m.name);
+        copy.file = fileSystem->Open(m.name);
+        ASSERT(copy.file != NULL);
+        mappings.push_back(copy);
+    }
 }
 
+#ifdef VMEM
+/// Name of swap file number `n` of the space of `pid`, short enough for
+/// the directory.
+static void
+SwapFileName(char *name, int pid, unsigned n)
+{
+    if (n == 0)
+        sprintf(name, "SWAP.%d", pid);
+    else
+        sprintf(name, "SWAP%u.%d", n, pid);
+}
 
-void AddressSpace::init_demand_loading(){
-    
-    pageTable = new TranslationEntry[numPages];
+unsigned
+AddressSpace::AllocateSwapSlot(unsigned vpn)
+{
+    ASSERT(swapSlots.count(vpn) == 0);
+
+    unsigned slot;
+    if (!freeSwapSlots.empty()) {
+        slot = freeSwapSlots.back();
+        freeSwapSlots.pop_back();
+    } else {
+        slot = numSwapSlots++;
+        if (slot % SWAP_FILE_PAGES == 0) {
+            char name[32];
+            SwapFileName(name, m_pid, swapFiles.size());
+            DEBUG('v', "Creating swap file %s\n", name);
+            bool created = fileSystem->Create(name,
+                                              SWAP_FILE_PAGES * PAGE_SIZE);
+            ASSERT(created && "no room left for swap");
+            OpenFile *file = fileSystem->Open(name);
+            ASSERT(file != NULL);
+            swapFiles.push_back(file);
+        }
+    }
+    swapSlots[vpn] = slot;
+    return slot;
+}
 
-    for (unsigned i = 0; i < numPages; i++) {
-        pageTable[i].virtualPage  = i;
-        pageTable[i].physicalPage = -1;
-        pageTable[i].valid        = false;  // false means 'never loaded'
-        pageTable[i].use          = false;
-        pageTable[i].dirty        = true;
-        pageTable[i].readOnly     = false;
+void
+AddressSpace::FreeSwapSlot(unsigned vpn)
+{
+    std::map<unsigned, unsigned>::iterator it = swapSlots.find(vpn);
+    if (it == swapSlots.end())
+        return;
+    freeSwapSlots.push_back(it->second);
+    swapSlots.erase(it);
+}
+
+void
+AddressSpace::ReadSwap(unsigned vpn, char *page)
+{
+    std::map<unsigned, unsigned>::iterator it = swapSlots.find(vpn);
+    ASSERT(it != swapSlots.end());
+
+    unsigned slot = it->second;
+    int ret = swapFiles[slot / SWAP_FILE_PAGES]->ReadAt(
+                page, PAGE_SIZE, slot % SWAP_FILE_PAGES * PAGE_SIZE);
+    ASSERT(ret == PAGE_SIZE);
+}
+
+void
+AddressSpace::WriteSwap(unsigned vpn, const char *page)
+{
+    std::map<unsigned, unsigned>::iterator it = swapSlots.find(vpn);
+    unsigned slot = it != swapSlots.end() ? it->second : AllocateSwapSlot(vpn);
+
+    int ret = swapFiles[slot / SWAP_FILE_PAGES]->WriteAt(
+                page, PAGE_SIZE, slot % SWAP_FILE_PAGES * PAGE_SIZE);
+    ASSERT(ret == PAGE_SIZE);
+}
+
+void
+AddressSpace::RemoveSwap()
+{
+    for (unsigned n = 0; n < swapFiles.size(); n++) {
+        char name[32];
+        SwapFileName(name, m_pid, n);
+        delete swapFiles[n];
+        fileSystem->Remove(name);
     }
+    swapFiles.clear();
+    swapSlots.clear();
+    freeSwapSlots.clear();
+    numSwapSlots = 0;
+}
+#endif
+
+
+void AddressSpace::init_demand_loading(){
+
+    // Nothing to do: page table entries are created, not loaded ('valid'
+    // off), the first time each page is touched.
 
 }
 void AddressSpace::init_non_demand_loading(){
 
-    pageTable = new TranslationEntry[numPages];
-
-    for (unsigned i = 0; i < numPages; i++) {
+    // Every image page is filled in one go: a `ReadAt` per segment slice
+    // that lands in it, copied straight into the frame.  Heap and stack
+    // pages still come on demand.
+    for (unsigned i = 0; i < heapStart; i++) {
         pageTable[i].virtualPage  = i;
 
 #ifndef VMEM
@@ -154,67 +345,55 @@ void AddressSpace::init_non_demand_loading(){
         pageTable[i].physicalPage = newPage;
         pageTable[i].valid        = true;
         pageTable[i].use          = false;
+#ifdef VMEM
+        pageTable[i].dirty        = true;  // Not in swap yet, if it is evicted
+                                           // it has to be written there.
+#else
         pageTable[i].dirty        = false;
+#endif
         pageTable[i].readOnly     = false;
 
-        memset(&(machine -> mainMemory [pageTable[i].physicalPage*PAGE_SIZE]),0,PAGE_SIZE);
-
+        FillPage(i, newPage);
     }
+}
 
-    // copy in the code and data segments into memory.
-	char temp;
-	int frame, off;
-	
-    // copiar el segmento de código
-    if (noffH.code.size > 0) {     
-        DEBUG('a', "Initializing code segment, at 0x%X, size %u\n", noffH.code.virtualAddr, noffH.code.size);
-        for (int j=0; j<noffH.code.size; j++){
-			ASSERT(executable->ReadAt(&temp,1,noffH.code.inFileAddr+j)==1);                     //Leemos un byte del archivo
+/// Copy into `frame` the bytes of `seg` that belong to virtual page `vpn`.
+///
+/// Segments need not start or end on a page boundary, so a page may hold
+/// just the tail of one segment and the head of the next one.
+void
+AddressSpace::LoadSegmentPage(const Segment *seg, unsigned vpn, int frame)
+{
+    if (seg->size <= 0)
+        return;
 
-            int vpn = (noffH.code.virtualAddr + j) / PAGE_SIZE;
-			frame = pageTable[vpn].physicalPage; // Calculamos el frame
-			off = (noffH.code.virtualAddr + j) % PAGE_SIZE;
+    unsigned pageStart = vpn * PAGE_SIZE;
+    unsigned pageEnd   = pageStart + PAGE_SIZE;
+    unsigned segStart  = seg->virtualAddr;
+    unsigned segEnd    = seg->virtualAddr + seg->size;
 
-#ifndef VMEM
-            ASSERT(frame>=0)
-#else
-            DEBUG('v', "Filling code virtual page %d whose registered frame is %d \n",vpn,frame);
-            if (frame < 0) {  // This vpn no longer has a frame associated in memory
-                frame = paginador->FindFreeFrame(this,vpn);
-                DEBUG('v', "Paginador le consiguio un frame nuevo, %d \n",frame);
-                SwapToMemory(vpn,frame);
-            }
-#endif // VMEM
-            pageTable[vpn].dirty = true;
-			machine->mainMemory[frame * PAGE_SIZE +off] = temp;
-        }                             
-    }
+    if (segEnd <= pageStart || segStart >= pageEnd)
+        return;  // No overlap with this page.
 
-    // copiar el segmento de datos initializados
-    if (noffH.initData.size > 0) {
-        DEBUG('a', "Initializing data segment, at 0x%X, size %u\n", noffH.initData.virtualAddr, noffH.initData.size);
-        
-        for (int j=0; j<noffH.initData.size; j++){
-			ASSERT(executable->ReadAt(&temp,1,noffH.initData.inFileAddr+j)==1);  //Leemos un byte del archivo
-            int vpn = (noffH.initData.virtualAddr + j) / PAGE_SIZE;
-			frame = pageTable[vpn].physicalPage; // Calculamos el frame
-			off = (noffH.initData.virtualAddr + j) % PAGE_SIZE;
+    unsigned from = segStart > pageStart ? segStart : pageStart;
+    unsigned to   = segEnd   < pageEnd   ? segEnd   : pageEnd;
 
-#ifndef VMEM
-            ASSERT(frame>=0)
-#else
-            DEBUG('v', "Filling data virtual page %d whose registered frame is %d \n",vpn,frame);
-            if (frame < 0) {  // This vpn no longer has a frame associated in memory :
-                frame = paginador->FindFreeFrame(this,vpn);
-                DEBUG('v', "Paginador le consiguio un frame nuevo, %d \n",frame);
-                SwapToMemory(vpn,frame); // Solo copia ceros, pero acomoda todas las tablas.
-            }
-#endif //VMEM
-            pageTable[vpn].dirty = true; // Set to true because it has not been copied to swap yet!
-			machine->mainMemory[frame * PAGE_SIZE +off] = temp; // Acá le pone los valores reales.
-        }     
-        
-    }
+    DEBUG('a', "Loading 0x%X..0x%X of vpn %u from file offset %u\n",
+          from, to, vpn, seg->inFileAddr + (from - segStart));
+    int read = executable->ReadAt(
+        &machine->mainMemory[frame * PAGE_SIZE + (from - pageStart)],
+        to - from, seg->inFileAddr + (from - segStart));
+    ASSERT(read == (int) (to - from));
+}
+
+/// Initialize frame `frame` with the contents virtual page `vpn` has when
+/// the program starts.
+void
+AddressSpace::FillPage(unsigned vpn, int frame)
+{
+    memset(&machine->mainMemory[frame * PAGE_SIZE], 0, PAGE_SIZE);
+    LoadSegmentPage(&noffH.code, vpn, frame);
+    LoadSegmentPage(&noffH.initData, vpn, frame);
 }
 
 
@@ -226,6 +405,9 @@ AddressSpace::loadPage(unsigned vaddr)
     DEBUG('a', "Loading page associated to vaddr 0x%X \n",vaddr);
     int virtualPage = vaddr / PAGE_SIZE;
 
+    ASSERT(IsLegal(virtualPage));
+    MappedFile *m = FindMapping(virtualPage);
+
 #ifndef VMEM
     int frame = bitmap->Find();
     ASSERT(frame>=0 && "physical memory is full!");  // newPage==-1 => memory is full.
@@ -238,61 +420,321 @@ AddressSpace::loadPage(unsigned vaddr)
     pageTable[virtualPage].physicalPage = frame; 
 
     DEBUG('a', "[Demand loading] vpn %d about to be loaded to frame %d\n",virtualPage,frame);
-    //DEBUG('a', "[Prior loading] memory[frame] has value = %8.8x\n", machine->mainMemory[frame]);
 
+    if (m != NULL) {
+        char *dest = &machine->mainMemory[frame * PAGE_SIZE];
+        unsigned offset = (virtualPage - m->firstVpn) * PAGE_SIZE;
+        memset(dest, 0, PAGE_SIZE);
+        if (offset < m->length) {
+            unsigned n = m->length - offset < PAGE_SIZE ? m->length - offset
+                                                         : PAGE_SIZE;
+            m->file->ReadAt(dest, n, offset);  // Short at end of file.
+        }
+        pageTable[virtualPage].dirty = false;  // Same as the file.
+    } else
+        FillPage(virtualPage, frame);
+
+    pageTable[virtualPage].valid = true;  
+
+}
+
+int
+AddressSpace::Mmap(const char *name, int length)
+{
+    // Refused before anything is allocated for it: no mapping can be
+    // larger than the region they all share.
+    if (length <= 0 || (unsigned) length > USER_THREAD_STACKS - USER_MMAP_BASE)
+        return -1;
+
+    OpenFile *file = fileSystem->Open(name);
+    if (file == NULL)
+        return -1;
+
+    int firstVpn = AddMapping(name, file, length);
+    if (firstVpn < 0) {
+        delete file;
+        return -1;
+    }
+    DEBUG('a', "Mapped %d bytes of %s at vpn %d\n", length, name, firstVpn);
+    return firstVpn * PAGE_SIZE;
+}
+
+bool
+AddressSpace::Munmap(unsigned addr)
+{
+    if (addr % PAGE_SIZE != 0)
+        return false;
+
+    for (unsigned i = 0; i < mappings.size(); i++) {
+        MappedFile *m = &mappings[i];
+        if (m->firstVpn * PAGE_SIZE != addr)
+            continue;
+
+        DEBUG('a', "Unmapping %s from vpn %u\n", m->name, m->firstVpn);
+        FlushMapping(m, true);
+        delete m->file;
+        delete [] m->name;
+        mappings.erase(mappings.begin() + i);
+        return true;
+    }
+    return false;
+}
+
+void
+AddressSpace::UnmapAll()
+{
+    while (!mappings.empty())
+        Munmap(mappings.back().firstVpn * PAGE_SIZE);
+}
+
+AddressSpace::MappedFile *
+AddressSpace::FindMapping(unsigned vpn)
+{
+    if (vpn < USER_MMAP_BASE / PAGE_SIZE)
+        return NULL;
+    for (unsigned i = 0; i < mappings.size(); i++)
+        if (mappings[i].firstVpn <= vpn
+              && vpn < mappings[i].firstVpn + mappings[i].numPages)
+            return &mappings[i];
+    return NULL;
+}
 
-    if (virtualPage < nCodePages){
+int
+AddressSpace::AddMapping(const char *name, OpenFile *file, unsigned length)
+{
+    unsigned n     = divRoundUp(length, PAGE_SIZE);
+    unsigned first = USER_MMAP_BASE / PAGE_SIZE;
+    unsigned end   = USER_THREAD_STACKS / PAGE_SIZE;
+
+    // First fit, among the holes between existing mappings.
+    for (unsigned vpn = first; vpn < end && vpn - first < n; vpn++)
+        if (FindMapping(vpn) != NULL)
+            first = vpn + 1;
+    if (end - first < n)
+        return -1;
+
+    MappedFile m;
+    m.name = new char [strlen(name) + 1];
+    strcpy(m.name, name);
+    m.file     = file;
+    m.firstVpn = first;
+    m.numPages = n;
+    m.length   = length;
+    mappings.push_back(m);
+    return first;
+}
 
-        DEBUG('a', "[Demand loading] page was found in code segment \n");
+void
+AddressSpace::WriteBackPage(MappedFile *m, unsigned vpn)
+{
+    TranslationEntry &entry = pageTable[vpn];
+    unsigned offset = (vpn - m->firstVpn) * PAGE_SIZE;
+
+    ASSERT(entry.valid && entry.physicalPage >= 0);
+    if (entry.dirty && offset < m->length) {
+        unsigned n = m->length - offset < PAGE_SIZE ? m->length - offset
+                                                     : PAGE_SIZE;
+        DEBUG('a', "Writing back vpn %u to %s at offset %u\n",
+              vpn, m->name, offset);
+        m->file->WriteAt(&machine->mainMemory[entry.physicalPage * PAGE_SIZE],
+                         n, offset);
+    }
+    entry.dirty = false;
+}
 
-        executable->ReadAt(
-            &(machine->mainMemory[pageTable[virtualPage].physicalPage*PAGE_SIZE]),
-                PAGE_SIZE, noffH.code.inFileAddr + virtualPage*PAGE_SIZE);
-        //DEBUG('a', "[Post loading] memory[frame] has value = %8.8x\n", machine->mainMemory[frame]);
+void
+AddressSpace::FlushMapping(MappedFile *m, bool release)
+{
+    unsigned last = m->firstVpn + m->numPages;
 
+#ifdef USE_TLB
+    ShootDown();
+    if (currentThread->space == this) {
+        for (unsigned i = 0; i < TLB_SIZE; i++) {
+            TranslationEntry &t = machine->tlb[i];
+            if (t.valid && m->firstVpn <= t.virtualPage && t.virtualPage < last) {
+                pageTable[t.virtualPage] = t;
+                t.dirty = false;  // About to be written back.
+                if (release)
+                    t.valid = false;
+            }
+        }
     }
-    else if (virtualPage < nDataPages + nCodePages){
-        DEBUG('a', "[Demand loading] page was found in initialised data segment \n");
-        executable->ReadAt(
-            &(machine->mainMemory[pageTable[virtualPage].physicalPage*PAGE_SIZE]),
-        PAGE_SIZE, noffH.initData.inFileAddr + (virtualPage-nCodePages)*PAGE_SIZE);
-        //  DEBUG('a', "[Post loading] memory[frame] has value = %8.8x\n", machine->mainMemory[frame]);
-    } 
-    else 
-    {
-        DEBUG('a', "[Demand loading] page was found in uninitialised data segment \n");
-        memset(machine->mainMemory + (pageTable[virtualPage].physicalPage)*PAGE_SIZE, 0, PAGE_SIZE);
-      //  DEBUG('a', "[Post loading] memory[frame] has value = %8.8x\n", machine->mainMemory[frame]);
+#endif
+
+    for (unsigned vpn = m->firstVpn; vpn < last; vpn++) {
+        TranslationEntry &entry = pageTable[vpn];
+        if (!entry.valid || entry.physicalPage < 0)
+            continue;
 
+        WriteBackPage(m, vpn);
+        if (release)
+            ReleasePage(vpn);
     }
-  pageTable[virtualPage].valid = true;  
+}
 
+bool
+AddressSpace::IsLegal(unsigned vpn)
+{
+    if (vpn >= numPages)
+        return false;
+    if (vpn < (unsigned) divRoundUp(brk, PAGE_SIZE))
+        return true;   // Image or heap.
+    if (vpn >= (USER_ADDR_SPACE_SIZE - USER_STACK_LIMIT) / PAGE_SIZE)
+        return true;   // Stack, which grows as it is touched.
+    int slot = StackSlotOf(vpn);
+    if (slot >= 0)     // Stack of a thread, except for the guard page.
+        return stackSlots->Test(slot)
+               && vpn * PAGE_SIZE % USER_THREAD_STACK >= PAGE_SIZE;
+    return FindMapping(vpn) != NULL;
 }
 
+int
+AddressSpace::StackSlotOf(unsigned vpn)
+{
+    unsigned addr = vpn * PAGE_SIZE;
+    if (addr < USER_THREAD_STACKS
+          || addr >= USER_ADDR_SPACE_SIZE - USER_STACK_LIMIT)
+        return -1;
+    return (addr - USER_THREAD_STACKS) / USER_THREAD_STACK;
+}
 
-/// Deallocate an address space.
-AddressSpace::~AddressSpace(){
+/// The sequence must lie in the code, and be short: every thread switched
+/// out inside it repeats it.
+bool
+AddressSpace::SetAtomicRange(unsigned start, unsigned end)
+{
+    if (start >= end || end - start > 16 * 4 || start % 4 != 0
+          || end % 4 != 0
+          || end > (unsigned) (noffH.code.virtualAddr + noffH.code.size))
+        return false;
+    atomicStart = start;
+    atomicEnd   = end;
+    return true;
+}
 
-    DEBUG('a', "Deleting AddressSpace");
-	unsigned i;
-	for(i=0; i<numPages; i++) {
+void
+AddressSpace::RestartAtomic(int *registers)
+{
+    unsigned pc = registers[PC_REG];
+    if (pc >= atomicStart && pc < atomicEnd && pc != atomicStart) {
+        DEBUG('a', "Restarting the atomic sequence of space %d at 0x%X\n",
+              m_pid, pc);
+        registers[PC_REG]      = atomicStart;
+        registers[NEXT_PC_REG] = atomicStart + 4;
+    }
+}
+
+void
+AddressSpace::Attach()
+{
+    threads++;
+}
+
+bool
+AddressSpace::Detach()
+{
+    ASSERT(threads > 0);
+    return --threads == 0;
+}
+
+int
+AddressSpace::AllocateStack()
+{
+    int slot = stackSlots->Find();
+    DEBUG('a', "Stack slot %d of space %d taken\n", slot, m_pid);
+    return slot;
+}
+
+unsigned
+AddressSpace::StackTop(int slot)
+{
+    ASSERT(slot >= 0 && (unsigned) slot < USER_MAX_THREADS);
+    return USER_THREAD_STACKS + (slot + 1) * USER_THREAD_STACK - 16;
+}
+
+void
+AddressSpace::FreeStack(int slot)
+{
+    ASSERT(stackSlots->Test(slot));
+    unsigned first = (USER_THREAD_STACKS + slot * USER_THREAD_STACK) / PAGE_SIZE;
+    for (unsigned vpn = first; vpn < first + USER_THREAD_STACK / PAGE_SIZE;
+         vpn++)
+        ReleasePage(vpn);
+    stackSlots->Clear(slot);
+    DEBUG('a', "Stack slot %d of space %d freed\n", slot, m_pid);
+}
+
+void
+AddressSpace::ReleasePage(unsigned vpn)
+{
+    TranslationEntry *entry = pageTable.Find(vpn);
+    if (entry == NULL)
+        return;
+
+#ifdef USE_TLB
+    ShootDown();
+    if (currentThread->space == this)
+        for (unsigned i = 0; i < TLB_SIZE; i++)
+            if (machine->tlb[i].valid && machine->tlb[i].virtualPage == vpn)
+                machine->tlb[i].valid = false;
+#endif
+
+    if (entry->valid && entry->physicalPage >= 0) {
 #ifndef VMEM
-        bitmap->Clear(pageTable[i].physicalPage);
+        bitmap->Clear(entry->physicalPage);
 #else
-        if (pageTable[i].physicalPage>=0 && pageTable[i].valid)
-        {
-            paginador->ReleaseFrame(pageTable[i].physicalPage);
-        }
+        paginador->ReleaseFrame(entry->physicalPage, this);
 #endif
     }
+    entry->physicalPage = -1;
+    entry->valid        = false;
+    entry->use          = false;
+    entry->dirty        = true;
+    entry->readOnly     = false;
+    cow[vpn]            = false;
+#ifdef VMEM
+    FreeSwapSlot(vpn);
+#endif
+}
+
+int
+AddressSpace::Sbrk(int increment)
+{
+    unsigned oldBrk = brk;
+    long newBrk = (long) brk + increment;
+
+    if (newBrk < (long) (heapStart * PAGE_SIZE) || newBrk > (long) USER_MMAP_BASE)
+        return -1;
 
-    delete [] pageTable;
+    // Shrinking gives back the pages that are left wholly past the end.
+    for (unsigned vpn = divRoundUp(newBrk, PAGE_SIZE);
+         vpn < (unsigned) divRoundUp(oldBrk, PAGE_SIZE); vpn++)
+        ReleasePage(vpn);
+
+    brk = newBrk;
+    DEBUG('a', "Heap of space %d now ends at 0x%X\n", m_pid, brk);
+    return oldBrk;
+}
+
+
+/// Deallocate an address space.
+AddressSpace::~AddressSpace(){
+
+    DEBUG('a', "Deleting AddressSpace");
+
+    accounting->PrintExit(usageRecord);
+    UnmapAll();
+
+    for (unsigned i = 0; i < numPages; i++)
+        ReleasePage(i);
 
 #ifdef VMEM
-    delete swap_file;
+    RemoveSwap();
 #endif
 
     delete executable;
+    delete stackSlots;
 
 }
 
@@ -349,29 +791,48 @@ void AddressSpace::RestoreState()
     for (unsigned i = 0 ; i < TLB_SIZE ; i++)
         machine->tlb[i].valid = false;
 #else
-    machine->pageTable     = pageTable;
-    machine->pageTableSize = numPages;
+    machine->pageTable = &pageTable;
 #endif
 }
 
-void AddressSpace::handleTLBMiss(unsigned vaddr) 
+#ifdef USE_TLB
+/// Under SMP, the thread of another CPU may be running in this space,
+/// waiting for its turn with its TLB kept aside (see `Cpu::SaveTlb`).  The
+/// entries are in the page table already, so dropping the whole TLB is
+/// enough.
+void
+AddressSpace::ShootDown()
 {
+    for (unsigned i = 0; i < numCpus; i++)
+        if (cpus[i] != currentCpu)
+            cpus[i]->DropTlb(this);
+}
+#endif
 
+bool AddressSpace::FaultIn(unsigned vaddr)
+{
     unsigned int vpn = vaddr/PAGE_SIZE;  // Virtual page number
 
-    DEBUG('a', "Handling TLB miss, looking for VA 0x%X \n",vaddr);
-
-    // Make sure vpn is within bounds
-    if (vpn <0 || vpn > numPages) {
-        DEBUG('a', "Error: Requested vpn is not within bounds, numpages= %d \n", numPages);
-        currentThread->Finish(1);
-        return;
+    // Make sure vpn is in some region: the stack and the heap only count
+    // as far as they have grown.
+    if (!IsLegal(vpn)) {
+        DEBUG('a', "Error: VA 0x%X is outside every region of space %d\n", vaddr, m_pid);
+        if (currentThread->space == this)
+            currentThread->Finish(1);
+        return false;
     }
 
     TranslationEntry& entry = pageTable[vpn];
     DEBUG('a', "pagetable[%d] renders an entry whose vpn is %d \n",vpn,entry.virtualPage);
     ASSERT(pageTable[vpn].virtualPage == vpn)
 
+    // A page fault proper: the page is not in memory.
+    if (!entry.valid || entry.physicalPage == -1) {
+        stats->numPageFaults++;
+        accounting->CountFor(this, &Usage::pageFaults);
+        tracer->Record(TRACE_PAGE_FAULT, vpn);
+    }
+
 
     // If it has never been loaded, do it
 #ifdef DEMAND_LOADING
@@ -392,6 +853,20 @@ void AddressSpace::handleTLBMiss(unsigned vaddr)
     }
 #endif
     ASSERT(pageTable[vpn].virtualPage == vpn)
+    return true;
+}
+
+void AddressSpace::handleTLBMiss(unsigned vaddr) 
+{
+
+    unsigned int vpn = vaddr/PAGE_SIZE;  // Virtual page number
+
+    DEBUG('a', "Handling TLB miss, looking for VA 0x%X \n",vaddr);
+    accounting->Count(&Usage::tlbMisses);
+
+    if (!FaultIn(vaddr))
+        return;
+    TranslationEntry& entry = pageTable[vpn];
 
     // Try to find an empty spot in the tlb
     for(unsigned i = 0; i < TLB_SIZE; i++){
@@ -416,6 +891,79 @@ void AddressSpace::handleTLBMiss(unsigned vaddr)
 
 }
 
+bool
+AddressSpace::CanHandle(ExceptionType which, unsigned vaddr)
+{
+    unsigned vpn = vaddr / PAGE_SIZE;
+
+    switch (which) {
+        case PAGE_FAULT_EXCEPTION:
+            return IsLegal(vpn);
+        case READ_ONLY_EXCEPTION:
+            return vpn < numPages && cow[vpn];
+        default:
+            return false;
+    }
+}
+
+bool AddressSpace::CopyOnWrite(unsigned vaddr)
+{
+    unsigned vpn = vaddr / PAGE_SIZE;
+
+    if (vpn >= numPages || !cow[vpn])
+        return false;
+
+#ifdef VMEM
+    DEBUG('v', "[CopyOnWrite] vpn %u of addrspaceid %d\n", vpn, m_pid);
+
+#ifdef USE_TLB
+    ShootDown();
+
+    // The faulting access is retried right away, so the TLB entry is
+    // updated in place rather than dropped.
+    int slot = -1;
+    for (unsigned i = 0; i < TLB_SIZE; i++) {
+        if (machine->tlb[i].valid && machine->tlb[i].virtualPage == vpn) {
+            pageTable[vpn] = machine->tlb[i];
+            machine->tlb[i].valid = false;
+            slot = i;
+        }
+    }
+#endif
+
+    int oldFrame = pageTable[vpn].physicalPage;
+    ASSERT(oldFrame >= 0);
+
+    if (paginador->IsShared(oldFrame)) {
+        int newFrame = paginador->FindFreeFrame(this, vpn);
+        if (pageTable[vpn].physicalPage == -1) {
+            // Making room evicted the shared frame itself, so our copy is
+            // already in swap.
+            SwapToMemory(vpn, newFrame);
+        } else {
+            memcpy(&machine->mainMemory[newFrame * PAGE_SIZE],
+                   &machine->mainMemory[oldFrame * PAGE_SIZE], PAGE_SIZE);
+            paginador->ReleaseFrame(oldFrame, this);
+            pageTable[vpn].physicalPage = newFrame;
+        }
+        stats->cowCopies++;
+    }
+
+    cow[vpn] = false;
+    pageTable[vpn].readOnly = false;
+    pageTable[vpn].dirty    = true;
+    pageTable[vpn].use      = true;
+#ifdef USE_TLB
+    if (slot >= 0)
+        machine->tlb[slot] = pageTable[vpn];
+#endif
+    return true;
+#else
+    ASSERT(false);  // Without VMEM pages are never shared.
+    return false;
+#endif
+}
+
 #ifdef VMEM
 
 void AddressSpace::SwapToMemory(unsigned vpn, int physicalPage)
@@ -425,8 +973,7 @@ void AddressSpace::SwapToMemory(unsigned vpn, int physicalPage)
     
     pageTable[vpn].physicalPage = physicalPage;
 
-    int ret = swap_file->ReadAt(&(machine->mainMemory[physicalPage * PAGE_SIZE]), PAGE_SIZE, vpn*PAGE_SIZE);
-    ASSERT(ret == PAGE_SIZE);
+    ReadSwap(vpn, &machine->mainMemory[physicalPage * PAGE_SIZE]);
     DEBUG('v',"Retrieving vpn %d into frame %d, addrspaceid %d from swap\n", vpn, physicalPage,m_pid);
 
     //DEBUG('v', "Memory retrieved looks like: %d \n",machine->mainMemory[0]);
@@ -436,7 +983,15 @@ void AddressSpace::SwapToMemory(unsigned vpn, int physicalPage)
     pageTable[vpn].valid = true;
     pageTable[vpn].use   = true;
 
+    // Whatever comes back from swap is private to this space.
+    if (cow[vpn]) {
+        cow[vpn] = false;
+        pageTable[vpn].readOnly = false;
+    }
+
     stats->swaps_in++;
+    accounting->CountFor(this, &Usage::swapsIn);
+    tracer->Record(TRACE_SWAP_IN, vpn);
 
     ASSERT(pageTable[vpn].virtualPage == vpn)
 
@@ -452,6 +1007,7 @@ void AddressSpace::MemoryToSwap(unsigned vpn)
     DEBUG('v',"[MemoryToSwap] About to send vpn %d, located in frame %d, addrspaceid %d to swap\n", vpn, physicalPage,m_pid);
     // Invalidar la entrada de la TLB si corresponde
 #ifdef USE_TLB
+    ShootDown();
     if(currentThread->space == this){
         for(unsigned i=0; i<TLB_SIZE; i++) {
             if((machine->tlb[i].virtualPage == vpn) && machine->tlb[i].valid) {
@@ -463,14 +1019,26 @@ void AddressSpace::MemoryToSwap(unsigned vpn)
     }
 #endif   
 
-    if(pageTable[vpn].dirty){ 
+    // Las páginas de un archivo mapeado vuelven al archivo, no al swap, y
+    // se leen de nuevo de ahí la próxima vez.
+    MappedFile *m = FindMapping(vpn);
+    if (m != NULL) {
+        WriteBackPage(m, vpn);
+        pageTable[vpn].valid        = false;
+        pageTable[vpn].physicalPage = -1;
+        return;
+    }
+
+    // A clean page is the same as its copy in swap, if it has one.
+    if (pageTable[vpn].dirty || swapSlots.count(vpn) == 0) {
         DEBUG('v',"[MemoryToSwap] vpn was dirty so we're actually copying it\n");
-        int ret =  swap_file->WriteAt(&(machine->mainMemory[physicalPage * PAGE_SIZE]), PAGE_SIZE, vpn*PAGE_SIZE);
-        ASSERT(ret == PAGE_SIZE);
+        WriteSwap(vpn, &machine->mainMemory[physicalPage * PAGE_SIZE]);
     }
    
     pageTable[vpn].physicalPage = -1;
     stats->swaps_out++;
+    accounting->CountFor(this, &Usage::swapsOut);
+    tracer->Record(TRACE_SWAP_OUT, vpn);
 
     ASSERT(pageTable[vpn].virtualPage == vpn)
 
@@ -14,11 +14,37 @@
 #define NACHOS_USERPROG_ADDRSPACE__HH
 
 
+#include "bitmap.hh"
 #include "filesys/file_system.hh"
-#include "machine/translation_entry.hh"
+#include "machine/machine.hh"
+#include "machine/page_table.hh"
 #include "bin/noff.h"
 
-const unsigned USER_STACK_SIZE = 1024;  ///< Increase this as necessary!
+#include <map>
+#include <vector>
+
+/// Virtual layout of a user program, from address 0 up:
+///
+/// * the program image (code, initialized data, bss);
+/// * the heap, starting at the first page after the image and grown with
+///   `Sbrk`, up to `USER_MMAP_BASE`;
+/// * files mapped with `Mmap`, from `USER_MMAP_BASE` up to
+///   `USER_THREAD_STACKS`;
+/// * the stacks of the threads created with `Fork`: `USER_MAX_THREADS`
+///   slots of `USER_THREAD_STACK` bytes, the lowest page of each left
+///   unmapped to catch overflows;
+/// * the stack, that starts at the top of `USER_ADDR_SPACE_SIZE` and grows
+///   down on page faults, at most `USER_STACK_LIMIT` bytes.
+///
+/// Nothing outside the image takes a frame or a page table leaf until it
+/// is touched.
+const unsigned USER_ADDR_SPACE_SIZE = 1024 * 1024;
+const unsigned USER_MMAP_BASE       = USER_ADDR_SPACE_SIZE / 2;
+const unsigned USER_STACK_LIMIT     = 64 * 1024;
+const unsigned USER_THREAD_STACK    = 16 * 1024;
+const unsigned USER_MAX_THREADS     = 8;
+const unsigned USER_THREAD_STACKS   = USER_ADDR_SPACE_SIZE - USER_STACK_LIMIT
+                                      - USER_MAX_THREADS * USER_THREAD_STACK;
 
 
 class AddressSpace {
@@ -30,9 +56,43 @@ public:
     /// * `executable` is the open file that corresponds to the program.
     AddressSpace(OpenFile *executable, const char * name);
 
-    /// De-allocate an address space.
+    /// Create a copy of `parent` for a forked process.
+    ///
+    /// Under *VMEM* resident pages are not copied: both spaces map the same
+    /// frames read-only and the first one to write a page gets its own copy
+    /// (see `CopyOnWrite`).  Without *VMEM* every loaded page is copied right
+    /// away.  `parent` must be the address space of the running thread.
+    AddressSpace(AddressSpace *parent);
+
+    /// De-allocate an address space.  Only when its last thread is gone
+    /// (see `Detach`).
     ~AddressSpace();
 
+    /// Threads sharing the space: a new space has one, and every thread
+    /// created with `Fork` one more.  `Detach` returns true when the last
+    /// one leaves, and the space must be deleted.
+    void Attach();
+    bool Detach();
+
+    /// Take a free slot for the stack of a new thread, and return it, or
+    /// -1 if every slot is taken.
+    int AllocateStack();
+
+    /// Initial stack pointer of a thread running on `slot`.
+    unsigned StackTop(int slot);
+
+    /// Give back `slot`, and the pages its thread touched.
+    void FreeStack(int slot);
+
+    /// Restartable atomic sequence: the code in `[start, end)`, whose last
+    /// instruction is its only store, runs as a unit.  A thread switched
+    /// out inside it starts it over (see `RestartAtomic`).
+    bool SetAtomicRange(unsigned start, unsigned end);
+
+    /// If the user registers `registers` of a thread being switched out
+    /// are inside the atomic sequence, move them back to its start.
+    void RestartAtomic(int *registers);
+
     /// Initialization used when demand loading is disabled 
     void init_demand_loading();
 
@@ -49,14 +109,60 @@ public:
     /// Handle a TLB miss
     void handleTLBMiss(unsigned vaddr);
 
+    /// Make the page at `vaddr` resident: load it the first time, bring it
+    /// back from swap after that.  Return false (after killing the
+    /// current thread, if it is ours) when `vaddr` lies in no region.
+    bool FaultIn(unsigned vaddr);
+
+    /// Move the end of the heap by `increment` bytes and return the old
+    /// end, or -1 if that would leave the heap region.  Pages past the new
+    /// end are released when shrinking.
+    int Sbrk(int increment);
+
+    /// Handle a write to a read-only page.
+    ///
+    /// If the page at `vaddr` is shared copy-on-write, give this space a
+    /// private, writable copy and return true so the instruction can be
+    /// restarted.  Return false if it is a genuine protection fault.
+    bool CopyOnWrite(unsigned vaddr);
+
+    /// Whether exception `which` at `vaddr` can be handled so that the
+    /// access goes on: a page fault in some region, or a write to a page
+    /// shared copy-on-write.  The kernel asks before touching user memory
+    /// for a system call, rather than have the caller killed.
+    bool CanHandle(ExceptionType which, unsigned vaddr);
+
     const char *m_name;
 
     int get_pid() {return m_pid;}
 
+    /// Record of the resources used (see `Accounting`), -1 if none.
+    int usageRecord;
+
+    /// Record of the system calls made (see `SyscallStats`).
+    int syscallRecord;
+
+    /// Number of pages of the program image (code, data and bss).
+    unsigned GetImagePages() {return heapStart;}
+
     /// Used when demand loading is enabled to read a single vpn from the executable and 
     /// copy it into a fresh frame
     void loadPage(unsigned vaddr);
 
+    /// Map the first `length` bytes of the file `name` into a fresh region
+    /// above the program's pages, and return its starting address, or -1.
+    ///
+    /// Pages are read from the file on first touch and written back to it
+    /// (never to swap) when they are evicted or unmapped.
+    int Mmap(const char *name, int length);
+
+    /// Write back and drop the region that starts at `addr`.  Return false
+    /// if no region starts there.
+    bool Munmap(unsigned addr);
+
+    /// Write back and drop every mapped region.
+    void UnmapAll();
+
 #ifdef VMEM
     // Retrieve page 'vpn' from Swap and store it in frame 'frn'
     void SwapToMemory(unsigned vpn, int frn);
@@ -65,26 +171,120 @@ public:
     void MemoryToSwap(unsigned vpn);
 #endif
 
-    /// Assume linear page table translation for now!
-    TranslationEntry *pageTable;
+    /// Sparse page table covering the whole `USER_ADDR_SPACE_SIZE`.
+    PageTable pageTable;
 
 private:
 
     int m_pid;
 
+    /// Number of threads sharing the space.
+    unsigned threads;
+
+    /// Stack slots taken by threads.
+    BitMap *stackSlots;
+
+    /// The atomic sequence, empty if the program did not set one.
+    unsigned atomicStart;
+    unsigned atomicEnd;
+
+    /// The stack slot `vpn` belongs to, or -1.
+    int StackSlotOf(unsigned vpn);
+
     /// Number of pages in the virtual address space.
     unsigned numPages;
+
+    /// First page of the heap (just past the image), and first address
+    /// past its end.
+    unsigned heapStart;
+    unsigned brk;
+
+    /// Whether `vpn` belongs to the image, the heap, a mapped file or the
+    /// stack region.
+    bool IsLegal(unsigned vpn);
+
+    /// Give back the frame of page `vpn`, if any, and forget its contents.
+    void ReleasePage(unsigned vpn);
+
+#ifdef USE_TLB
+    /// Drop the TLBs other CPUs keep for this space, before changing a
+    /// page.
+    void ShootDown();
+#endif
     
 #ifdef VMEM
-        OpenFile *swap_file;
+    /// Swap is kept in slots of a page, in files `SWAP.<pid>`, then
+    /// `SWAP1.<pid>`, `SWAP2.<pid>`... of `SWAP_FILE_PAGES` slots each,
+    /// created the first time one of their slots is needed.  A page takes a
+    /// slot when it is first swapped out and keeps it until it is released,
+    /// so a clean page is not written again.
+    std::vector<OpenFile *> swapFiles;
+
+    /// Slot of every page that has one.
+    std::map<unsigned, unsigned> swapSlots;
+
+    /// Slots given back by released pages, and how many were ever taken.
+    std::vector<unsigned> freeSwapSlots;
+    unsigned numSwapSlots;
+
+    /// Give page `vpn` a slot, creating a swap file if need be.
+    unsigned AllocateSwapSlot(unsigned vpn);
+
+    /// Give back the slot of page `vpn`, if it has one.
+    void FreeSwapSlot(unsigned vpn);
+
+    /// Copy page `vpn` from its slot into `page`, or from `page` into its
+    /// slot, which it is given first if it has none.
+    void ReadSwap(unsigned vpn, char *page);
+    void WriteSwap(unsigned vpn, const char *page);
+
+    /// Close and remove the swap files.
+    void RemoveSwap();
 #endif
 
+    /// `cow[vpn]` is set while page `vpn` is shared with a forked relative
+    /// and has been made read-only only for that reason.
+    std::vector<bool> cow;
+
+    /// A file mapped with `Mmap`.
+    struct MappedFile {
+        char     *name;      ///< Kept so a forked child can open it again.
+        OpenFile *file;
+        unsigned firstVpn;
+        unsigned numPages;
+        unsigned length;     ///< In bytes; pages past it are not written.
+    };
+    std::vector<MappedFile> mappings;
+
+    /// Return the mapping that covers page `vpn`, or NULL.
+    MappedFile *FindMapping(unsigned vpn);
+
+    /// Add a mapping of `length` bytes of `file` in the first hole of the
+    /// mapping region that fits it, and return its first vpn, or -1.
+    int AddMapping(const char *name, OpenFile *file, unsigned length);
+
+    /// Copy page `vpn`, resident in `frame`, back to its file if dirty.
+    void WriteBackPage(MappedFile *m, unsigned vpn);
+
+    /// Write back the dirty resident pages of `m`; with `release`, also
+    /// free their frames and leave them unmapped.
+    void FlushMapping(MappedFile *m, bool release);
+
     // Demand loading
     NoffHeader noffH;
     OpenFile *executable;
     unsigned nCodePages;  // Number of pages used by text segment
     unsigned nDataPages;  // Number of pages used by initialised data segment
 
+    /// Fill physical frame `frame` with the initial contents of virtual page
+    /// `vpn`: zeros, plus whatever parts of the code and initialized data
+    /// segments fall inside that page.
+    void FillPage(unsigned vpn, int frame);
+
+    /// Copy the slice of `seg` that overlaps virtual page `vpn` straight from
+    /// the executable into `frame`, with a single `ReadAt`.
+    void LoadSegmentPage(const Segment *seg, unsigned vpn, int frame);
+
 };
 
 
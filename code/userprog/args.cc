@@ -1,12 +1,9 @@
 #include "args.hh"
+#include "transfer.hh"
 
 const unsigned MAX_ARG_COUNT  = 32;
 const unsigned MAX_ARG_LENGTH = 128;
 
-void ReadStringFromUser(int userAddress, char *outString,
-                        unsigned maxByteCount);
-void WriteStringToUser(const char *string, int userAddress);
-
 void
 WriteArgs(char **args)
 {
@@ -21,10 +18,10 @@ WriteArgs(char **args)
     for (i = 0; i < MAX_ARG_COUNT; i++) {
         if (args[i] == NULL)        // If the last was reached, terminate.
             break;
-        sp -= strlen(args[i]) + 1;  // Decrease SP (leave one byte for \0).
-        WriteStringToUser(args[i], sp);  // Write the string there.
-        args_address[i] = sp;       // Save the argument's address.
-        delete args[i];             // Free the memory.
+        unsigned size = strlen(args[i]) + 1;  // Leave one byte for \0.
+        sp -= size;                 // Decrease SP.
+        CopyToUser(args[i], sp, size);  // Write the string there.
+        args_address[i] = WordToMachine(sp);  // Save the argument's address.
     }
     ASSERT(i < MAX_ARG_COUNT);
 
@@ -34,15 +31,24 @@ WriteArgs(char **args)
     machine->WriteRegister(4, i);
     machine->WriteRegister(5, sp);
     
-    for (unsigned j = 0; j < i; j++)
-        // Save the address of the j-th argument counting from the end down
-        // to the beginning.
-        machine->WriteMem(sp + 4 * j, 4, args_address[j]);
-    machine->WriteMem(sp + 4 * i, 4, 0);  // The last is NULL.
+    // Save the addresses of the arguments counting from the end down to
+    // the beginning, and then the trailing NULL.
+    args_address[i] = 0;
+    CopyToUser(args_address, sp, 4 * (i + 1));
     sp -= 16;  // Make room for the “register saves”.
 
     machine->WriteRegister(STACK_REG, sp);
-    delete args;  // Free the array.
+    FreeArgs(args);
+}
+
+void
+FreeArgs(char **args)
+{
+    ASSERT(args != NULL);
+
+    for (unsigned i = 0; args[i] != NULL; i++)
+        delete [] args[i];
+    delete [] args;
 }
 
 char **
@@ -51,11 +57,14 @@ SaveArgs(int address)
     ASSERT(address != 0);
 
     // Count the number of arguments up to NULL.
+    int addresses[MAX_ARG_COUNT];
     int val;
     unsigned i = 0;
     do {
-        machine->ReadMem(address + i * 4, 4, &val);
-        i++;
+        if (CopyFromUser(address + i * 4, &val, 4) < 4)
+            return NULL;  // The array is not the process's.
+        val = WordToHost(val);
+        addresses[i++] = val;
     } while (i < MAX_ARG_COUNT && val != 0);
     if (i == MAX_ARG_COUNT && val != 0)
         // The maximum number of arguments was reached but the last is not
@@ -68,9 +77,9 @@ SaveArgs(int address)
                                   // know that `i` will always be at least 1.
     for (unsigned j = 0; j < i - 1; j++) {
         // For each pointer, read the corresponding string.
+        // A bad argument is left empty, a long one cut short.
         ret[j] = new char [MAX_ARG_LENGTH];
-        machine->ReadMem(address + j * 4, 4, &val);
-        ReadStringFromUser(val, ret[j], MAX_ARG_LENGTH);
+        CopyStringFromUser(addresses[j], ret[j], MAX_ARG_LENGTH);
     }
     ret[i - 1] = NULL;  // Write the trailing NULL.
 
@@ -7,5 +7,6 @@
 
 void WriteArgs(char **args);
 char ** SaveArgs(int address);
+void FreeArgs(char **args);
 
 #endif //ARGS__HH
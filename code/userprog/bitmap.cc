@@ -1,5 +1,5 @@
 /// Routines to manage a bitmap -- an array of bits each of which can be
-/// either on or off.  Represented as an array of integers.
+/// either on or off.  Represented as an array of 64-bit words.
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2017 Docentes de la Universidad Nacional de Rosario.
@@ -9,6 +9,8 @@
 
 #include "bitmap.hh"
 
+#include <string.h>
+
 
 /// Initialize a bitmap with `nitems` bits, so that every bit is clear.  It
 /// can be added somewhere on a list.
@@ -18,9 +20,10 @@ BitMap::BitMap(unsigned nitems)
 {
     numBits  = nitems;
     numWords = divRoundUp(numBits, BitsInWord);
-    map      = new unsigned [numWords];
-    for (unsigned i = 0; i < numBits; i++)
-        Clear(i);
+    numBytes = divRoundUp(numBits, 32) * 4;
+    map      = new uint64_t [numWords];
+    hint     = 0;
+    memset(map, 0, numWords * sizeof *map);
 }
 
 /// De-allocate a bitmap.
@@ -36,7 +39,7 @@ void
 BitMap::Mark(unsigned which)
 {
     ASSERT(which < numBits);
-    map[which / BitsInWord] |= 1 << which % BitsInWord;
+    map[which / BitsInWord] |= (uint64_t) 1 << which % BitsInWord;
 }
 
 /// Clear the “nth” bit in a bitmap.
@@ -46,7 +49,7 @@ void
 BitMap::Clear(unsigned which)
 {
     ASSERT(which < numBits);
-    map[which / BitsInWord] &= ~(1 << which % BitsInWord);
+    map[which / BitsInWord] &= ~((uint64_t) 1 << which % BitsInWord);
 }
 
 /// Return true if the “nth” bit is set.
@@ -57,21 +60,81 @@ BitMap::Test(unsigned which)
 {
     ASSERT(which < numBits);
 
-    return map[which / BitsInWord] & 1 << which % BitsInWord;
+    return map[which / BitsInWord] >> which % BitsInWord & 1;
+}
+
+/// Return the number of the first bit in `[from, limit)` that is set (if
+/// `set`) or clear (otherwise), or `limit` if there is none.  Whole words
+/// that cannot contain it are skipped, and the bit inside the word is found
+/// with a count-trailing-zeros.
+unsigned
+BitMap::NextBit(unsigned from, bool set, unsigned limit)
+{
+    ASSERT(limit <= numBits);
+    if (from >= limit)
+        return limit;
+
+    unsigned w = from / BitsInWord;
+    unsigned last = (limit - 1) / BitsInWord;
+    uint64_t word = (set ? map[w] : ~map[w])
+                    & ~(uint64_t) 0 << from % BitsInWord;
+    while (word == 0) {
+        if (++w > last)
+            return limit;
+        word = set ? map[w] : ~map[w];
+    }
+    unsigned bit = w * BitsInWord + __builtin_ctzll(word);
+    return bit < limit ? bit : limit;
 }
 
-/// Return the number of the first bit which is clear.  As a side effect, set
-/// the bit (mark it as in use).  (In other words, find and allocate a bit.)
+/// Return the number of a bit which is clear.  As a side effect, set the
+/// bit (mark it as in use).  (In other words, find and allocate a bit.)
+///
+/// The search starts at the word of the last allocation and wraps around,
+/// so that a mostly full prefix is not scanned again on every call.
 ///
 /// If no bits are clear, return -1.
 int
 BitMap::Find()
 {
-    for (unsigned i = 0; i < numBits; i++)
-        if (!Test(i)) {
-            Mark(i);
-            return i;
+    unsigned bit = NextBit(hint * BitsInWord, false, numBits);
+    if (bit == numBits)
+        bit = NextBit(0, false, numBits);
+    if (bit == numBits)
+        return -1;
+
+    Mark(bit);
+    hint = bit / BitsInWord;
+    return bit;
+}
+
+/// Find a run of `n` consecutive clear bits, set all of them and return the
+/// number of the first one.  Like `Find`, the search starts at the hint and
+/// wraps around.
+///
+/// If there is no such run, return -1.
+///
+/// * `n` is the length of the run.
+int
+BitMap::FindRun(unsigned n)
+{
+    ASSERT(n > 0);
+
+    unsigned start[2] = { hint * BitsInWord, 0 };
+    for (unsigned pass = 0; pass < 2; pass++) {
+        unsigned bit = start[pass];
+        while ((bit = NextBit(bit, false, numBits)) + n <= numBits) {
+            // Only the next `n` bits matter; do not measure the whole run.
+            unsigned end = NextBit(bit, true, bit + n);
+            if (end == bit + n) {
+                for (unsigned i = bit; i < bit + n; i++)
+                    Mark(i);
+                hint = (bit + n - 1) / BitsInWord;
+                return bit;
+            }
+            bit = end;
         }
+    }
     return -1;
 }
 
@@ -82,10 +145,13 @@ BitMap::NumClear()
 {
     unsigned count = 0;
 
-    for (unsigned i = 0; i < numBits; i++)
-        if (!Test(i))
-            count++;
-    return count;
+    for (unsigned w = 0; w < numWords; w++) {
+        uint64_t word = map[w];
+        if (w == numWords - 1 && numBits % BitsInWord != 0)
+            word &= ((uint64_t) 1 << numBits % BitsInWord) - 1;
+        count += __builtin_popcountll(word);
+    }
+    return numBits - count;
 }
 
 /// Print the contents of the bitmap, for debugging.
@@ -96,21 +162,27 @@ void
 BitMap::Print()
 {
     printf("Bitmap set:\n");
-    for (unsigned i = 0; i < numBits; i++)
-        if (Test(i))
-            printf("%d, ", i);
+    for (unsigned i = NextBit(0, true, numBits); i < numBits;
+         i = NextBit(i + 1, true, numBits))
+        printf("%u, ", i);
     printf("\n");
 }
 
 /// Initialize the contents of a bitmap from a Nachos file.
 ///
+/// The file holds `numBytes` bytes, laid out as the old array of 32-bit
+/// words.  On a little-endian host that is the same byte order as the
+/// 64-bit words, so the map is read in place.
+///
 /// Note: this is not needed until the *FILESYS* assignment.
 ///
 /// * `file` is the place to read the bitmap from.
 void
 BitMap::FetchFrom(OpenFile *file)
 {
-    file->ReadAt((char *) map, numWords * sizeof (unsigned), 0);
+    memset(map, 0, numWords * sizeof *map);
+    file->ReadAt((char *) map, numBytes, 0);
+    hint = 0;
 }
 
 /// Store the contents of a bitmap to a Nachos file.
@@ -121,5 +193,5 @@ BitMap::FetchFrom(OpenFile *file)
 void
 BitMap::WriteBack(OpenFile *file)
 {
-   file->WriteAt((char *) map, numWords * sizeof (unsigned), 0);
+    file->WriteAt((char *) map, numBytes, 0);
 }
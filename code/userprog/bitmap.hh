@@ -1,8 +1,9 @@
 /// Data structures defining a bitmap -- an array of bits each of which can
 /// be either on or off.
 ///
-/// Represented as an array of unsigned integers, on which we do modulo
-/// arithmetic to find the bit we are interested in.
+/// Represented as an array of 64-bit words, on which we do modulo
+/// arithmetic to find the bit we are interested in.  Searches skip whole
+/// words at a time.
 ///
 /// The bitmap can be parameterized with with the number of bits being
 /// managed.
@@ -20,11 +21,13 @@
 #include "filesys/open_file.hh"
 #include "threads/utility.hh"
 
+#include <stdint.h>
+
 
 /// Definitions helpful for representing a bitmap as an array of integers.
 
 #define BitsInByte   8
-#define BitsInWord  32
+#define BitsInWord  64
 
 
 /// A “bitmap” -- an array of bits, each of which can be independently set,
@@ -58,9 +61,16 @@ public:
 
     /// Return the # of a clear bit, and as a side effect, set the bit.
     ///
-    /// If no bits are clear, return -1.
+    /// The search is next-fit: it starts where the previous one succeeded
+    /// and wraps around.  If no bits are clear, return -1.
     int Find();
 
+    /// Find `n` consecutive clear bits and set them.  Return the # of the
+    /// first one.
+    ///
+    /// If there is no such run, return -1 and leave the bitmap untouched.
+    int FindRun(unsigned n);
+
     /// Return the number of clear bits.
     unsigned NumClear();
 
@@ -89,7 +99,18 @@ private:
     unsigned numWords;
 
     /// Bit storage.
-    unsigned *map;
+    uint64_t *map;
+
+    /// Word where the next search starts (roving next-fit hint).
+    unsigned hint;
+
+    /// Size of the bitmap on disk.  The file keeps the layout of the old
+    /// 32-bit representation, so it is rounded to 4 bytes, not to a word.
+    unsigned numBytes;
+
+    /// Return the # of the first clear (`set` false) or set (`set` true)
+    /// bit in `[from, limit)`, or `limit` if there is none.
+    unsigned NextBit(unsigned from, bool set, unsigned limit);
 
 };
 
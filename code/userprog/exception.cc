@@ -24,7 +24,9 @@
 
 #include "syscall.h"
 #include "threads/system.hh"
+#include "threads/synch.hh"
 #include "args.hh"
+#include "transfer.hh"
 
 #define MAXNAMELENGTH 256   // Length limit for file names
 
@@ -53,52 +55,7 @@ extern unsigned number_running_threads;
 ///   in `machine.hh`.
 
 void runProc(void *);
-
-void ReadStringFromUser (int userAddress, char *outString, unsigned maxByteCount) {
-    int buf;
-    unsigned i;
-    for (i = 0; i<maxByteCount ; i++) { 
-        if (!machine->ReadMem(userAddress+i, 1, &buf)) 
-            break;
-        else if (buf=='\0') {
-            outString[i] = buf;
-            break;
-        } 
-        else
-            outString[i] = buf;
-    }
-}
-
-void ReadBufferFromUser (int userAddress, char *outBuffer, unsigned byteCount) {
-    unsigned i;
-    int buf;
-    for (i = 0; i<byteCount ; i++) {
-        if (!machine->ReadMem(userAddress+i, 1, &buf)) 
-            break;
-        else
-            outBuffer[i] = buf;
-    }
-}
-
-void WriteStringToUser (const char *string, int userAddress){
-    int i;    
-    for (i=0 ; string[i]!='\0' ; i++){
-       if (!machine->WriteMem(userAddress+i, 1, string[i]))
-           break;
-    }   
- 
-    machine->WriteMem(userAddress+i, 1, '\0');
-}
-
-
-void WriteBufferToUser (const char *buffer, int userAddress, unsigned byteCount){
-    unsigned i;    
-    for (i=0 ; i< byteCount ; i++){
-       if (!machine->WriteMem(userAddress+i, 1, buffer[i]))
-           break;
-    }    
-}
-
+void runForkedProc(void *);
 
 void incPC() {
     int programCounter = machine->ReadRegister(PC_REG);
@@ -118,10 +75,15 @@ ExceptionHandler(ExceptionType which)
 
     switch(which) {
         case SYSCALL_EXCEPTION: {
+        tracer->Record(TRACE_SYSCALL_ENTER, type);
+        int callerRecord = currentThread->space->syscallRecord;
+        unsigned enteredAt = stats->totalTicks;
+        syscallStats->Enter(callerRecord, type);
 
         switch(type) {
             case SC_Halt: {
                 DEBUG('s', "Shutdown, initiated by user program.\n");
+                currentThread->space->UnmapAll();
                 interrupt->Halt();
                 break;
             }
@@ -130,10 +92,14 @@ ExceptionHandler(ExceptionType which)
                 char buf[MAXNAMELENGTH];
                 int dname = machine->ReadRegister(4);
                 DEBUG('s', "Creating File..\n");
-                ReadStringFromUser(dname, buf, MAXNAMELENGTH);
-                DEBUG('s', "Creating File: %s\n",buf);                
-                if (fileSystem->Create(buf, MAXNAMELENGTH)) 
+                if (CopyStringFromUser(dname, buf, MAXNAMELENGTH) < 0) {
+                    DEBUG('s', "Syscall Create: Error. Bad file name.\n");
+                    machine->WriteRegister(2, SYSC_ERROR);
+                }
+                else if (fileSystem->Create(buf, MAXNAMELENGTH)) {
+                    DEBUG('s', "Creating File: %s\n",buf);
                     machine->WriteRegister(2, SYSC_OK); // archivo creado exitosamente
+                }
                 else 
                     machine->WriteRegister(2, SYSC_ERROR);
                 incPC();
@@ -176,11 +142,15 @@ ExceptionHandler(ExceptionType which)
                             machine->WriteRegister(2, read);
                         }
                         else {
+                            read = 0;
                             machine->WriteRegister(2, SYSC_ERROR);
                             DEBUG('s', "Syscall Read: Error. File couldn't be opened.\n");
                         }                                
                     }
-                    WriteBufferToUser(buf, dbuf, read);
+                    if (read > 0 && CopyToUser(buf, dbuf, read) < (unsigned) read) {
+                        machine->WriteRegister(2, SYSC_ERROR);
+                        DEBUG('s', "Syscall Read: Error. Bad buffer.\n");
+                    }
                 }
                 incPC(); 
                 delete [] buf;
@@ -205,8 +175,11 @@ ExceptionHandler(ExceptionType which)
                     machine->WriteRegister(2, SYSC_ERROR);
                     DEBUG('s', "Syscall Write: Error. Invalid file descriptor.\n");
                 }     
+                else if (CopyFromUser(dbuf, buf, size) < (unsigned) size) {
+                    machine->WriteRegister(2, SYSC_ERROR);
+                    DEBUG('s', "Syscall Write: Error. Bad buffer.\n");
+                }
                 else {
-                    ReadBufferFromUser(dbuf, buf, size);   
                     if(fd == ConsoleOutput) {
                        DEBUG('s', "Syscall Write: Writing to screen.\n");
                         int i;
@@ -235,10 +208,11 @@ ExceptionHandler(ExceptionType which)
             DEBUG('s', "Syscall Open\n");
             char name[MAXNAMELENGTH];
             int dname = machine->ReadRegister(4);
-            ReadStringFromUser(dname, name, MAXNAMELENGTH);
-            DEBUG('s', "Syscall Open. File name is %s\n",name);
-           
-            OpenFile *f = fileSystem->Open(name);
+            OpenFile *f = NULL;
+            if (CopyStringFromUser(dname, name, MAXNAMELENGTH) >= 0) {
+                DEBUG('s', "Syscall Open. File name is %s\n",name);
+                f = fileSystem->Open(name);
+            }
             if (f == NULL){
                 DEBUG('s', "Syscall Open: Error. Couldn't open file %s\n",name);
                 machine->WriteRegister(2, SYSC_ERROR);               
@@ -281,6 +255,7 @@ ExceptionHandler(ExceptionType which)
 
             if (number_running_threads==1){ // If this is the last thread, halt the machine
                 DEBUG('s',"Exiting last thread with status %d, halting machine\n", status);
+                currentThread->space->UnmapAll();
                 interrupt->Halt();
             }
             else 
@@ -294,16 +269,17 @@ ExceptionHandler(ExceptionType which)
         case SC_Join: { //int Join(SpaceId id);
 			DEBUG('s',"Syscall Join!");
 			SpaceId s = machine->ReadRegister(4);
-			Thread* t = procTable->Fetch(s);
-			if (t==NULL) {
-				DEBUG('s', "Syscall Join: Unable to fetch.\n");				
+			Completion *c = procTable->Fetch(s);
+			CompletionGroup *children = currentThread->GetChildren();
+			if (c==NULL || !children->Contains(c)) {  // Only the parent may join.
+				DEBUG('s', "Syscall Join: %d is not a child.\n", s);
 				machine->WriteRegister(2, SYSC_ERROR);       				
 			}
 			else {
 				DEBUG('s',"Syscall Join: About to join\n");
-				t->Join();       
-				DEBUG('s',"Syscall Join: Done\n");
-				machine->WriteRegister(2,SYSC_OK);
+				int status = children->Wait(c);
+				DEBUG('s',"Syscall Join: Done, status %d\n", status);
+				machine->WriteRegister(2, status);
 			}
 			incPC();
 			break;
@@ -311,17 +287,19 @@ ExceptionHandler(ExceptionType which)
         case SC_Exec: { //SpaceId Exec(char *name, char **argv);
             DEBUG('s',"Syscall Exec");
             
-			char *name = new char [128];
+			char *name = new char [MAXNAMELENGTH];
             int dname = machine->ReadRegister(4);
             DEBUG('s',"Syscall Exec: before reading program name\n");
-            ReadStringFromUser(dname, name, MAXNAMELENGTH);
 	
 			int argd = machine->ReadRegister(5);
 			char ** args = NULL;
-            OpenFile *executable = fileSystem->Open(name);
+            OpenFile *executable = NULL;
+            if (CopyStringFromUser(dname, name, MAXNAMELENGTH) >= 0)
+                executable = fileSystem->Open(name);
            
             if (executable == NULL) {
                 DEBUG('s', "Syscall Exec: Unable to upen file.\n");				
+                delete [] name;
                 machine->WriteRegister(2, SYSC_ERROR);       
 			} 
 			else {
@@ -340,9 +318,13 @@ ExceptionHandler(ExceptionType which)
 				t->space = space;
            		//delete executable;
            		
-				SpaceId sid = procTable->Add(t);
+				SpaceId sid = procTable->Add(t->GetCompletion());
 				if (sid==-1) {
 					DEBUG('s', "Syscall Exec: ProcTable is full.\n");				
+					delete t;  // And its space, which names it.
+					if (args != NULL)
+						FreeArgs(args);
+					delete [] name;
 					machine->WriteRegister(2, SYSC_ERROR);      
 				}
 				else {
@@ -354,12 +336,214 @@ ExceptionHandler(ExceptionType which)
 			incPC();
 			break;
 		}
+        case SC_Fork: { //int Fork(void (*func)());
+            int func     = machine->ReadRegister(4);
+            int returnTo = machine->ReadRegister(5);  // Set by the stub.
+            AddressSpace *space = currentThread->space;
+            DEBUG('s', "Syscall Fork: function at 0x%X\n", func);
+
+            int slot = space->AllocateStack();
+            if (slot < 0) {
+                DEBUG('s', "Syscall Fork: no stack left in space %d\n",
+                      space->get_pid());
+                machine->WriteRegister(2, SYSC_ERROR);
+                incPC();
+                break;
+            }
+            Thread *t = new Thread(space->m_name, false,
+                                   currentThread->GetPriority());
+            t->space = space;
+            t->userStackSlot = slot;
+            space->Attach();
+
+            // The new thread starts at `func`, on its own stack, and
+            // returns into the stub that exits.
+            int *regs = new int[NUM_TOTAL_REGS];
+            for (unsigned i = 0; i < NUM_TOTAL_REGS; i++)
+                regs[i] = 0;
+            regs[PC_REG]       = func;
+            regs[NEXT_PC_REG]  = func + 4;
+            regs[STACK_REG]    = space->StackTop(slot);
+            regs[RET_ADDR_REG] = returnTo;
+            t->Fork(runForkedProc, (void*)regs);
+
+            machine->WriteRegister(2, SYSC_OK);
+            incPC();
+            break;
+        }
+        case SC_Yield: { //void Yield();
+            currentThread->Yield();
+            incPC();
+            break;
+        }
+        case SC_ForkProcess: { //SpaceId ForkProcess();
+            DEBUG('s',"Syscall ForkProcess\n");
+
+            AddressSpace *space = new AddressSpace(currentThread->space);
+            Thread* t = new Thread(space->m_name,true,0);
+            t->space = space;
+            t->userStackSlot = currentThread->userStackSlot;
+
+            SpaceId sid = procTable->Add(t->GetCompletion());
+            if (sid==-1) {
+                DEBUG('s', "Syscall ForkProcess: ProcTable is full.\n");
+                delete t;
+                machine->WriteRegister(2, SYSC_ERROR);
+                incPC();
+                break;
+            }
+
+            machine->WriteRegister(2, sid);
+            incPC();
+
+            // The child resumes from the same point, seeing 0 as the result.
+            int *regs = new int[NUM_TOTAL_REGS];
+            for (unsigned i = 0; i < NUM_TOTAL_REGS; i++)
+                regs[i] = machine->ReadRegister(i);
+            regs[2] = 0;
+            t->Fork(runForkedProc, (void*)regs);
+            DEBUG('s', "Syscall ForkProcess: Success, child is %d.\n", sid);
+            break;
+        }
+        case SC_Mmap: { //int Mmap(char *name, int length);
+            DEBUG('s', "Syscall Mmap\n");
+            char name[MAXNAMELENGTH];
+            int dname  = machine->ReadRegister(4);
+            int length = machine->ReadRegister(5);
+            int addr = -1;
+            if (CopyStringFromUser(dname, name, MAXNAMELENGTH) >= 0)
+                addr = currentThread->space->Mmap(name, length);
+            if (addr < 0)
+                DEBUG('s', "Syscall Mmap: Error. Couldn't map file %s\n", name);
+            else
+                DEBUG('s', "Syscall Mmap: %s mapped at 0x%X\n", name, addr);
+            machine->WriteRegister(2, addr < 0 ? SYSC_ERROR : addr);
+            incPC();
+            break;
+        }
+        case SC_Munmap: { //int Munmap(int addr);
+            DEBUG('s', "Syscall Munmap\n");
+            int addr = machine->ReadRegister(4);
+            if (currentThread->space->Munmap(addr))
+                machine->WriteRegister(2, SYSC_OK);
+            else {
+                DEBUG('s', "Syscall Munmap: Error. Nothing mapped at 0x%X\n", addr);
+                machine->WriteRegister(2, SYSC_ERROR);
+            }
+            incPC();
+            break;
+        }
+        case SC_Sbrk: { //void *Sbrk(int increment);
+            int increment = machine->ReadRegister(4);
+            int old = currentThread->space->Sbrk(increment);
+            DEBUG('s', "Syscall Sbrk: %d bytes, old end 0x%X\n", increment, old);
+            machine->WriteRegister(2, old);
+            incPC();
+            break;
+        }
+        case SC_WaitAny: { //SpaceId WaitAny(int *status);
+            int statusAddr = machine->ReadRegister(4);
+            int id, status;
+            if (!currentThread->GetChildren()->WaitAny(&id, &status)) {
+                DEBUG('s', "Syscall WaitAny: no children\n");
+                machine->WriteRegister(2, SYSC_ERROR);
+            } else {
+                DEBUG('s', "Syscall WaitAny: %d exited with %d\n", id, status);
+                int word = WordToMachine(status);
+                if (statusAddr != 0
+                      && CopyToUser(&word, statusAddr, 4) < 4)
+                    DEBUG('s', "Syscall WaitAny: bad status address\n");
+                machine->WriteRegister(2, id);
+            }
+            incPC();
+            break;
+        }
+        case SC_SetWeight: { //int SetWeight(int weight);
+            int weight = machine->ReadRegister(4);
+            DEBUG('s', "Syscall SetWeight: %d\n", weight);
+            if (weight <= 0 || (unsigned) weight > FAIR_MAX_WEIGHT)
+                machine->WriteRegister(2, SYSC_ERROR);
+            else {
+                machine->WriteRegister(2, currentThread->GetWeight());
+                currentThread->SetWeight(weight);
+            }
+            incPC();
+            break;
+        }
+        case SC_Sleep: { //void Sleep(int ticks);
+            int ticks = machine->ReadRegister(4);
+            DEBUG('s', "Syscall Sleep: %d ticks\n", ticks);
+            if (ticks > 0)
+                alarmClock->Sleep(ticks);
+            incPC();
+            break;
+        }
+        case SC_FutexWait: { //int FutexWait(int *addr, int expected);
+            int addr     = machine->ReadRegister(4);
+            int expected = machine->ReadRegister(5);
+            bool slept = futexTable->Wait(currentThread->space, addr, expected);
+            machine->WriteRegister(2, slept ? SYSC_OK : SYSC_ERROR);
+            incPC();
+            break;
+        }
+        case SC_FutexWake: { //int FutexWake(int *addr, int n);
+            int addr = machine->ReadRegister(4);
+            int n    = machine->ReadRegister(5);
+            machine->WriteRegister(2,
+              futexTable->Wake(currentThread->space, addr, n));
+            incPC();
+            break;
+        }
+        case SC_SetAtomicRange: {
+            unsigned start = machine->ReadRegister(4);
+            unsigned end   = machine->ReadRegister(5);
+            if (currentThread->space->SetAtomicRange(start, end))
+                machine->WriteRegister(2, SYSC_OK);
+            else {
+                DEBUG('s', "Syscall SetAtomicRange: bad range 0x%X-0x%X\n",
+                      start, end);
+                machine->WriteRegister(2, SYSC_ERROR);
+            }
+            incPC();
+            break;
+        }
+        case SC_Stats: { //int Stats(int number, SyscallUsage *usage);
+            int number = machine->ReadRegister(4);
+            int dusage = machine->ReadRegister(5);
+            if (number >= NUM_SYSCALLS) {
+                DEBUG('s', "Syscall Stats: no system call %d\n", number);
+                machine->WriteRegister(2, SYSC_ERROR);
+            } else {
+                SyscallUsage usage;
+                syscallStats->Get(callerRecord, number, &usage);
+                // In the byte order of the machine.
+                unsigned *words = (unsigned *) &usage;
+                for (unsigned i = 0; i < sizeof usage / 4; i++)
+                    words[i] = WordToMachine(words[i]);
+                if (dusage != 0
+                      && CopyToUser(&usage, dusage, sizeof usage) < sizeof usage)
+                    machine->WriteRegister(2, SYSC_ERROR);
+                else
+                    machine->WriteRegister(2, stats->totalTicks);
+            }
+            incPC();
+            break;
+        }
         default:{
             printf("Unexpected syscall exception %d %d\n", which, type);
             ASSERT(false);  
             break;
         }
       }
+      tracer->Record(TRACE_SYSCALL_EXIT, type);
+      {
+          // `Read` and `Write` return the bytes they moved.
+          int moved = type == SC_Read || type == SC_Write
+                      ? machine->ReadRegister(2) : 0;
+          syscallStats->Leave(callerRecord, type,
+                              stats->totalTicks - enteredAt,
+                              moved > 0 ? moved : 0);
+      }
       break;           
     }
     case PAGE_FAULT_EXCEPTION: {
@@ -367,15 +551,19 @@ ExceptionHandler(ExceptionType which)
         //DEBUG('s', "PAGE_FAULT_EXCEPTION \n");
         #ifdef USE_TLB  // Es un TLB MISS, aún no sabemos si es un PAGE_FAULT real.
             currentThread->space->handleTLBMiss(vaddr);
-        #else // No estamos TLB,  estamos tratando de leer una pagina que nunca fue loaded
-            currentThread->space->loadPage(vaddr);
+        #else // Sin TLB: la página nunca fue cargada, está en swap o es stack/heap nuevo
+            currentThread->space->FaultIn(vaddr);
         #endif
 
         break;
     }
     case READ_ONLY_EXCEPTION: {
         DEBUG('s', "READ_ONLY_EXCEPTION \n");
-        currentThread->Finish(1);
+        unsigned vaddr = machine->ReadRegister(BAD_VADDR_REG);
+        // Pages shared after a fork are copied here, and the instruction
+        // is restarted (the PC is left alone).
+        if (!currentThread->space->CopyOnWrite(vaddr))
+            currentThread->Finish(1);
         break;
     }
     default:
@@ -399,3 +587,16 @@ void runProc(void* args)
                      // exits by doing the system call `Exit`.
 }
 
+/// Start a thread from the registers in `regs`: a child of `ForkProcess`,
+/// or a thread of the same space created with `Fork`.
+void runForkedProc(void* regs)
+{
+    for (unsigned i = 0; i < NUM_TOTAL_REGS; i++)
+        machine->WriteRegister(i, ((int*)regs)[i]);
+    delete [] (int*)regs;
+
+    currentThread->space->RestoreState();   // Load page table register.
+
+    machine->Run();  // Back to user code, right after `ForkProcess`.
+    ASSERT(false);
+}
@@ -0,0 +1,89 @@
+/// Routines for futexes.
+///
+/// Copyright (c) 2016-2017 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "futex_table.hh"
+#include "transfer.hh"
+#include "threads/system.hh"
+
+
+FutexTable::FutexTable()
+{}
+
+FutexTable::~FutexTable()
+{
+    for (unsigned i = 0; i < FUTEX_BUCKETS; i++)
+        while (buckets[i].Remove() != NULL)
+            ;
+}
+
+FutexTable::WaiterQueue *
+FutexTable::Bucket(AddressSpace *space, int addr)
+{
+    unsigned long key = (unsigned long) space / sizeof (void *)
+                        ^ (unsigned) addr / 4;
+    return &buckets[key & (FUTEX_BUCKETS - 1)];
+}
+
+/// Interrupts stay off from reading the word until the thread is on the
+/// queue, so no `Wake` can come in between.  A page fault on the way may
+/// let other threads run, but the word is read once it is resident.
+bool
+FutexTable::Wait(AddressSpace *space, int addr, int expected)
+{
+    ASSERT(space == currentThread->space);
+
+    if (addr % 4 != 0)
+        return false;
+
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    int value;
+    if (CopyFromUser(addr, &value, 4) < 4) {
+        interrupt->SetLevel(oldLevel);
+        DEBUG('s', "Futex 0x%X is not the process's\n", addr);
+        return false;
+    }
+    value = WordToHost(value);
+    if (value != expected) {
+        interrupt->SetLevel(oldLevel);
+        return false;
+    }
+
+    Waiter waiter;
+    waiter.space  = space;
+    waiter.addr   = addr;
+    waiter.thread = currentThread;
+    DEBUG('s', "Thread %s waits on futex 0x%X\n",
+          currentThread->getName(), addr);
+    Bucket(space, addr)->Append(&waiter);
+    currentThread->Sleep();
+
+    interrupt->SetLevel(oldLevel);
+    return true;
+}
+
+int
+FutexTable::Wake(AddressSpace *space, int addr, int n)
+{
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+
+    WaiterQueue *queue = Bucket(space, addr);
+    int woken = 0;
+    Waiter *w = queue->First();
+    while (w != NULL && woken < n) {
+        Waiter *following = queue->Next(w);
+        if (w->space == space && w->addr == addr) {
+            queue->Unlink(w);
+            scheduler->ReadyToRun(w->thread);
+            woken++;
+        }
+        w = following;
+    }
+    DEBUG('s', "%d threads woken up on futex 0x%X\n", woken, addr);
+
+    interrupt->SetLevel(oldLevel);
+    return woken;
+}
@@ -0,0 +1,63 @@
+/// Futexes: user threads waiting on a word of their address space.
+///
+/// `Wait` puts the current thread to sleep only if the word still holds
+/// the value it expects, checking and sleeping atomically; `Wake` wakes up
+/// threads waiting on a word.  User-level locks built on an atomic
+/// compare-and-swap only need the kernel when there is contention.
+///
+/// Waiting threads are kept in a hash table keyed by address space and
+/// virtual address, a queue per bucket.  A waiter record lives on the
+/// stack of its thread while it waits, so nothing is allocated.
+///
+/// Copyright (c) 2016-2017 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_FUTEXTABLE__HH
+#define NACHOS_USERPROG_FUTEXTABLE__HH
+
+
+#include "threads/intrusive_list.hh"
+
+
+class AddressSpace;
+class Thread;
+
+/// Number of buckets.  Must be a power of two.
+const unsigned FUTEX_BUCKETS = 64;
+
+class FutexTable {
+public:
+
+    /// Initialize the table, with nobody waiting.
+    FutexTable();
+
+    ~FutexTable();
+
+    /// If the word at `addr` in `space`, the space of the current thread,
+    /// equals `expected`, sleep until woken up and return true.  Otherwise
+    /// return false at once, as when `addr` is not word aligned or not in
+    /// `space`.
+    bool Wait(AddressSpace *space, int addr, int expected);
+
+    /// Wake up to `n` threads waiting on `addr` in `space`, oldest first.
+    /// Return how many were woken up.
+    int Wake(AddressSpace *space, int addr, int n);
+
+private:
+
+    struct Waiter {
+        AddressSpace *space;
+        int addr;
+        Thread *thread;
+        ListHook<Waiter> hook;
+    };
+    typedef IntrusiveList<Waiter, &Waiter::hook> WaiterQueue;
+
+    WaiterQueue *Bucket(AddressSpace *space, int addr);
+
+    WaiterQueue buckets[FUTEX_BUCKETS];
+};
+
+
+#endif
@@ -1,4 +1,5 @@
 #include "proctable.hh"
+#include "threads/synch.hh"
 
 ProcTable::ProcTable(){  // Inicializa la tabla vacía.
 	int i;
@@ -10,17 +11,18 @@ ProcTable::ProcTable(){  // Inicializa la tabla vacía.
 ProcTable::~ProcTable(){
 }
 
-SpaceId ProcTable::Add(Thread *t){
+SpaceId ProcTable::Add(Completion *c){
     int j;
-    for (j = 0; j < NUM_MAX_PROC; j++)
+    for (j = 1; j < NUM_MAX_PROC; j++)
 		if (procTable[j]==NULL){
-			procTable[j] = t;
+			procTable[j] = c;
+			c->SetId(j);
 			return j;
 		};
 	return -1;
 }
   
-Thread*  ProcTable::Fetch(int i){
+Completion*  ProcTable::Fetch(int i){
 	if(i < 0 || i >= NUM_MAX_PROC) return NULL;
 	return procTable[i];
 }
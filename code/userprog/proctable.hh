@@ -7,18 +7,23 @@
 
 #define NUM_MAX_PROC 777
 
+class Completion;
+
+/// Process identifiers.  Each one names the completion of a process, which
+/// outlives the process until its parent reaps it.  Identifier 0 is never
+/// given out, since `ForkProcess` returns it to the child.
 class ProcTable {
 	
   public:
 	ProcTable();  //constructor	
   ~ProcTable(); //destructor
   
-  Thread* Fetch(int i);  
-  SpaceId Add(Thread *t);
+  Completion* Fetch(int i);
+  SpaceId Add(Completion *c);  // Also sets the id of `c`.
   void Remove(int i);
     
   private:
-	  Thread *procTable[NUM_MAX_PROC];
+	  Completion *procTable[NUM_MAX_PROC];
 };
    
 #endif
@@ -10,10 +10,13 @@
 
 
 #include "address_space.hh"
+#include "bitmap.hh"
 #include "machine/console.hh"
 #include "threads/synch.hh"
 #include "threads/system.hh"
 
+#include <sys/time.h>
+
 
 /// Run a user program.
 ///
@@ -42,6 +45,94 @@ StartProcess(const char *filename)
                      // exits by doing the system call `Exit`.
 }
 
+/// Measure how long it takes to bring a whole program into memory.
+///
+/// Each iteration opens `filename`, builds a fresh address space and faults
+/// in every page of its image through `loadPage`, then throws it away.  The
+/// average wall-clock time per iteration is printed at the end.
+void
+LoaderBenchmark(const char *filename, int iterations)
+{
+    struct timeval start, end;
+    unsigned numPages = 0;
+
+    ASSERT(iterations > 0);
+    gettimeofday(&start, NULL);
+    for (int i = 0; i < iterations; i++) {
+        OpenFile *executable = fileSystem->Open(filename);
+        if (executable == NULL) {
+            printf("Unable to open file %s\n", filename);
+            return;
+        }
+        AddressSpace *space = new AddressSpace(executable, filename);
+        numPages = space->GetImagePages();
+        for (unsigned vpn = 0; vpn < numPages; vpn++)
+            space->loadPage(vpn * PAGE_SIZE);
+        delete space;  // Also closes `executable`.
+    }
+    gettimeofday(&end, NULL);
+
+    long usecs = (end.tv_sec - start.tv_sec) * 1000000L
+                 + (end.tv_usec - start.tv_usec);
+    printf("Loaded %s (%u pages) %d times: %ld us total, %ld us per load\n",
+           filename, numPages, iterations, usecs, usecs / iterations);
+}
+
+static long
+ElapsedUsecs(const struct timeval *start)
+{
+    struct timeval end;
+
+    gettimeofday(&end, NULL);
+    return (end.tv_sec - start->tv_sec) * 1000000L
+           + (end.tv_usec - start->tv_usec);
+}
+
+/// Time the `BitMap` allocation routines on a bitmap of `numBits` bits.
+///
+/// Each iteration fills the bitmap with `Find`, frees every other bit and
+/// allocates them again (the worst case for a search from the start), then
+/// frees everything and carves it into runs of 8 with `FindRun`.
+void
+BitMapBenchmark(unsigned numBits, int iterations)
+{
+    struct timeval start;
+    long fillUsecs = 0, holesUsecs = 0, runUsecs = 0;
+
+    ASSERT(numBits > 0 && iterations > 0);
+    BitMap *map = new BitMap(numBits);
+    for (int it = 0; it < iterations; it++) {
+        gettimeofday(&start, NULL);
+        for (unsigned i = 0; i < numBits; i++)
+            ASSERT(map->Find() >= 0);
+        ASSERT(map->Find() == -1);
+        fillUsecs += ElapsedUsecs(&start);
+
+        for (unsigned i = 0; i < numBits; i += 2)
+            map->Clear(i);
+        gettimeofday(&start, NULL);
+        for (unsigned i = 0; i < numBits; i += 2)
+            ASSERT(map->Find() >= 0);
+        holesUsecs += ElapsedUsecs(&start);
+
+        for (unsigned i = 0; i < numBits; i++)
+            map->Clear(i);
+        gettimeofday(&start, NULL);
+        for (unsigned i = 0; i + 8 <= numBits; i += 8)
+            ASSERT(map->FindRun(8) >= 0);
+        runUsecs += ElapsedUsecs(&start);
+        ASSERT(map->NumClear() == numBits % 8);
+
+        for (unsigned i = 0; i < numBits; i++)
+            map->Clear(i);
+    }
+    delete map;
+
+    printf("BitMap of %u bits, %d iterations:\n"
+           "    fill: %ld us, refill holes: %ld us, runs of 8: %ld us\n",
+           numBits, iterations, fillUsecs, holesUsecs, runUsecs);
+}
+
 /// Data structures needed for the console test.
 ///
 /// Threads making I/O requests wait on a `Semaphore` to delay until the I/O
@@ -1,4 +1,5 @@
 #include "synchconsole.hh"
+#include "threads/system.hh"
 
 // interrupt handlers: Para crear la consola 
 // Serán usados por la consola (variable privada de nuestra SynchConsole) 
@@ -40,6 +41,7 @@ char SynchConsole::GetChar() {
     rSem->P();                   // Esperamos a que haya un caracter 
     char c = console->GetChar(); // Leemos el caracter
     rLock->Release();            // Terminamos de leer 
+    accounting->Count(&Usage::consoleBytes);
     return c;                    // Retornamos el caracter leído
 }
 
@@ -49,6 +51,7 @@ void SynchConsole::PutChar(char ch) {
     console->PutChar(ch);        // Escribimos el caracter
     wSem->P();                   // Esperamos a que el caracter haya sido mostrado
     wLock->Release();            // Terminamos de escribir
+    accounting->Count(&Usage::consoleBytes);
 }
 
 void SynchConsole::WriteDone() { // Será llamada por handler
@@ -30,6 +30,19 @@
 #define SC_Close    8
 #define SC_Fork     9
 #define SC_Yield   10
+#define SC_ForkProcess 11
+#define SC_Mmap    12
+#define SC_Munmap  13
+#define SC_Sbrk    14
+#define SC_SetWeight 15
+#define SC_WaitAny 16
+#define SC_Sleep   17
+#define SC_FutexWait 18
+#define SC_FutexWake 19
+#define SC_SetAtomicRange 20  // Made by `__start`, see `CompareAndSwap`.
+#define SC_Stats   21
+
+#define NUM_SYSCALLS  22
 
 
 #ifndef IN_ASM
@@ -61,9 +74,38 @@ SpaceId Exec(char *name, char **argv);
 
 /// Only return once the the user program `id` has finished.
 ///
-/// Return the exit status.
+/// Return the exit status, or -1 if `id` is not a child of the caller.
 int Join(SpaceId id);
 
+/// Wait for whichever child of the caller finishes first (or has finished
+/// already and has not been joined), store its exit status in `*status` if
+/// `status` is not null, and return its identifier.  Return -1 if the
+/// caller has no children left.
+SpaceId WaitAny(int *status);
+
+/// Duplicate the calling user program.
+///
+/// The child starts with a copy of the parent's memory and registers, and
+/// resumes right after the call.  Return the child's identifier to the
+/// parent (for `Join`), 0 to the child, or -1 on error.  Open files are not
+/// inherited.
+SpaceId ForkProcess();
+
+/// Move the end of the heap `increment` bytes (which may be negative) and
+/// return the previous end, or -1 if the heap cannot grow or shrink that
+/// much.  New heap memory reads as zeros and takes no memory until used.
+void *Sbrk(int increment);
+
+/// Set the weight of the calling thread to `weight`, and return the old
+/// one, or -1 if `weight` is not between 1 and 1048576.  Under the fair
+/// share scheduler (`-fair`) threads get the CPU in proportion to their
+/// weights; the default is 1024.
+int SetWeight(int weight);
+
+/// Stop running for at least `ticks` ticks of simulated time, without
+/// using the CPU meanwhile.  Does nothing if `ticks` is not positive.
+void Sleep(int ticks);
+
 
 /// File system operations: `Create`, `Open`, `Read`, `Write`, `Close`.
 ///
@@ -106,18 +148,81 @@ int Read(char *buffer, int size, OpenFileId id);
 /// Close the file, we are done reading and writing to it.
 void Close(OpenFileId id);
 
+/// Map the first `length` bytes of the Nachos file `name` into memory.
+///
+/// Return the address of the mapped region, or -1 on error, as when the
+/// region would not fit in the address space.  The file is read page by
+/// page as the region is touched; changes reach the file when pages are
+/// evicted, on `Munmap` and when the program exits.
+int Mmap(char *name, int length);
+
+/// Unmap the region returned by `Mmap` at `addr`, writing back any changes.
+///
+/// Return 0 on success, -1 if no region starts at `addr`.
+int Munmap(int addr);
+
 
 /// User-level thread operations: `Fork` and `Yield`.  To allow multiple
 /// threads to run within a user program.
 
 /// Fork a thread to run a procedure (`func`) in the *same* address space as
 /// the current thread.
-void Fork(void (*func)());
+///
+/// The new thread gets a stack of its own (`USER_THREAD_STACK` bytes, see
+/// `address_space.hh`) and shares everything else with the other threads of
+/// the space, which lives until the last of them exits.  Returning from
+/// `func` is the same as `Exit(0)`.  Open files are not shared.
+///
+/// Return 0 on success, -1 if the space has no stack left for the thread.
+int Fork(void (*func)());
 
 /// Yield the CPU to another runnable thread, whether in this address space
 /// or not.
 void Yield();
 
+
+/// Synchronization among threads of the same address space.
+
+/// If `*addr` equals `expected`, sleep until `FutexWake` on `addr`, and
+/// return 0; otherwise return -1 at once, also if `addr` is not a word
+/// aligned address of the process.  The check and the sleep are atomic.
+int FutexWait(volatile int *addr, int expected);
+
+/// Wake up to `n` threads sleeping in `FutexWait` on `addr`, and return how
+/// many were woken up.
+int FutexWake(volatile int *addr, int n);
+
+/// If `*addr` equals `expected`, set it to `desired`; atomically, and
+/// without entering the kernel.  Return the old value of `*addr`.
+int CompareAndSwap(volatile int *addr, int expected, int desired);
+
+
+/// Instrumentation.
+
+/// Buckets of the latency histogram of a system call.
+#define SYSCALL_BUCKETS  16
+
+/// What a process did with a system call: calls made; and, of the calls
+/// that returned, the simulated ticks they took, the bytes they moved (for
+/// `Read` and `Write`) and how long each took.  `histogram[0]` counts the
+/// calls that took no time, `histogram[i]` those that took 2^(i-1) to
+/// 2^i - 1 ticks, and the last bucket also everything longer.
+typedef struct syscallUsage {
+    unsigned calls;
+    unsigned ticks;
+    unsigned bytes;
+    unsigned histogram[SYSCALL_BUCKETS];
+} SyscallUsage;
+
+/// Store in `*usage`, unless it is null, what the calling process has done
+/// so far with system call `number`, or with all of them if `number` is
+/// negative; and return the simulated time, in ticks, so that a program
+/// can measure its phases.  Return -1 if `number` is not a system call,
+/// or `usage` does not point into the process.
+/// This call is counted among the calls made, but not yet among those that
+/// returned.
+int Stats(int number, SyscallUsage *usage);
+
 #endif
 
 
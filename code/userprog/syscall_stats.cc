@@ -0,0 +1,159 @@
+/// Routines for the system call counters.
+///
+/// Copyright (c) 2016-2017 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "syscall_stats.hh"
+#include "threads/system.hh"
+
+
+static const char *SYSCALL_NAMES[NUM_SYSCALLS] = {
+    "Halt", "Exit", "Exec", "Join", "Create", "Open", "Read", "Write",
+    "Close", "Fork", "Yield", "ForkProcess", "Mmap", "Munmap", "Sbrk",
+    "SetWeight", "WaitAny", "Sleep", "FutexWait", "FutexWake",
+    "SetAtomicRange", "Stats"
+};
+
+SyscallStats::SyscallStats(bool reportAtHalt)
+{
+    report = reportAtHalt;
+    memset(total, 0, sizeof total);
+    capacity = 16;
+    records = new Record [capacity];
+    numRecords = 0;
+}
+
+SyscallStats::~SyscallStats()
+{
+    delete [] records;
+}
+
+int
+SyscallStats::AddProcess(const char *name, int pid)
+{
+    if (numRecords == capacity) {
+        Record *bigger = new Record [2 * capacity];
+        memcpy(bigger, records, numRecords * sizeof *records);
+        delete [] records;
+        records = bigger;
+        capacity *= 2;
+    }
+    Record *record = &records[numRecords];
+    strncpy(record->name, name, sizeof record->name - 1);
+    record->name[sizeof record->name - 1] = '\0';
+    record->pid = pid;
+    memset(record->usage, 0, sizeof record->usage);
+    return numRecords++;
+}
+
+void
+SyscallStats::Enter(int record, int number)
+{
+    ASSERT(record >= 0 && (unsigned) record < numRecords);
+
+    if (number < 0 || number >= NUM_SYSCALLS)
+        return;  // Not a system call; the handler will complain.
+    records[record].usage[number].calls++;
+    total[number].calls++;
+}
+
+/// Latencies go in buckets by their highest bit set.
+void
+SyscallStats::Leave(int record, int number, unsigned ticks, unsigned bytes)
+{
+    ASSERT(record >= 0 && (unsigned) record < numRecords);
+    ASSERT(number >= 0 && number < NUM_SYSCALLS);
+
+    unsigned bucket = 0;
+    for (unsigned t = ticks; t != 0 && bucket < SYSCALL_BUCKETS - 1; t >>= 1)
+        bucket++;
+
+    SyscallUsage *usages[2] = { &records[record].usage[number],
+                                &total[number] };
+    for (unsigned i = 0; i < 2; i++) {
+        usages[i]->ticks += ticks;
+        usages[i]->bytes += bytes;
+        usages[i]->histogram[bucket]++;
+    }
+}
+
+void
+SyscallStats::Get(int record, int number, SyscallUsage *usage)
+{
+    ASSERT(record >= 0 && (unsigned) record < numRecords);
+    ASSERT(number < NUM_SYSCALLS);
+
+    if (number >= 0) {
+        *usage = records[record].usage[number];
+        return;
+    }
+    memset(usage, 0, sizeof *usage);
+    for (unsigned n = 0; n < NUM_SYSCALLS; n++)
+        Add(usage, &records[record].usage[n]);
+}
+
+void
+SyscallStats::Add(SyscallUsage *to, const SyscallUsage *from)
+{
+    to->calls += from->calls;
+    to->ticks += from->ticks;
+    to->bytes += from->bytes;
+    for (unsigned b = 0; b < SYSCALL_BUCKETS; b++)
+        to->histogram[b] += from->histogram[b];
+}
+
+/// The mean is of the calls that returned, and so are the percentiles,
+/// given as the upper bound of their bucket.
+void
+SyscallStats::PrintUsage(const char *name, const SyscallUsage *usage)
+{
+    unsigned returned = 0;
+    for (unsigned b = 0; b < SYSCALL_BUCKETS; b++)
+        returned += usage->histogram[b];
+
+    printf("    %-14s %7u %10u", name, usage->calls, usage->ticks);
+    if (returned == 0) {
+        printf(" %8s %10u\n", "-", usage->bytes);
+        return;
+    }
+    printf(" %8u %10u", usage->ticks / returned, usage->bytes);
+
+    const unsigned PERCENTILES[] = { 50, 99 };
+    unsigned seen = 0, b = 0;
+    for (unsigned p = 0; p < 2; p++) {
+        for (; b < SYSCALL_BUCKETS; b++) {
+            if (100 * (seen + usage->histogram[b])
+                  >= PERCENTILES[p] * returned)
+                break;
+            seen += usage->histogram[b];
+        }
+        if (b == SYSCALL_BUCKETS - 1)
+            printf("  %6s", "more");
+        else
+            printf("  %6u", (1u << b) - 1);
+    }
+    printf("\n");
+}
+
+void
+SyscallStats::Print()
+{
+    if (!report)
+        return;
+
+    printf("System calls:\n"
+           "    %-14s %7s %10s %8s %10s  %6s  %6s\n",
+           "call", "calls", "ticks", "mean", "bytes", "p50<=", "p99<=");
+    for (unsigned n = 0; n < NUM_SYSCALLS; n++)
+        if (total[n].calls > 0)
+            PrintUsage(SYSCALL_NAMES[n], &total[n]);
+
+    for (unsigned i = 0; i < numRecords; i++) {
+        printf("  Process %d (%s):\n", records[i].pid, records[i].name);
+        for (unsigned n = 0; n < NUM_SYSCALLS; n++)
+            if (records[i].usage[n].calls > 0)
+                PrintUsage(SYSCALL_NAMES[n], &records[i].usage[n]);
+    }
+}
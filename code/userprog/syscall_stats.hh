@@ -0,0 +1,68 @@
+/// Counters of the system calls made by every process.
+///
+/// For every process and system call: how many calls, and for those that
+/// returned, the simulated ticks they took, a histogram of them, and the
+/// bytes moved by `Read` and `Write`.  Always kept, since user programs
+/// read their own through the `Stats` system call; reported at halt with
+/// `-syscalls`, for all processes together and for each.  Records outlive
+/// their processes, like those of `Accounting`.
+///
+/// Copyright (c) 2016-2017 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_SYSCALLSTATS__HH
+#define NACHOS_USERPROG_SYSCALLSTATS__HH
+
+
+#include "syscall.h"
+
+
+class SyscallStats {
+public:
+
+    /// Start with no processes; report at halt if `report`.
+    SyscallStats(bool report);
+
+    ~SyscallStats();
+
+    /// Start the record of process `pid`, and return its number.
+    int AddProcess(const char *name, int pid);
+
+    /// Count a call to `number` by the process of record `record`.
+    void Enter(int record, int number);
+
+    /// Count a call to `number` by the process of record `record` that
+    /// returned after `ticks` ticks, having moved `bytes` bytes.
+    void Leave(int record, int number, unsigned ticks, unsigned bytes);
+
+    /// Store in `*usage` the counters of record `record` for `number`, or
+    /// for all system calls if `number` is negative.
+    void Get(int record, int number, SyscallUsage *usage);
+
+    /// Report the counters, if asked to.
+    void Print();
+
+private:
+
+    struct Record {
+        char name[24];
+        int pid;
+        SyscallUsage usage[NUM_SYSCALLS];
+    };
+
+    /// Add the counters of `from` to `to`.
+    static void Add(SyscallUsage *to, const SyscallUsage *from);
+
+    static void PrintUsage(const char *name, const SyscallUsage *usage);
+
+    bool report;
+
+    /// All processes together, and every one.
+    SyscallUsage total[NUM_SYSCALLS];
+    Record *records;
+    unsigned numRecords, capacity;
+};
+
+
+#endif
@@ -0,0 +1,113 @@
+/// Routines to copy to and from user memory.
+///
+/// Copyright (c) 2016-2017 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "transfer.hh"
+#include "threads/system.hh"
+
+
+/// Translations tried for a page: after a TLB miss, the page may still be
+/// shared copy-on-write.
+static const unsigned MAX_ATTEMPTS = 3;
+
+/// Return where user address `addr` is in `mainMemory`, for `writing` or
+/// not, handling faults on the way as if the program had made the access;
+/// or -1 if it cannot be accessed.
+static int
+UserToPhysical(unsigned addr, bool writing)
+{
+    unsigned physAddr;
+
+    for (unsigned attempt = 0; attempt < MAX_ATTEMPTS; attempt++) {
+        ExceptionType exception
+          = machine->Translate(addr, &physAddr, 1, writing, attempt > 0);
+        if (exception == NO_EXCEPTION)
+            return physAddr;
+        if (!currentThread->space->CanHandle(exception, addr))
+            break;
+
+        // Still in the system call, whatever the handler says.
+        MachineStatus status = interrupt->getStatus();
+        machine->RaiseException(exception, addr);
+        interrupt->setStatus(status);
+    }
+    DEBUG('a', "User address 0x%X cannot be %s\n",
+          addr, writing ? "written" : "read");
+    return -1;
+}
+
+/// Bytes from user address `addr` to the end of its page, up to `count`.
+static unsigned
+ChunkAt(unsigned addr, unsigned count)
+{
+    unsigned left = PAGE_SIZE - addr % PAGE_SIZE;
+    return left < count ? left : count;
+}
+
+unsigned
+CopyFromUser(int userAddress, void *buffer, unsigned count)
+{
+    ASSERT(buffer != NULL || count == 0);
+
+    char *to = (char *) buffer;
+    unsigned copied = 0;
+    while (copied < count) {
+        unsigned addr = userAddress + copied;
+        int physAddr = UserToPhysical(addr, false);
+        if (physAddr < 0)
+            break;
+        unsigned chunk = ChunkAt(addr, count - copied);
+        memcpy(to + copied, &machine->mainMemory[physAddr], chunk);
+        copied += chunk;
+    }
+    return copied;
+}
+
+unsigned
+CopyToUser(const void *buffer, int userAddress, unsigned count)
+{
+    ASSERT(buffer != NULL || count == 0);
+
+    const char *from = (const char *) buffer;
+    unsigned copied = 0;
+    while (copied < count) {
+        unsigned addr = userAddress + copied;
+        int physAddr = UserToPhysical(addr, true);
+        if (physAddr < 0)
+            break;
+        unsigned chunk = ChunkAt(addr, count - copied);
+        memcpy(&machine->mainMemory[physAddr], from + copied, chunk);
+        copied += chunk;
+    }
+    return copied;
+}
+
+/// Every page is searched for the null before anything is copied from it,
+/// so nothing is read past the end of the string.
+int
+CopyStringFromUser(int userAddress, char *string, unsigned size)
+{
+    ASSERT(string != NULL && size > 0);
+
+    unsigned copied = 0;
+    while (copied < size) {
+        unsigned addr = userAddress + copied;
+        int physAddr = UserToPhysical(addr, false);
+        if (physAddr < 0)
+            break;
+        unsigned chunk = ChunkAt(addr, size - copied);
+        const char *from = &machine->mainMemory[physAddr];
+        const char *end = (const char *) memchr(from, '\0', chunk);
+        if (end != NULL) {
+            memcpy(string + copied, from, end - from + 1);
+            return copied + (end - from);
+        }
+        memcpy(string + copied, from, chunk);
+        copied += chunk;
+    }
+    string[copied < size ? copied : size - 1] = '\0';
+    return -1;
+}
@@ -0,0 +1,37 @@
+/// Copying between kernel buffers and the memory of the current process.
+///
+/// System calls move their arguments with these, a page at a time: every
+/// page is translated once, as the machine would (through the TLB under
+/// `USE_TLB`), brought in or copied on write if need be, and then copied
+/// with `memcpy`.  So the cost goes with the pages touched, not the bytes.
+///
+/// An address that does not belong to the process ends the copy where it
+/// is, and the caller learns how much was copied; the process is not
+/// killed for passing a bad pointer.
+///
+/// Copyright (c) 2016-2017 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_TRANSFER__HH
+#define NACHOS_USERPROG_TRANSFER__HH
+
+
+/// Copy `count` bytes at user address `userAddress` into `buffer`.  Return
+/// how many were copied: fewer than `count` if the range runs into an
+/// address that is not the process's.
+unsigned CopyFromUser(int userAddress, void *buffer, unsigned count);
+
+/// Copy `count` bytes of `buffer` to user address `userAddress`.  Return
+/// how many were copied: fewer than `count` if the range runs into an
+/// address that is not the process's, or that it may not write.
+unsigned CopyToUser(const void *buffer, int userAddress, unsigned count);
+
+/// Copy the string at user address `userAddress`, with its terminating
+/// null, into `string`, of `size` bytes.  Return its length, or -1 if it
+/// runs into an address that is not the process's, or does not fit; then
+/// `string` holds as much as was copied, terminated.
+int CopyStringFromUser(int userAddress, char *string, unsigned size);
+
+
+#endif
@@ -25,9 +25,42 @@ Paginador::Paginador() {
 Paginador::~Paginador() {
 }
 
-void Paginador::ReleaseFrame(int frame) {
+void Paginador::ShareFrame(int frame, AddressSpace *space) {
 
     ASSERT(frame >= 0 && frame < (int)NUM_PHYS_PAGES);
+    ASSERT(coremap[frame].space != NULL);
+
+    coremap[frame].sharers.push_back(space);
+    DEBUG('v', "frame %d is now shared with space %d (%u sharers)\n",
+          frame, space->get_pid(), (unsigned)coremap[frame].sharers.size());
+}
+
+bool Paginador::IsShared(int frame) {
+
+    ASSERT(frame >= 0 && frame < (int)NUM_PHYS_PAGES);
+    return !coremap[frame].sharers.empty();
+}
+
+void Paginador::ReleaseFrame(int frame, AddressSpace *space) {
+
+    ASSERT(frame >= 0 && frame < (int)NUM_PHYS_PAGES);
+
+    // Quedan otros espacios usando el marco: solo se suelta esta referencia.
+    CoreMapEntry &entry = coremap[frame];
+    if (!entry.sharers.empty()) {
+        if (entry.space == space) {
+            entry.space = entry.sharers.front();
+            entry.sharers.pop_front();
+        } else {
+            ASSERT(std::find(entry.sharers.begin(), entry.sharers.end(), space)
+                   != entry.sharers.end());
+            entry.sharers.remove(space);
+        }
+        DEBUG('v', "space %d dropped its reference to frame %d\n",
+              space->get_pid(), frame);
+        return;
+    }
+    ASSERT(entry.space == space);
  
 #ifdef FIFO
     ASSERT( (std::find(frame_queue.begin(), frame_queue.end(), frame)) != frame_queue.end())
@@ -64,7 +97,7 @@ int Paginador::FindFreeFrame(AddressSpace *new_space, int new_vpn) {
         DEBUG('v', "Memory is full, sending frame %d (adds %d vpn %d)  to swap \n",victim,coremap[victim].space->get_pid(),victim_vpn);
 
         // Mandarlo a swap
-        coremap[victim].space->MemoryToSwap(victim_vpn);
+        EvictFrame(victim);
 
         // Reasignar el frame
         coremap[victim].space = new_space;
@@ -109,6 +142,40 @@ int Paginador::FindFreeFrame(AddressSpace *new_space, int new_vpn) {
     return -1;
 }
 
+void Paginador::EvictFrame(int frame) {
+
+    CoreMapEntry &entry = coremap[frame];
+
+    entry.space->MemoryToSwap(entry.vpn);
+    for (std::list<AddressSpace *>::iterator it = entry.sharers.begin();
+         it != entry.sharers.end(); ++it)
+        (*it)->MemoryToSwap(entry.vpn);
+    entry.sharers.clear();
+}
+
+bool Paginador::FrameUsed(int frame) {
+
+    CoreMapEntry &entry = coremap[frame];
+
+    if (entry.space->pageTable[entry.vpn].use)
+        return true;
+    for (std::list<AddressSpace *>::iterator it = entry.sharers.begin();
+         it != entry.sharers.end(); ++it)
+        if ((*it)->pageTable[entry.vpn].use)
+            return true;
+    return false;
+}
+
+void Paginador::ClearFrameUse(int frame) {
+
+    CoreMapEntry &entry = coremap[frame];
+
+    entry.space->pageTable[entry.vpn].use = false;
+    for (std::list<AddressSpace *>::iterator it = entry.sharers.begin();
+         it != entry.sharers.end(); ++it)
+        (*it)->pageTable[entry.vpn].use = false;
+}
+
 int Paginador::ChooseVictimFrame(){
 
     ASSERT(usedFrames == NUM_PHYS_PAGES);
@@ -160,14 +227,13 @@ unsigned Paginador::ChooseVictimFrame_Clock(){
 
     while(true){
         int candidate_frame = circular_list_pop_front_element();
-        CoreMapEntry entry = coremap[candidate_frame];
         DEBUG('c', "popped frame %d \n", candidate_frame);        
-        if ( (entry.space->pageTable[entry.vpn]).use==false ) {  // TODO: What if that entry is in the TLB? 
+        if ( !FrameUsed(candidate_frame) ) {  // TODO: What if that entry is in the TLB? 
             DEBUG('c', "use bit is false, victim chosen \n");        
             return candidate_frame;
         }
         else {
-            (entry.space->pageTable[entry.vpn]).use=false;
+            ClearFrameUse(candidate_frame);
             insert_element_in_the_back(candidate_frame);
             DEBUG('c', "use bit is on, setting it off \n");        
         }
@@ -213,7 +279,8 @@ void Paginador::remove_element_from_circular_queue(int frame){
         fcq_index--;
     }
     
-    ASSERT ( fcq_index>=0 && fcq_index < (int)frame_circular_queue.size());
+    ASSERT ( frame_circular_queue.empty() ? fcq_index == -1
+             : (fcq_index>=0 && fcq_index < (int)frame_circular_queue.size()));
 
 }
 
@@ -10,6 +10,9 @@
 typedef struct CoreMapEntry {
     AddressSpace      *space;
     int               vpn;
+    // Otros espacios (procesos forkeados) que mapean este marco en la misma
+    // vpn, en modo copy-on-write.  El marco se libera con la última referencia.
+    std::list<AddressSpace *> sharers;
 } CoreMapEntry;
 
 /* Esta clase se encarga de la asignación de marcos físicos para colocar las distintas
@@ -37,10 +40,25 @@ class Paginador {
     // Cuando un thread finaliza, se invoca Clear en cada uno de sus marcos.
     // Esto ocasiona que todos los marcos que estaba usando pasen a estar disponibles 
     // para otros procesos.
-    void ReleaseFrame(int fn);
+    // Si el marco está compartido, solo se suelta la referencia de `space`.
+    void ReleaseFrame(int fn, AddressSpace *space);
+
+    // Agrega `space` a los espacios que comparten el marco fn (fork con
+    // copy-on-write).
+    void ShareFrame(int fn, AddressSpace *space);
+
+    // Indica si más de un espacio de direcciones mapea el marco fn.
+    bool IsShared(int fn);
 
   private:
 
+    // Manda a swap la página del marco fn en todos los espacios que la mapean.
+    void EvictFrame(int fn);
+
+    // Indica si alguno de los espacios que mapean el marco fn lo usó.
+    bool FrameUsed(int fn);
+    void ClearFrameUse(int fn);
+
     // Elegir un marco víctima para mandar a swap
     int ChooseVictimFrame();
 